@@ -0,0 +1,382 @@
+// Copyright 2023 Andrei Drozdov
+
+// Throughput of the decode and slicing hot paths: the kernels on
+// synthetic buffers in memory, then slice and split on synthetic wave
+// files (one per format, RF64 above 4 GB, reused while their size
+// matches).
+// Usage: asl_bench [--size MB] [--channels N] [--jobs N] [--repeat N]
+//     [--dir DIR] [--filter TEXT] [--save FILE] [--baseline FILE]
+//     [--tolerance FRACTION]
+// Every result is the best of the repeats. --save writes the results as
+// "name MB/s samples/s" lines, --baseline compares with such a file and
+// fails (exit code 1) when a benchmark lost more than the tolerance
+// (default 0.1) of its MB/s.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>  // NOLINT [build/c++11]
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../src/adpcm.h"
+#include "../src/convert.h"
+#include "../src/g711.h"
+#include "../src/kernels.h"
+#include "../src/pool.h"
+#include "../src/slice.h"
+
+using namespace std;  // NOLINT [build/namespaces]
+
+typedef struct {
+    int64_t size;
+    int channels;
+    int jobs;
+    int repeat;
+    string dir;
+    string filter;
+    string save;
+    string baseline;
+    double tolerance;
+} bench_options;
+
+typedef struct {
+    string name;
+    double mb_per_sec;
+    double samples_per_sec;
+} bench_result;
+
+typedef struct {
+    const char *name;
+    int16_t format;
+    int bits;
+} wave_format;
+
+const wave_format WAVE_FORMATS[] = {
+    {"lpcm16", CT_LPCM, 16},
+    {"lpcm24", CT_LPCM, 24},
+    {"float", CT_IEEEFP, 32},
+    {"mulaw", CT_MS_MLAW, 8},
+    {"alaw", CT_MS_ALAW, 8}
+};
+
+// Deterministic noise (xorshift64), the same files on every machine
+uint64_t next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+void fill_random(vector<char> *buf, uint64_t seed) {
+    uint64_t state = seed;
+    for (int64_t i=0; i + 8 <= buf->size(); i += 8) {
+        uint64_t v = next_random(&state);
+        memcpy(buf->data() + i, &v, 8);
+    }
+}
+
+// Best time of the repeats of `body` for `bytes` of input holding
+// `samples` samples
+void measure(const string& name, int64_t bytes, int64_t samples,
+        const bench_options& opts, const function<void()>& body,
+        vector<bench_result> *results) {
+    if (name.find(opts.filter) == string::npos) {
+        return;
+    }
+    double best = 0;
+    for (int r=0; r < opts.repeat; r++) {
+        auto start = chrono::steady_clock::now();
+        body();
+        double sec = chrono::duration<double>(
+            chrono::steady_clock::now() - start).count();
+        best = r == 0 ? sec : min(best, sec);
+    }
+    bench_result res = bench_result{name, bytes / best / 1e6,
+        samples / best};
+    cout << left << setw(28) << name << right << fixed << setprecision(1);
+    cout << setw(10) << res.mb_per_sec << " MB/s ";
+    cout << setw(10) << res.samples_per_sec / 1e6 << " Msamples/s";
+    cout << endl;
+    results->push_back(res);
+}
+
+void bench_kernels(const bench_options& opts,
+        vector<bench_result> *results) {
+    int channels = opts.channels;
+    vector<char> src(opts.size);
+    fill_random(&src, 1);
+
+    // Interleaved frames into channel buffers (load_channels)
+    vector<vector<char>> out(channels, vector<char>(opts.size));
+    vector<char*> dst(channels);
+    for (int ch=0; ch < channels; ch++) {
+        dst[ch] = out[ch].data();
+    }
+    int64_t frames16 = opts.size / (2 * channels);
+    deinterleave_fn split16 = select_deinterleave(2, channels);
+    measure("load_channels/s16", frames16 * 2 * channels,
+        frames16 * channels, opts, [&]() {
+            split16(src.data(), frames16, channels, dst.data());
+        }, results);
+    // 24 bit to float, converted per tile and de-interleaved
+    int64_t frames24 = opts.size / (4 * channels);
+    measure("load_channels/s24_f32", frames24 * 3 * channels,
+        frames24 * channels, opts, [&]() {
+            convert_deinterleave(select_convert(SAMPLE_S24, SAMPLE_F32),
+                select_deinterleave(4, channels), SAMPLE_S24, SAMPLE_F32,
+                src.data(), frames24, channels, dst.data(), false);
+        }, results);
+
+    // G.711 codes into 16 bit channel buffers
+    int64_t frames8 = opts.size / (2 * channels);
+    measure("mu_law_decoder", frames8 * channels, frames8 * channels, opts,
+        [&]() {
+            g711_decode(G711_ULAW, src.data(), frames8, channels,
+                dst.data());
+        }, results);
+    measure("a_law_decoder", frames8 * channels, frames8 * channels, opts,
+        [&]() {
+            g711_decode(G711_ALAW, src.data(), frames8, channels,
+                dst.data());
+        }, results);
+
+    // ADPCM blocks, split between the worker threads
+    int adpcm_channels = min(channels, 2);
+    int block = 1024 * adpcm_channels;
+    vector<char> blocks(src.begin(), src.begin() + opts.size / 4 / block *
+        block);
+    uint64_t state = 2;
+    for (int64_t b=0; b + block <= blocks.size(); b += block) {
+        // Valid block headers: predictor index, step index in range
+        for (int ch=0; ch < adpcm_channels; ch++) {
+            blocks[b + 4 * ch + 2] = static_cast<char>(
+                next_random(&state) % 89);
+            blocks[b + ch] = static_cast<char>(next_random(&state) % 7);
+        }
+    }
+    int64_t count = blocks.size() / block;
+    WorkerPool pool(opts.jobs);
+    auto decode_all = [&](int per_block, const function<void(const char*,
+            int64_t, char * const *)>& decode) {
+        pool.run(pool.Jobs(), [&](int64_t task, int worker) {
+            int64_t first = count * task / pool.Jobs();
+            int64_t last = count * (task + 1) / pool.Jobs();
+            vector<char*> to(adpcm_channels);
+            for (int ch=0; ch < adpcm_channels; ch++) {
+                to[ch] = out[ch].data() + first * per_block * 2;
+            }
+            decode(blocks.data() + first * block, last - first, to.data());
+        });
+    };
+    int ima = ima_samples_per_block(block, adpcm_channels);
+    measure("ima_decoder", blocks.size(), count * ima * adpcm_channels,
+        opts, [&]() {
+            decode_all(ima, [&](const char *from, int64_t n,
+                    char * const *to) {
+                ima_decode(from, n, block, adpcm_channels, to);
+            });
+        }, results);
+    int ms = ms_adpcm_samples_per_block(block, adpcm_channels);
+    measure("ms_adpcm_decoder", blocks.size(), count * ms * adpcm_channels,
+        opts, [&]() {
+            decode_all(ms, [&](const char *from, int64_t n,
+                    char * const *to) {
+                ms_adpcm_decode(from, n, block, ms, adpcm_channels,
+                    MS_ADPCM_COEFS, 7, to);
+            });
+        }, results);
+}
+
+// Synthetic wave file of `size` bytes of samples, written once
+string synthetic_wave(const bench_options& opts, const wave_format& fmt) {
+    string fname = opts.dir + "/asl_bench_" + fmt.name + "_" +
+        to_string(opts.channels) + "ch_" + to_string(opts.size >> 20) +
+        "mb.wav";
+    int bytes = fmt.bits / 8;
+    int64_t frames = opts.size / (bytes * opts.channels);
+    int64_t data_size = frames * bytes * opts.channels;
+    bool has_fact = fmt.format != CT_LPCM;
+    uint32_t fmt_size = has_fact ? 18 : 16;
+    int64_t riff_size = 4 + 8 + fmt_size + (has_fact ? 12 : 0) + 8 +
+        data_size;
+    bool is_rf64 = riff_size > RIFF_MAX_SIZE;
+    int64_t head_size = riff_size - data_size + 8 +
+        (is_rf64 ? 8 + sizeof(ds64_chunk) : 0);
+    struct stat st;
+    if (stat(fname.c_str(), &st) == 0 &&
+            st.st_size == head_size + data_size) {
+        return fname;
+    }
+
+    ofstream file(fname, ios::binary);
+    auto put = [&](const void *data, int64_t size) {
+        file.write(reinterpret_cast<const char*>(data), size);
+    };
+    auto put32 = [&](uint32_t value) { put(&value, 4); };
+    put(is_rf64 ? "RF64" : "RIFF", 4);
+    put32(is_rf64 ? RIFF_MAX_SIZE : riff_size);
+    put("WAVE", 4);
+    if (is_rf64) {
+        ds64_chunk ds64 = ds64_chunk{};
+        ds64.riffSize = riff_size + 8 + sizeof(ds64);
+        ds64.dataSize = data_size;
+        ds64.sampleCount = frames;
+        put("ds64", 4);
+        put32(sizeof(ds64));
+        put(&ds64, sizeof(ds64));
+    }
+    fmt_chunk head = fmt_chunk{};
+    head.AudioFormat = fmt.format;
+    head.NumOfChan = opts.channels;
+    head.SamplesPerSec = fmt.bits == 8 ? 8000 : 48000;
+    head.blockAlign = bytes * opts.channels;
+    head.bytesPerSec = head.SamplesPerSec * head.blockAlign;
+    head.bitsPerSample = fmt.bits;
+    put("fmt ", 4);
+    put32(fmt_size);
+    put(&head, fmt_size);
+    if (has_fact) {
+        put("fact", 4);
+        put32(4);
+        put32(min(frames, RIFF_MAX_SIZE));
+    }
+    put("data", 4);
+    put32(is_rf64 ? RIFF_MAX_SIZE : data_size);
+
+    // Noise in 4 MB pieces, float samples in [-0.5, 0.5)
+    vector<char> piece(4 << 20);
+    uint64_t state = 3;
+    for (int64_t done=0; done < data_size; done += piece.size()) {
+        int64_t n = min(int64_t(piece.size()), data_size - done);
+        if (fmt.format == CT_IEEEFP) {
+            for (int64_t i=0; i + 4 <= n; i += 4) {
+                float v = (next_random(&state) >> 40) / 16777216.0f - 0.5f;
+                memcpy(piece.data() + i, &v, 4);
+            }
+        } else {
+            fill_random(&piece, next_random(&state));
+        }
+        put(piece.data(), n);
+    }
+    return fname;
+}
+
+void bench_pipelines(const bench_options& opts,
+        vector<bench_result> *results) {
+    for (const wave_format& fmt : WAVE_FORMATS) {
+        string input = synthetic_wave(opts, fmt);
+        AudioSlicer as(input);
+        as.set_jobs(opts.jobs);
+        int64_t bytes = as.Size();
+        int64_t samples = as.NumSamples() * as.Channels();
+        string out = opts.dir + "/asl_bench_out_";
+
+        // extract_audio: the whole file in `jobs` slices
+        vector<chunk> slices;
+        for (int i=0; i < opts.jobs; i++) {
+            slices.push_back(chunk{as.Duration() * i / opts.jobs,
+                as.Duration() * (i + 1) / opts.jobs,
+                out + to_string(i) + ".wav"});
+        }
+        measure(string("extract_audio/") + fmt.name, bytes, samples, opts,
+            [&]() { as.slice(slices); }, results);
+        for (const chunk& slice : slices) {
+            unlink(slice.filename.c_str());
+        }
+
+        measure(string("split_channels/") + fmt.name, bytes, samples, opts,
+            [&]() { as.split_channels(out); }, results);
+        for (int ch=0; ch < as.Channels(); ch++) {
+            unlink((out + to_string(ch) + ".wav").c_str());
+        }
+    }
+}
+
+// Results of a --save file by name
+map<string, bench_result> read_baseline(const string& fname) {
+    map<string, bench_result> res;
+    ifstream file(fname);
+    bench_result r;
+    while (file >> r.name >> r.mb_per_sec >> r.samples_per_sec) {
+        res[r.name] = r;
+    }
+    return res;
+}
+
+int main(int argc, char* argv[]) {
+    bench_options opts = bench_options{64 << 20, 2,
+        WorkerPool::hardware_jobs(), 3, ".", "", "", "", 0.1};
+    for (int i=1; i + 1 < argc; i += 2) {
+        string key = argv[i], value = argv[i + 1];
+        if (key == "--size") {
+            opts.size = atoll(value.c_str()) << 20;
+        } else if (key == "--channels") {
+            opts.channels = atoi(value.c_str());
+        } else if (key == "--jobs") {
+            opts.jobs = atoi(value.c_str());
+        } else if (key == "--repeat") {
+            opts.repeat = atoi(value.c_str());
+        } else if (key == "--dir") {
+            opts.dir = value;
+        } else if (key == "--filter") {
+            opts.filter = value;
+        } else if (key == "--save") {
+            opts.save = value;
+        } else if (key == "--baseline") {
+            opts.baseline = value;
+        } else if (key == "--tolerance") {
+            opts.tolerance = atof(value.c_str());
+        } else {
+            cout << "Unknown option " << key << endl;
+            return 1;
+        }
+    }
+    if (opts.size <= 0 || opts.channels <= 0 || opts.jobs <= 0 ||
+            opts.repeat <= 0 || argc % 2 == 0) {
+        cout << "Usage: asl_bench [--size MB] [--channels N] [--jobs N] ";
+        cout << "[--repeat N] [--dir DIR] [--filter TEXT] [--save FILE] ";
+        cout << "[--baseline FILE] [--tolerance FRACTION]" << endl;
+        return 1;
+    }
+
+    cout << opts.size / (1 << 20) << " MB, " << opts.channels;
+    cout << " channels, " << opts.jobs << " threads, best of ";
+    cout << opts.repeat << endl;
+    vector<bench_result> results;
+    bench_kernels(opts, &results);
+    bench_pipelines(opts, &results);
+
+    if (!opts.save.empty()) {
+        ofstream file(opts.save);
+        for (const bench_result& r : results) {
+            file << r.name << " " << r.mb_per_sec << " ";
+            file << r.samples_per_sec << "\n";
+        }
+    }
+    int regressions = 0;
+    if (!opts.baseline.empty()) {
+        map<string, bench_result> base = read_baseline(opts.baseline);
+        cout << endl << "Against " << opts.baseline << ":" << endl;
+        for (const bench_result& r : results) {
+            if (base.count(r.name) == 0) {
+                continue;
+            }
+            double change = r.mb_per_sec / base[r.name].mb_per_sec - 1;
+            bool slower = change < -opts.tolerance;
+            regressions += slower;
+            cout << left << setw(28) << r.name << right << showpos;
+            cout << setw(8) << change * 100 << " %" << noshowpos;
+            cout << (slower ? "  REGRESSION" : "") << endl;
+        }
+    }
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+// Copyright 2023 Andrei Drozdov
+
+#include "./adpcm.h"  // NOLINT [build/include]
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace std;  // NOLINT [build/namespaces]
+
+namespace {
+
+const int16_t IMA_STEPS[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37,
+    41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173,
+    190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+    724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894,
+    6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289,
+    16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+const int8_t IMA_INDEX[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+const int16_t MS_ADAPT[16] = {
+    230, 230, 230, 230, 307, 409, 512, 614,
+    768, 614, 512, 409, 307, 230, 230, 230
+};
+
+struct ms_state {
+    int coef1;
+    int coef2;
+    int delta;
+    int sample1;
+    int sample2;
+};
+
+struct ima_state {
+    int predictor;
+    int index;
+};
+
+inline int16_t ima_sample(ima_state* state, int nibble) {
+    int step = IMA_STEPS[state->index];
+    // diff = (nibble + 0.5) * step / 4 without a multiplication
+    int diff = step >> 3;
+    if (nibble & 1) diff += step >> 2;
+    if (nibble & 2) diff += step >> 1;
+    if (nibble & 4) diff += step;
+    if (nibble & 8) diff = -diff;
+    state->predictor = min(max(state->predictor + diff, -32768), 32767);
+    state->index = min(max(state->index + IMA_INDEX[nibble], 0), 88);
+    return static_cast<int16_t>(state->predictor);
+}
+
+inline int16_t ms_sample(ms_state* state, int nibble) {
+    // Prediction from the last two samples plus the scaled error code
+    int predicted = (state->sample1 * state->coef1 +
+        state->sample2 * state->coef2) / 256;
+    int error = nibble >= 8 ? nibble - 16 : nibble;
+    int sample = min(max(predicted + error * state->delta, -32768), 32767);
+    state->sample2 = state->sample1;
+    state->sample1 = sample;
+    state->delta = max(MS_ADAPT[nibble] * state->delta / 256, 16);
+    return static_cast<int16_t>(sample);
+}
+
+int16_t read16(const uint8_t *ptr) {
+    int16_t value;
+    memcpy(&value, ptr, 2);
+    return value;
+}
+
+}  // namespace
+
+const ms_adpcm_coef MS_ADPCM_COEFS[7] = {
+    {256, 0}, {512, -256}, {0, 0}, {192, 64},
+    {240, 0}, {460, -208}, {392, -232}
+};
+
+int ima_samples_per_block(int block_bytes, int channels) {
+    if (channels <= 0 || block_bytes <= 4 * channels) {
+        return 0;
+    }
+    return (block_bytes - 4 * channels) * 2 / channels + 1;
+}
+
+void ima_decode(const char *src, int64_t blocks, int block_bytes,
+        int channels, char * const *dst) {
+    int per_block = ima_samples_per_block(block_bytes, channels);
+    const uint8_t *data = reinterpret_cast<const uint8_t*>(src);
+    for (int64_t b=0; b < blocks; b++) {
+        const uint8_t *block = data + b * block_bytes;
+        const uint8_t *body = block + 4 * channels;
+        for (int ch=0; ch < channels; ch++) {
+            int16_t *out = reinterpret_cast<int16_t*>(dst[ch]) +
+                b * per_block;
+            int16_t first;
+            memcpy(&first, block + 4 * ch, 2);
+            ima_state state = {first, min<int>(block[4 * ch + 2], 88)};
+            out[0] = first;
+            // Channel data comes in 4 byte words, one word per channel
+            int64_t pos = 1;
+            for (const uint8_t *word = body + 4 * ch;
+                    word < block + block_bytes; word += 4 * channels) {
+                for (int i=0; i < 4; i++) {
+                    out[pos++] = ima_sample(&state, word[i] & 0x0F);
+                    out[pos++] = ima_sample(&state, word[i] >> 4);
+                }
+            }
+        }
+    }
+}
+
+int ms_adpcm_samples_per_block(int block_bytes, int channels) {
+    if (channels <= 0 || block_bytes < 7 * channels) {
+        return 0;
+    }
+    return (block_bytes - 7 * channels) * 2 / channels + 2;
+}
+
+void ms_adpcm_decode(const char *src, int64_t blocks, int block_bytes,
+        int per_block, int channels, const ms_adpcm_coef *coefs,
+        int num_coefs, char * const *dst) {
+    const uint8_t *data = reinterpret_cast<const uint8_t*>(src);
+    vector<ms_state> state(channels);
+    for (int64_t b=0; b < blocks; b++) {
+        const uint8_t *block = data + b * block_bytes;
+        for (int ch=0; ch < channels; ch++) {
+            const ms_adpcm_coef& coef = coefs[min<int>(block[ch],
+                num_coefs - 1)];
+            state[ch].coef1 = coef.coef1;
+            state[ch].coef2 = coef.coef2;
+            state[ch].delta = read16(block + channels + 2 * ch);
+            state[ch].sample1 = read16(block + 3 * channels + 2 * ch);
+            state[ch].sample2 = read16(block + 5 * channels + 2 * ch);
+            // Header samples come first, the older one before
+            int16_t *out = reinterpret_cast<int16_t*>(dst[ch]) +
+                b * per_block;
+            out[0] = static_cast<int16_t>(state[ch].sample2);
+            out[1] = static_cast<int16_t>(state[ch].sample1);
+        }
+
+        // Nibbles run over the channels in turn, high nibble first
+        const uint8_t *body = block + 7 * channels;
+        int64_t nibble = 0;
+        for (int64_t i=2; i < per_block; i++) {
+            for (int ch=0; ch < channels; ch++, nibble++) {
+                uint8_t byte = body[nibble >> 1];
+                int code = nibble & 1 ? byte & 0x0F : byte >> 4;
+                reinterpret_cast<int16_t*>(dst[ch])[b * per_block + i] =
+                    ms_sample(&state[ch], code);
+            }
+        }
+    }
+}
@@ -0,0 +1,39 @@
+// Copyright 2023 Andrei Drozdov
+
+#ifndef SRC_ADPCM_H_
+#define SRC_ADPCM_H_
+
+#include <stdint.h>
+
+// ADPCM block codecs.
+// Every block of blockAlign bytes starts with the full decoder state of
+// each channel, so blocks can be decoded independently and in any order.
+
+// Intel/DVI IMA ADPCM (WAVE format 0x11), 4 bits per sample.
+// Block: per channel header {int16 sample, uint8 step index, uint8 0},
+// then groups of 4 bytes (8 samples) per channel, low nibble first.
+int ima_samples_per_block(int block_bytes, int channels);
+// Decode `blocks` consecutive blocks into 16 bit channel buffers
+void ima_decode(const char *src, int64_t blocks, int block_bytes,
+    int channels, char * const *dst);
+
+// Microsoft ADPCM (WAVE format 0x2), 4 bits per sample.
+// The extended fmt chunk carries samples per block and a table of
+// predictor coefficient pairs (8.8 fixed point). Block: per channel
+// predictor index, delta, sample 1 and sample 2 (each field for all
+// channels in turn), then nibbles for all channels, high nibble first.
+typedef struct {
+    int16_t coef1;
+    int16_t coef2;
+} ms_adpcm_coef;
+
+// The 7 pairs every MS ADPCM file starts its table with
+extern const ms_adpcm_coef MS_ADPCM_COEFS[7];
+
+int ms_adpcm_samples_per_block(int block_bytes, int channels);
+// Decode `blocks` consecutive blocks of `per_block` samples each
+void ms_adpcm_decode(const char *src, int64_t blocks, int block_bytes,
+    int per_block, int channels, const ms_adpcm_coef *coefs,
+    int num_coefs, char * const *dst);
+
+#endif  // SRC_ADPCM_H_
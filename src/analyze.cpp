@@ -0,0 +1,220 @@
+// Copyright 2023 Andrei Drozdov
+
+#include "./analyze.h"  // NOLINT [build/include]
+#include "./kernels.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+using namespace std;  // NOLINT [build/namespaces]
+
+namespace {
+
+// Sums of one window
+struct window_sums {
+    float sum;
+    float sum_sq;
+    float peak;
+    int64_t clipped;
+    // Sign changes between samples of the window
+    int64_t crossings;
+};
+
+typedef window_sums (*window_fn)(const float *x, int64_t n, float clip);
+
+// Reductions from sample `first` on, sample 0 is always scalar so the
+// vector loops can compare every sample with the one before it
+inline void scan_scalar(const float *x, int64_t first, int64_t n,
+        float clip, window_sums *res) {
+    for (int64_t i = first; i < n; i++) {
+        float a = fabs(x[i]);
+        res->sum += x[i];
+        res->sum_sq += x[i] * x[i];
+        res->peak = max(res->peak, a);
+        res->clipped += a >= clip;
+        if (i > 0) {
+            res->crossings += (x[i] < 0) != (x[i - 1] < 0);
+        }
+    }
+}
+
+#ifdef __SSE2__
+
+// Horizontal sum of 4 lanes
+inline float hsum(__m128 v) {
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+inline float hmax(__m128 v) {
+    v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+// SSE2: 4 samples per iteration
+window_sums window_sse2(const float *x, int64_t n, float clip) {
+    window_sums res = window_sums{};
+    scan_scalar(x, 0, min(n, int64_t(1)), clip, &res);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 level = _mm_set1_ps(clip);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 sum = zero, sum_sq = zero, peak = zero;
+    int64_t i = 1;
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(x + i);
+        __m128 prev = _mm_loadu_ps(x + i - 1);
+        __m128 a = _mm_andnot_ps(sign, v);
+        sum = _mm_add_ps(sum, v);
+        sum_sq = _mm_add_ps(sum_sq, _mm_mul_ps(v, v));
+        peak = _mm_max_ps(peak, a);
+        res.clipped += __builtin_popcount(
+            _mm_movemask_ps(_mm_cmpge_ps(a, level)));
+        res.crossings += __builtin_popcount(_mm_movemask_ps(
+            _mm_xor_ps(_mm_cmplt_ps(v, zero), _mm_cmplt_ps(prev, zero))));
+    }
+    res.sum += hsum(sum);
+    res.sum_sq += hsum(sum_sq);
+    res.peak = max(res.peak, hmax(peak));
+    scan_scalar(x, i, n, clip, &res);
+    return res;
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+// AVX2: 8 samples per iteration
+AVX2 window_sums window_avx2(const float *x, int64_t n, float clip) {
+    window_sums res = window_sums{};
+    scan_scalar(x, 0, min(n, int64_t(1)), clip, &res);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 level = _mm256_set1_ps(clip);
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 sum = zero, sum_sq = zero, peak = zero;
+    int64_t i = 1;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(x + i);
+        __m256 prev = _mm256_loadu_ps(x + i - 1);
+        __m256 a = _mm256_andnot_ps(sign, v);
+        sum = _mm256_add_ps(sum, v);
+        sum_sq = _mm256_add_ps(sum_sq, _mm256_mul_ps(v, v));
+        peak = _mm256_max_ps(peak, a);
+        res.clipped += __builtin_popcount(_mm256_movemask_ps(
+            _mm256_cmp_ps(a, level, _CMP_GE_OQ)));
+        res.crossings += __builtin_popcount(_mm256_movemask_ps(_mm256_xor_ps(
+            _mm256_cmp_ps(v, zero, _CMP_LT_OQ),
+            _mm256_cmp_ps(prev, zero, _CMP_LT_OQ))));
+    }
+    res.sum += hsum(_mm_add_ps(_mm256_castps256_ps128(sum),
+        _mm256_extractf128_ps(sum, 1)));
+    res.sum_sq += hsum(_mm_add_ps(_mm256_castps256_ps128(sum_sq),
+        _mm256_extractf128_ps(sum_sq, 1)));
+    res.peak = max(res.peak, hmax(_mm_max_ps(_mm256_castps256_ps128(peak),
+        _mm256_extractf128_ps(peak, 1))));
+    scan_scalar(x, i, n, clip, &res);
+    return res;
+}
+
+#undef AVX2
+
+#else
+
+window_sums window_scalar(const float *x, int64_t n, float clip) {
+    window_sums res = window_sums{};
+    scan_scalar(x, 0, n, clip, &res);
+    return res;
+}
+
+#endif  // __SSE2__
+
+window_fn select_window() {
+#ifdef __SSE2__
+    return cpu_has_avx2() ? &window_avx2 : &window_sse2;
+#else
+    return &window_scalar;
+#endif
+}
+
+}  // namespace
+
+void accumulate_signal(const float *x, int64_t n, const signal_params& params,
+        signal_sums *sums) {
+    static const window_fn scan = select_window();
+    if (n <= 0) {
+        return;
+    }
+    if (sums->samples == 0) {
+        sums->first = x[0];
+    } else {
+        sums->crossings += (x[0] < 0) != (sums->last < 0);
+    }
+    for (int64_t done = 0; done < n; done += params.window) {
+        int64_t size = min(params.window, n - done);
+        window_sums w = scan(x + done, size, params.clip_level);
+        sums->sum += w.sum;
+        sums->sum_sq += w.sum_sq;
+        sums->peak = max(sums->peak, w.peak);
+        sums->clipped += w.clipped;
+        sums->crossings += w.crossings;
+        if (done > 0) {
+            sums->crossings += (x[done] < 0) != (x[done - 1] < 0);
+        }
+        sums->windows++;
+        sums->silent_windows += sqrt(w.sum_sq / size) < params.silence_level;
+    }
+    sums->samples += n;
+    sums->last = x[n - 1];
+}
+
+void merge_signal(signal_sums *sums, const signal_sums& next) {
+    if (next.samples == 0) {
+        return;
+    }
+    if (sums->samples == 0) {
+        *sums = next;
+        return;
+    }
+    sums->crossings += next.crossings + ((next.first < 0) != (sums->last < 0));
+    sums->samples += next.samples;
+    sums->sum += next.sum;
+    sums->sum_sq += next.sum_sq;
+    sums->peak = max(sums->peak, next.peak);
+    sums->clipped += next.clipped;
+    sums->windows += next.windows;
+    sums->silent_windows += next.silent_windows;
+    sums->last = next.last;
+}
+
+void frame_features(const float *x, int64_t n, int64_t frame,
+        float *energy, float *zcr) {
+    static const window_fn scan = select_window();
+    for (int64_t i = 0; i * frame < n; i++) {
+        int64_t size = min(frame, n - i * frame);
+        window_sums w = scan(x + i * frame, size, HUGE_VALF);
+        energy[i] = w.sum_sq / size;
+        zcr[i] = size > 1 ? static_cast<float>(w.crossings) / (size - 1) : 0;
+    }
+}
+
+channel_stats finish_signal(const signal_sums& sums) {
+    channel_stats stats = channel_stats{};
+    if (sums.samples == 0) {
+        return stats;
+    }
+    double n = static_cast<double>(sums.samples);
+    stats.peak = sums.peak;
+    stats.rms = sqrt(sums.sum_sq / n);
+    stats.dc_offset = sums.sum / n;
+    stats.clipped = sums.clipped;
+    stats.zero_crossing_rate = sums.samples > 1 ?
+        static_cast<double>(sums.crossings) / (n - 1) : 0;
+    stats.silence_ratio = static_cast<double>(sums.silent_windows) /
+        static_cast<double>(sums.windows);
+    return stats;
+}
@@ -0,0 +1,62 @@
+// Copyright 2023 Andrei Drozdov
+
+#ifndef SRC_ANALYZE_H_
+#define SRC_ANALYZE_H_
+
+#include <stdint.h>
+
+// Signal statistics of float samples (full scale is 1.0).
+// Samples are scanned in fixed windows: silence is decided per window
+// by its RMS level, sums are kept per window in float and added up in
+// double, so long files don't lose precision.
+
+typedef struct {
+    // Frames per window
+    int64_t window;
+    // Windows with a lower RMS are silent (linear level)
+    float silence_level;
+    // Samples with a magnitude at or above this level are clipped
+    float clip_level;
+} signal_params;
+
+// Running sums of one channel, ranges may be merged in time order
+typedef struct {
+    int64_t samples;
+    double sum;
+    double sum_sq;
+    float peak;
+    int64_t clipped;
+    int64_t crossings;
+    int64_t windows;
+    int64_t silent_windows;
+    // Edge samples, for crossings between merged ranges
+    float first;
+    float last;
+} signal_sums;
+
+typedef struct {
+    float peak;
+    double rms;
+    // Mean sample value
+    double dc_offset;
+    int64_t clipped;
+    // Sign changes per pair of adjacent samples
+    double zero_crossing_rate;
+    // Share of silent windows
+    double silence_ratio;
+} channel_stats;
+
+// Add n samples starting at a window boundary. SSE2/AVX2 versions are
+// picked at runtime when the CPU supports them.
+void accumulate_signal(const float *x, int64_t n, const signal_params& params,
+    signal_sums *sums);
+// Append the sums of the range that follows
+void merge_signal(signal_sums *sums, const signal_sums& next);
+channel_stats finish_signal(const signal_sums& sums);
+
+// Mean square and zero-crossing rate of consecutive frames of `frame`
+// samples, the last frame may be shorter
+void frame_features(const float *x, int64_t n, int64_t frame,
+    float *energy, float *zcr);
+
+#endif  // SRC_ANALYZE_H_
@@ -0,0 +1,141 @@
+// Copyright 2023 Andrei Drozdov
+
+#include "./buffers.h"  // NOLINT [build/include]
+#include "./stats.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <mutex>  // NOLINT [build/c++11]
+#include <vector>
+
+using namespace std;  // NOLINT [build/namespaces]
+
+int64_t buffer_class(int64_t size) {
+    int64_t step = BUFFER_ALIGN;
+    while (step * 8 < size) {
+        step *= 2;
+    }
+    return max((size + step - 1) / step * step, BUFFER_ALIGN);
+}
+
+BufferPool::BufferPool(int64_t limit) : idle(), idle_bytes(0),
+        limit(limit), allocations(0) {}
+
+BufferPool::~BufferPool() {
+    this->trim();
+}
+
+char* BufferPool::acquire(int64_t size, int64_t* capacity) {
+    *capacity = buffer_class(size);
+    {
+        lock_guard<mutex> guard(this->lock);
+        auto it = this->idle.find(*capacity);
+        if (it != this->idle.end() && !it->second.empty()) {
+            char *buf = it->second.back();
+            it->second.pop_back();
+            this->idle_bytes -= *capacity;
+            return buf;
+        }
+        this->allocations++;
+    }
+    void *buf = nullptr;
+    if (posix_memalign(&buf, BUFFER_ALIGN, *capacity) != 0) {
+        cout << "Unable to allocate sample buffers" << endl;
+        exit(1);
+    }
+    STATS_ALLOC(*capacity);
+    return reinterpret_cast<char*>(buf);
+}
+
+void BufferPool::release(char* buf, int64_t capacity) {
+    {
+        lock_guard<mutex> guard(this->lock);
+        if (this->idle_bytes + capacity <= this->limit) {
+            this->idle[capacity].push_back(buf);
+            this->idle_bytes += capacity;
+            return;
+        }
+    }
+    free(buf);
+}
+
+void BufferPool::trim() {
+    lock_guard<mutex> guard(this->lock);
+    for (auto& it : this->idle) {
+        for (char *buf : it.second) {
+            free(buf);
+        }
+    }
+    this->idle.clear();
+    this->idle_bytes = 0;
+}
+
+void BufferPool::set_limit(int64_t limit) {
+    // Drop idle buffers above the new limit, largest first
+    lock_guard<mutex> guard(this->lock);
+    this->limit = limit;
+    for (auto it = this->idle.rbegin(); it != this->idle.rend() &&
+            this->idle_bytes > this->limit; ++it) {
+        while (!it->second.empty() && this->idle_bytes > this->limit) {
+            free(it->second.back());
+            it->second.pop_back();
+            this->idle_bytes -= it->first;
+        }
+    }
+}
+
+int64_t BufferPool::Idle() {
+    lock_guard<mutex> guard(this->lock);
+    return this->idle_bytes;
+}
+
+int64_t BufferPool::Allocations() {
+    lock_guard<mutex> guard(this->lock);
+    return this->allocations;
+}
+
+BufferPool& BufferPool::shared() {
+    // Never destroyed: buffers of static objects may come back after
+    // the end of main
+    static BufferPool *pool = new BufferPool(DEFAULT_POOL_LIMIT);
+    return *pool;
+}
+
+SampleBuffer::SampleBuffer() : buf(nullptr), capacity(0) {}
+
+SampleBuffer::SampleBuffer(int64_t size) : buf(nullptr), capacity(0) {
+    this->buf = BufferPool::shared().acquire(size, &this->capacity);
+}
+
+SampleBuffer::~SampleBuffer() {
+    this->reset();
+}
+
+SampleBuffer::SampleBuffer(SampleBuffer&& other) noexcept
+        : buf(other.buf), capacity(other.capacity) {
+    other.buf = nullptr;
+    other.capacity = 0;
+}
+
+SampleBuffer& SampleBuffer::operator=(SampleBuffer&& other) noexcept {
+    if (this != &other) {
+        this->reset();
+        this->buf = other.buf;
+        this->capacity = other.capacity;
+        other.buf = nullptr;
+        other.capacity = 0;
+    }
+    return *this;
+}
+
+void SampleBuffer::reset() {
+    if (this->buf != nullptr) {
+        BufferPool::shared().release(this->buf, this->capacity);
+        this->buf = nullptr;
+        this->capacity = 0;
+    }
+}
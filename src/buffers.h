@@ -0,0 +1,78 @@
+// Copyright 2023 Andrei Drozdov
+
+#ifndef SRC_BUFFERS_H_
+#define SRC_BUFFERS_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <mutex>  // NOLINT [build/c++11]
+#include <vector>
+
+// Alignment of sample buffers: vector loads and stores never split
+// cache lines
+const int64_t BUFFER_ALIGN = 64;
+
+// Idle bytes the shared pool keeps by default
+const int64_t DEFAULT_POOL_LIMIT = int64_t(256) << 20;
+
+// Sizes are rounded up to classes (multiples of BUFFER_ALIGN, four per
+// power of two above 512 bytes) so streams of similar files share
+// buffers
+int64_t buffer_class(int64_t size);
+
+// Cache line aligned buffers kept for reuse.
+// Released buffers wait in the pool for the next request of the same
+// size class; batch runs over many files stop allocating after the
+// first one. Idle buffers beyond the limit are freed. Thread safe.
+class BufferPool{
+ public:
+        explicit BufferPool(int64_t limit);
+        ~BufferPool();
+        BufferPool(const BufferPool&) = delete;
+        BufferPool& operator=(const BufferPool&) = delete;
+
+        // At least `size` bytes, the actual size goes to *capacity
+        char* acquire(int64_t size, int64_t* capacity);
+        void release(char* buf, int64_t capacity);
+        // Free all idle buffers
+        void trim();
+        void set_limit(int64_t limit);
+
+        int64_t Idle();
+        // Buffers allocated (not taken from the pool) so far
+        int64_t Allocations();
+
+        // Pool of all AudioSlicer streams
+        static BufferPool& shared();
+
+ private:
+        std::mutex lock;
+        // Idle buffers by size class
+        std::map<int64_t, std::vector<char*>> idle;
+        int64_t idle_bytes;
+        int64_t limit;
+        int64_t allocations;
+};
+
+// Buffer of the shared pool, given back when it goes out of scope
+class SampleBuffer{
+ public:
+        SampleBuffer();
+        explicit SampleBuffer(int64_t size);
+        ~SampleBuffer();
+        SampleBuffer(SampleBuffer&& other) noexcept;
+        SampleBuffer& operator=(SampleBuffer&& other) noexcept;
+        SampleBuffer(const SampleBuffer&) = delete;
+        SampleBuffer& operator=(const SampleBuffer&) = delete;
+
+        inline char* data() const { return this->buf; }
+        inline int64_t Capacity() const { return this->capacity; }
+        void reset();
+
+ private:
+        char* buf;
+        int64_t capacity;
+};
+
+#endif  // SRC_BUFFERS_H_
@@ -0,0 +1,611 @@
+// Copyright 2023 Andrei Drozdov
+
+#include "./convert.h"  // NOLINT [build/include]
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+using namespace std;  // NOLINT [build/namespaces]
+
+namespace {
+
+// Converted data per tile, small enough to stay in L1
+const int64_t TILE_BYTES = 16384;
+
+constexpr int BYTES[] = {0, 1, 2, 3, 4, 4, 8};
+constexpr int BITS[] = {0, 8, 16, 24, 32, 32, 64};
+
+// Dither noise generator: xorshift32 lanes, one set per thread so
+// parallel slices never share state. Scalar code uses lane 0.
+struct dither_state {
+    uint32_t lane[8];
+};
+
+thread_local dither_state rng = {{
+    0x9E3779B9, 0x7F4A7C15, 0x85EBCA6B, 0xC2B2AE35,
+    0x27D4EB2F, 0x165667B1, 0xD3A2646C, 0xFD7046C5
+}};
+
+inline uint32_t xorshift(uint32_t s) {
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+// Sum of two uniform values: triangular noise in [-1, 1)
+inline float tpdf(uint32_t *state) {
+    *state = xorshift(*state);
+    return static_cast<float>((*state & 0xFFFF) + (*state >> 16)) *
+        (1.0f / 65536) - 1.0f;
+}
+
+// Triangular noise of +-1 LSB of a sample `shift` bits narrower,
+// in LSB of the wider one
+inline int64_t tpdf_lsb(uint32_t *state, int shift) {
+    *state = xorshift(*state);
+    int64_t sum = int64_t(*state & 0xFFFF) + (*state >> 16) - 65536;
+    return shift >= 16 ? sum * (int64_t(1) << (shift - 16)) :
+        sum >> (16 - shift);
+}
+
+// Integer samples as signed 32 bit values
+template <sample_type T>
+inline int32_t load_int(const char *p) {
+    if constexpr (T == SAMPLE_U8) {
+        return static_cast<int32_t>(static_cast<uint8_t>(*p)) - 128;
+    } else if constexpr (T == SAMPLE_S16) {
+        int16_t v;
+        memcpy(&v, p, 2);
+        return v;
+    } else if constexpr (T == SAMPLE_S24) {
+        const uint8_t *b = reinterpret_cast<const uint8_t*>(p);
+        return static_cast<int32_t>(b[0] | (b[1] << 8) |
+            (static_cast<uint32_t>(static_cast<int8_t>(b[2])) << 16));
+    } else {
+        int32_t v;
+        memcpy(&v, p, 4);
+        return v;
+    }
+}
+
+template <sample_type T>
+inline void store_int(char *p, int32_t v) {
+    if constexpr (T == SAMPLE_U8) {
+        *p = static_cast<char>(v + 128);
+    } else if constexpr (T == SAMPLE_S16) {
+        int16_t s = static_cast<int16_t>(v);
+        memcpy(p, &s, 2);
+    } else if constexpr (T == SAMPLE_S24) {
+        p[0] = static_cast<char>(v);
+        p[1] = static_cast<char>(v >> 8);
+        p[2] = static_cast<char>(v >> 16);
+    } else {
+        memcpy(p, &v, 4);
+    }
+}
+
+// Scale, round and clip one float sample to a T sample
+template <sample_type T, typename F>
+inline int32_t quantize(F x, F noise) {
+    const F top = static_cast<F>(int64_t(1) << (BITS[T] - 1));
+    x = x * top + noise;
+    if (x != x) {
+        x = 0;
+    }
+    x = min(max(x, -top), top);
+    return static_cast<int32_t>(min(llrint(x),
+        static_cast<long long>(top) - 1));  // NOLINT [runtime/int]
+}
+
+// Scalar kernels
+
+template <sample_type From, typename F>
+void int_to_float_scalar(const char *src, int64_t samples, char *dst,
+        bool dither) {
+    const F scale = F(1) / static_cast<F>(int64_t(1) << (BITS[From] - 1));
+    for (int64_t i = 0; i < samples; i++) {
+        F v = static_cast<F>(load_int<From>(src + i * BYTES[From])) * scale;
+        memcpy(dst + i * sizeof(F), &v, sizeof(F));
+    }
+}
+
+template <typename F, sample_type To>
+void float_to_int_scalar(const char *src, int64_t samples, char *dst,
+        bool dither) {
+    for (int64_t i = 0; i < samples; i++) {
+        F x;
+        memcpy(&x, src + i * sizeof(F), sizeof(F));
+        F noise = dither ? tpdf(&rng.lane[0]) : 0;
+        store_int<To>(dst + i * BYTES[To], quantize<To>(x, noise));
+    }
+}
+
+template <typename F, typename G>
+void float_to_float_scalar(const char *src, int64_t samples, char *dst,
+        bool dither) {
+    for (int64_t i = 0; i < samples; i++) {
+        F x;
+        memcpy(&x, src + i * sizeof(F), sizeof(F));
+        G y = static_cast<G>(x);
+        memcpy(dst + i * sizeof(G), &y, sizeof(G));
+    }
+}
+
+// Integer depth conversions: widening shifts the sample up, narrowing
+// rounds half up (after the dither noise) and clips
+template <sample_type From, sample_type To>
+void int_to_int_scalar(const char *src, int64_t samples, char *dst,
+        bool dither) {
+    constexpr int shift = BITS[From] - BITS[To];
+    constexpr int64_t hi = (int64_t(1) << (BITS[To] - 1)) - 1;
+    for (int64_t i = 0; i < samples; i++) {
+        int64_t v = load_int<From>(src + i * BYTES[From]);
+        if constexpr (shift <= 0) {
+            v *= int64_t(1) << -shift;
+        } else {
+            int64_t noise = dither ? tpdf_lsb(&rng.lane[0], shift) : 0;
+            v = (v + noise + (int64_t(1) << (shift - 1))) >> shift;
+            v = min(max(v, -hi - 1), hi);
+        }
+        store_int<To>(dst + i * BYTES[To], static_cast<int32_t>(v));
+    }
+}
+
+#ifdef __SSE2__
+
+// float -> integer in 4 lanes: scale, add noise, NaN -> 0, clip.
+// 2^31 is the first float above the 32 bit range, the conversion
+// returns INT_MIN for it, flipping the bits gives INT_MAX.
+struct quantizer {
+    __m128 scale;
+    __m128 lo;
+    __m128 hi;
+    __m128 top;
+};
+
+quantizer make_quantizer(int bits) {
+    float top = static_cast<float>(int64_t(1) << (bits - 1));
+    return quantizer{_mm_set1_ps(top), _mm_set1_ps(-top),
+        _mm_set1_ps(static_cast<float>((int64_t(1) << (bits - 1)) - 1)),
+        _mm_set1_ps(top)};
+}
+
+inline __m128i quantize4(const quantizer& q, __m128 x, __m128 noise) {
+    x = _mm_add_ps(_mm_mul_ps(x, q.scale), noise);
+    x = _mm_and_ps(x, _mm_cmpord_ps(x, x));
+    x = _mm_min_ps(_mm_max_ps(x, q.lo), q.hi);
+    return _mm_xor_si128(_mm_cvtps_epi32(x),
+        _mm_castps_si128(_mm_cmpge_ps(x, q.top)));
+}
+
+inline __m128 tpdf4(__m128i *state) {
+    __m128i s = *state;
+    s = _mm_xor_si128(s, _mm_slli_epi32(s, 13));
+    s = _mm_xor_si128(s, _mm_srli_epi32(s, 17));
+    s = _mm_xor_si128(s, _mm_slli_epi32(s, 5));
+    *state = s;
+    __m128i sum = _mm_add_epi32(
+        _mm_and_si128(s, _mm_set1_epi32(0xFFFF)), _mm_srli_epi32(s, 16));
+    return _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(sum),
+        _mm_set1_ps(1.0f / 65536)), _mm_set1_ps(1.0f));
+}
+
+inline __m128 load_ps(const char *p) {
+    return _mm_loadu_ps(reinterpret_cast<const float*>(p));
+}
+
+inline void store_si(char *p, __m128i v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+
+// SSE2, float -> integer: 8 samples per iteration
+template <sample_type To>
+void f32_to_int_sse2(const char *src, int64_t samples, char *dst,
+        bool dither) {
+    const quantizer q = make_quantizer(BITS[To]);
+    __m128i state = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(rng.lane));
+    const __m128 zero = _mm_setzero_ps();
+    int64_t i = 0;
+    for (; i + 8 <= samples; i += 8) {
+        __m128i a = quantize4(q, load_ps(src + i * 4),
+            dither ? tpdf4(&state) : zero);
+        __m128i b = quantize4(q, load_ps(src + i * 4 + 16),
+            dither ? tpdf4(&state) : zero);
+        if constexpr (To == SAMPLE_S16) {
+            store_si(dst + i * 2, _mm_packs_epi32(a, b));
+        } else if constexpr (To == SAMPLE_S32) {
+            store_si(dst + i * 4, a);
+            store_si(dst + i * 4 + 16, b);
+        } else {
+            // 8 and 24 bit samples are stored one by one
+            alignas(16) int32_t v[8];
+            _mm_store_si128(reinterpret_cast<__m128i*>(v), a);
+            _mm_store_si128(reinterpret_cast<__m128i*>(v + 4), b);
+            for (int k = 0; k < 8; k++) {
+                store_int<To>(dst + (i + k) * BYTES[To], v[k]);
+            }
+        }
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(rng.lane), state);
+    float_to_int_scalar<float, To>(src + i * 4, samples - i,
+        dst + i * BYTES[To], dither);
+}
+
+// SSE2, integer -> float: 8 samples per iteration
+template <sample_type From>
+void int_to_f32_sse2(const char *src, int64_t samples, char *dst,
+        bool dither) {
+    const __m128 scale = _mm_set1_ps(
+        1.0f / static_cast<float>(int64_t(1) << (BITS[From] - 1)));
+    int64_t i = 0;
+    for (; i + 8 <= samples; i += 8) {
+        __m128i a, b;
+        if constexpr (From == SAMPLE_S16) {
+            __m128i v = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(src + i * 2));
+            // sign extend by shifting the sample into the high half
+            a = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+            b = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        } else if constexpr (From == SAMPLE_S32) {
+            a = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(src + i * 4));
+            b = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(src + i * 4 + 16));
+        } else {
+            alignas(16) int32_t v[8];
+            for (int k = 0; k < 8; k++) {
+                v[k] = load_int<From>(src + (i + k) * BYTES[From]);
+            }
+            a = _mm_load_si128(reinterpret_cast<const __m128i*>(v));
+            b = _mm_load_si128(reinterpret_cast<const __m128i*>(v + 4));
+        }
+        _mm_storeu_ps(reinterpret_cast<float*>(dst + i * 4),
+            _mm_mul_ps(_mm_cvtepi32_ps(a), scale));
+        _mm_storeu_ps(reinterpret_cast<float*>(dst + i * 4 + 16),
+            _mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+    }
+    int_to_float_scalar<From, float>(src + i * BYTES[From], samples - i,
+        dst + i * 4, dither);
+}
+
+// SSE2, 16 -> 32 bit: 8 samples per iteration
+void s16_to_s32_sse2(const char *src, int64_t samples, char *dst,
+        bool dither) {
+    const __m128i zero = _mm_setzero_si128();
+    int64_t i = 0;
+    for (; i + 8 <= samples; i += 8) {
+        __m128i v = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(src + i * 2));
+        // the sample goes to the high half of each 32 bit lane
+        store_si(dst + i * 4, _mm_unpacklo_epi16(zero, v));
+        store_si(dst + i * 4 + 16, _mm_unpackhi_epi16(zero, v));
+    }
+    int_to_int_scalar<SAMPLE_S16, SAMPLE_S32>(src + i * 2, samples - i,
+        dst + i * 4, dither);
+}
+
+// SSE2, 8 bit unsigned -> 16 bit: 16 samples per iteration
+void u8_to_s16_sse2(const char *src, int64_t samples, char *dst,
+        bool dither) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+    int64_t i = 0;
+    for (; i + 16 <= samples; i += 16) {
+        // flipping the top bit gives v - 128 as a signed byte
+        __m128i v = _mm_xor_si128(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(src + i)), bias);
+        store_si(dst + i * 2, _mm_unpacklo_epi8(zero, v));
+        store_si(dst + i * 2 + 16, _mm_unpackhi_epi8(zero, v));
+    }
+    int_to_int_scalar<SAMPLE_U8, SAMPLE_S16>(src + i, samples - i,
+        dst + i * 2, dither);
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 inline __m256i quantize8(__m256 x, __m256 noise, int bits) {
+    float top = static_cast<float>(int64_t(1) << (bits - 1));
+    x = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(top)), noise);
+    x = _mm256_and_ps(x, _mm256_cmp_ps(x, x, _CMP_ORD_Q));
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-top)),
+        _mm256_set1_ps(static_cast<float>((int64_t(1) << (bits - 1)) - 1)));
+    return _mm256_xor_si256(_mm256_cvtps_epi32(x), _mm256_castps_si256(
+        _mm256_cmp_ps(x, _mm256_set1_ps(top), _CMP_GE_OQ)));
+}
+
+AVX2 inline __m256 tpdf8(__m256i *state) {
+    __m256i s = *state;
+    s = _mm256_xor_si256(s, _mm256_slli_epi32(s, 13));
+    s = _mm256_xor_si256(s, _mm256_srli_epi32(s, 17));
+    s = _mm256_xor_si256(s, _mm256_slli_epi32(s, 5));
+    *state = s;
+    __m256i sum = _mm256_add_epi32(_mm256_and_si256(
+        s, _mm256_set1_epi32(0xFFFF)), _mm256_srli_epi32(s, 16));
+    return _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(sum),
+        _mm256_set1_ps(1.0f / 65536)), _mm256_set1_ps(1.0f));
+}
+
+// AVX2, float -> 16/32 bit: 16 samples per iteration
+template <sample_type To>
+AVX2 void f32_to_int_avx2(const char *src, int64_t samples, char *dst,
+        bool dither) {
+    __m256i state = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(rng.lane));
+    const __m256 zero = _mm256_setzero_ps();
+    int64_t i = 0;
+    for (; i + 16 <= samples; i += 16) {
+        __m256i a = quantize8(_mm256_loadu_ps(
+            reinterpret_cast<const float*>(src + i * 4)),
+            dither ? tpdf8(&state) : zero, BITS[To]);
+        __m256i b = quantize8(_mm256_loadu_ps(
+            reinterpret_cast<const float*>(src + i * 4 + 32)),
+            dither ? tpdf8(&state) : zero, BITS[To]);
+        if constexpr (To == SAMPLE_S16) {
+            // pack works per 128 bit lane, restore the order
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2),
+                _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8));
+        } else {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), a);
+            _mm256_storeu_si256(
+                reinterpret_cast<__m256i*>(dst + i * 4 + 32), b);
+        }
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(rng.lane), state);
+    f32_to_int_sse2<To>(src + i * 4, samples - i, dst + i * BYTES[To],
+        dither);
+}
+
+// AVX2, 16/32 bit -> float: 16 samples per iteration
+template <sample_type From>
+AVX2 void int_to_f32_avx2(const char *src, int64_t samples, char *dst,
+        bool dither) {
+    const __m256 scale = _mm256_set1_ps(
+        1.0f / static_cast<float>(int64_t(1) << (BITS[From] - 1)));
+    int64_t i = 0;
+    for (; i + 16 <= samples; i += 16) {
+        __m256i a, b;
+        if constexpr (From == SAMPLE_S16) {
+            a = _mm256_cvtepi16_epi32(_mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(src + i * 2)));
+            b = _mm256_cvtepi16_epi32(_mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(src + i * 2 + 16)));
+        } else {
+            a = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(src + i * 4));
+            b = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(src + i * 4 + 32));
+        }
+        _mm256_storeu_ps(reinterpret_cast<float*>(dst + i * 4),
+            _mm256_mul_ps(_mm256_cvtepi32_ps(a), scale));
+        _mm256_storeu_ps(reinterpret_cast<float*>(dst + i * 4 + 32),
+            _mm256_mul_ps(_mm256_cvtepi32_ps(b), scale));
+    }
+    int_to_f32_sse2<From>(src + i * BYTES[From], samples - i, dst + i * 4,
+        dither);
+}
+
+// Four packed 24 bit samples of each 128 bit lane as 32 bit values
+AVX2 inline __m256i load_s24x8(const char *p) {
+    const __m256i order = _mm256_setr_epi8(
+        -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+        -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)), 1);
+    // bytes go to the top of each lane, the shift restores the sign
+    return _mm256_srai_epi32(_mm256_shuffle_epi8(v, order), 8);
+}
+
+// Noise of tpdf_lsb() for 8 bit narrower samples in 8 lanes
+AVX2 inline __m256i tpdf_lsb8(__m256i *state) {
+    __m256i s = *state;
+    s = _mm256_xor_si256(s, _mm256_slli_epi32(s, 13));
+    s = _mm256_xor_si256(s, _mm256_srli_epi32(s, 17));
+    s = _mm256_xor_si256(s, _mm256_slli_epi32(s, 5));
+    *state = s;
+    __m256i sum = _mm256_add_epi32(_mm256_and_si256(
+        s, _mm256_set1_epi32(0xFFFF)), _mm256_srli_epi32(s, 16));
+    return _mm256_srai_epi32(
+        _mm256_sub_epi32(sum, _mm256_set1_epi32(65536)), 8);
+}
+
+// AVX2, 24 -> 16 bit: 16 samples per iteration
+AVX2 void s24_to_s16_avx2(const char *src, int64_t samples, char *dst,
+        bool dither) {
+    __m256i state = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(rng.lane));
+    const __m256i half = _mm256_set1_epi32(128);
+    int64_t i = 0;
+    // 16 bytes are loaded for every 12 used: stop 4 bytes early
+    for (; i + 18 <= samples; i += 16) {
+        __m256i a = _mm256_add_epi32(load_s24x8(src + i * 3), half);
+        __m256i b = _mm256_add_epi32(load_s24x8(src + i * 3 + 24), half);
+        if (dither) {
+            a = _mm256_add_epi32(a, tpdf_lsb8(&state));
+            b = _mm256_add_epi32(b, tpdf_lsb8(&state));
+        }
+        // pack saturates to the 16 bit range and works per lane
+        __m256i res = _mm256_packs_epi32(
+            _mm256_srai_epi32(a, 8), _mm256_srai_epi32(b, 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2),
+            _mm256_permute4x64_epi64(res, 0xD8));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(rng.lane), state);
+    int_to_int_scalar<SAMPLE_S24, SAMPLE_S16>(src + i * 3, samples - i,
+        dst + i * 2, dither);
+}
+
+#undef AVX2
+
+#endif  // __SSE2__
+
+template <sample_type T>
+convert_fn to_f32() {
+#ifdef __SSE2__
+    if constexpr (T == SAMPLE_S16 || T == SAMPLE_S32) {
+        if (cpu_has_avx2()) {
+            return &int_to_f32_avx2<T>;
+        }
+    }
+    return &int_to_f32_sse2<T>;
+#else
+    return &int_to_float_scalar<T, float>;
+#endif
+}
+
+template <sample_type T>
+convert_fn from_f32() {
+#ifdef __SSE2__
+    if constexpr (T == SAMPLE_S16 || T == SAMPLE_S32) {
+        if (cpu_has_avx2()) {
+            return &f32_to_int_avx2<T>;
+        }
+    }
+    return &f32_to_int_sse2<T>;
+#else
+    return &float_to_int_scalar<float, T>;
+#endif
+}
+
+template <sample_type From>
+convert_fn int_to_int(sample_type to) {
+    switch (to) {
+        case SAMPLE_U8: return &int_to_int_scalar<From, SAMPLE_U8>;
+        case SAMPLE_S16: return &int_to_int_scalar<From, SAMPLE_S16>;
+        case SAMPLE_S24: return &int_to_int_scalar<From, SAMPLE_S24>;
+        case SAMPLE_S32: return &int_to_int_scalar<From, SAMPLE_S32>;
+        default: return nullptr;
+    }
+}
+
+convert_fn select_int_convert(sample_type from, sample_type to) {
+#ifdef __SSE2__
+    if (from == SAMPLE_S16 && to == SAMPLE_S32) {
+        return &s16_to_s32_sse2;
+    }
+    if (from == SAMPLE_U8 && to == SAMPLE_S16) {
+        return &u8_to_s16_sse2;
+    }
+    if (from == SAMPLE_S24 && to == SAMPLE_S16 && cpu_has_avx2()) {
+        return &s24_to_s16_avx2;
+    }
+#endif
+    switch (from) {
+        case SAMPLE_U8: return int_to_int<SAMPLE_U8>(to);
+        case SAMPLE_S16: return int_to_int<SAMPLE_S16>(to);
+        case SAMPLE_S24: return int_to_int<SAMPLE_S24>(to);
+        case SAMPLE_S32: return int_to_int<SAMPLE_S32>(to);
+        default: return nullptr;
+    }
+}
+
+template <sample_type T>
+convert_fn int_convert(sample_type to, bool from_float) {
+    switch (to) {
+        case SAMPLE_F32:
+            return from_float ? from_f32<T>() : to_f32<T>();
+        case SAMPLE_F64:
+            return from_float ? &float_to_int_scalar<double, T> :
+                &int_to_float_scalar<T, double>;
+        default:
+            return nullptr;
+    }
+}
+
+}  // namespace
+
+sample_type sample_type_of(bool is_float, int bytes) {
+    if (is_float) {
+        return bytes == 4 ? SAMPLE_F32 : bytes == 8 ? SAMPLE_F64 :
+            SAMPLE_NONE;
+    }
+    switch (bytes) {
+        case 1: return SAMPLE_U8;
+        case 2: return SAMPLE_S16;
+        case 3: return SAMPLE_S24;
+        case 4: return SAMPLE_S32;
+    }
+    return SAMPLE_NONE;
+}
+
+int sample_bytes(sample_type type) {
+    return BYTES[type];
+}
+
+bool is_float_sample(sample_type type) {
+    return type == SAMPLE_F32 || type == SAMPLE_F64;
+}
+
+convert_fn select_convert(sample_type from, sample_type to) {
+    if (from == to) {
+        return nullptr;
+    }
+    if (!is_float_sample(from) && !is_float_sample(to)) {
+        return select_int_convert(from, to);
+    }
+    if (from == SAMPLE_F32 && to == SAMPLE_F64) {
+        return &float_to_float_scalar<float, double>;
+    }
+    if (from == SAMPLE_F64 && to == SAMPLE_F32) {
+        return &float_to_float_scalar<double, float>;
+    }
+    // Integer <-> float pairs, looked up by the integer side
+    bool from_float = is_float_sample(from);
+    sample_type other = from_float ? from : to;
+    switch (from_float ? to : from) {
+        case SAMPLE_U8: return int_convert<SAMPLE_U8>(other, from_float);
+        case SAMPLE_S16: return int_convert<SAMPLE_S16>(other, from_float);
+        case SAMPLE_S24: return int_convert<SAMPLE_S24>(other, from_float);
+        case SAMPLE_S32: return int_convert<SAMPLE_S32>(other, from_float);
+        default: return nullptr;
+    }
+}
+
+void convert_deinterleave(convert_fn convert, deinterleave_fn deinterleave,
+        sample_type from, sample_type to, const char *src, int64_t frames,
+        int channels, char * const *dst, bool dither) {
+    if (channels == 1) {
+        convert(src, frames, dst[0], dither);
+        return;
+    }
+    int64_t from_frame = sample_bytes(from) * channels;
+    int64_t to_bytes = sample_bytes(to);
+    int64_t step = max(TILE_BYTES / (to_bytes * channels), int64_t(1));
+    vector<char> tile(step * to_bytes * channels);
+    vector<char*> out(dst, dst + channels);
+    for (int64_t done = 0; done < frames; done += step) {
+        int64_t n = min(step, frames - done);
+        convert(src + done * from_frame, n * channels, tile.data(), dither);
+        deinterleave(tile.data(), n, channels, out.data());
+        for (int ch = 0; ch < channels; ch++) {
+            out[ch] += n * to_bytes;
+        }
+    }
+}
+
+void convert_in_place(convert_fn convert, sample_type from, sample_type to,
+        char *buf, int64_t samples, bool dither) {
+    int64_t from_bytes = sample_bytes(from);
+    int64_t to_bytes = sample_bytes(to);
+    int64_t step = TILE_BYTES / max(from_bytes, to_bytes);
+    vector<char> tile(step * from_bytes);
+    int64_t tiles = (samples + step - 1) / step;
+    for (int64_t k = 0; k < tiles; k++) {
+        // Widening runs from the end: a tile only overwrites input
+        // that was already converted
+        int64_t first = (to_bytes > from_bytes ? tiles - 1 - k : k) * step;
+        int64_t n = min(step, samples - first);
+        memcpy(tile.data(), buf + first * from_bytes, n * from_bytes);
+        convert(tile.data(), n, buf + first * to_bytes, dither);
+    }
+}
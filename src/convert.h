@@ -0,0 +1,53 @@
+// Copyright 2023 Andrei Drozdov
+
+#ifndef SRC_CONVERT_H_
+#define SRC_CONVERT_H_
+
+#include <stdint.h>
+
+#include "./kernels.h"
+
+// Sample type conversions.
+// Integer samples map to [-1, 1): a b bit sample v is v / 2^(b-1),
+// 8 bit samples are unsigned with 128 as zero.
+// Float -> integer scales by 2^(b-1), rounds to nearest (ties to even),
+// clips to the integer range and turns NaN into 0. Integer -> integer
+// shifts wider samples up, narrower ones are rounded half up and
+// clipped. Optional TPDF dither adds triangular noise of +-1 LSB of the
+// output before rounding.
+
+enum sample_type {
+    SAMPLE_NONE,
+    SAMPLE_U8,
+    SAMPLE_S16,
+    SAMPLE_S24,
+    SAMPLE_S32,
+    SAMPLE_F32,
+    SAMPLE_F64
+};
+
+// Type of LPCM (is_float false) or IEEE float samples of the given width
+sample_type sample_type_of(bool is_float, int bytes);
+int sample_bytes(sample_type type);
+bool is_float_sample(sample_type type);
+
+// Convert `samples` contiguous samples
+typedef void (*convert_fn)(const char *src, int64_t samples, char *dst,
+    bool dither);
+
+// Every pair of types has a kernel specialized at compile time, SSE2/AVX2
+// versions are picked at runtime when the CPU supports them.
+// Returns nullptr when the types match.
+convert_fn select_convert(sample_type from, sample_type to);
+
+// Convert interleaved frames and split them into channel buffers,
+// tile by tile so the converted data never leaves the cache
+void convert_deinterleave(convert_fn convert, deinterleave_fn deinterleave,
+    sample_type from, sample_type to, const char *src, int64_t frames,
+    int channels, char * const *dst, bool dither);
+
+// Convert a buffer in place, it must hold `samples` of the wider type
+void convert_in_place(convert_fn convert, sample_type from, sample_type to,
+    char *buf, int64_t samples, bool dither);
+
+#endif  // SRC_CONVERT_H_
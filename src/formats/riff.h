@@ -0,0 +1,59 @@
+// Copyright 2023 Andrei Drozdov
+
+#ifndef SRC_FORMATS_RIFF_H_
+#define SRC_FORMATS_RIFF_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+// Based on http://soundfile.sapp.org/doc/WaveFormat/
+
+// Chunk of a RIFF file, offset points to the chunk data (after id/size)
+typedef struct RIFF_CHUNK {
+    char id[4];               // chunk identifier ("fmt ", "data", ...)
+    int64_t offset;           // position of the chunk data in the file
+    int64_t size;             // size of the chunk data
+} riff_chunk;
+
+// fmt section, up to the WAVE_FORMAT_EXTENSIBLE fields (mmreg.h)
+typedef struct FMT_CHUNK {
+    int16_t AudioFormat;      // encoding format
+    int16_t NumOfChan;        // #of channels in the audio (mono/stereo)
+    int SamplesPerSec;        // sample rate Hz
+    int bytesPerSec;          // bytes per second
+    int16_t blockAlign;       // alignement
+    int16_t bitsPerSample;    // bit depth (8/16/etc bits per sample)
+    int16_t cbSize;           // size of the extension
+    int16_t validBitsPerSample;  // extensible: bits of precision
+    int channelMask;          // extensible: speaker positions
+    char SubFormat[16];       // extensible: format GUID
+} fmt_chunk;
+
+// ds64 section of RF64/BW64 files (EBU Tech 3306)
+#pragma pack(push, 1)
+typedef struct DS64_CHUNK {
+    int64_t riffSize;         // size of the RF64 section
+    int64_t dataSize;         // size of the data section
+    int64_t sampleCount;      // samples per channel
+    int32_t tableLength;      // entries of the chunk size table
+} ds64_chunk;
+#pragma pack(pop)
+
+// Largest size of a classic RIFF section, 32 bit sizes are 0xFFFFFFFF
+// in RF64 files
+const int64_t RIFF_MAX_SIZE = 0xFFFFFFFFLL;
+
+// Everything learned from one walk over the chunks of a wave file
+typedef struct WAVE_INFO {
+    std::vector<riff_chunk> chunks;  // all chunks in file order
+    bool is_rf64;             // RF64/BW64 file with a ds64 section
+    fmt_chunk fmt;            // fmt section, zero padded
+    std::vector<char> fmt_data;  // raw fmt section (codec extensions)
+    int16_t format;           // format code, SubFormat for extensible
+    int64_t data_offset;      // position of the samples in the file
+    int64_t data_size;        // size of the data section
+    int64_t fact_samples;     // fact section sample count (-1 if missing)
+} wave_info;
+
+#endif  // SRC_FORMATS_RIFF_H_
@@ -8,10 +8,10 @@
 // Based on http://soundfile.sapp.org/doc/WaveFormat/
 typedef struct WAV_HEADER {
     char RIFF[4];             // RIFF section identifier "RIFF"
-    int ChunkSize;            // size of section
+    uint32_t ChunkSize;       // size of section
     char WAVE[4];             // Format identifier "WAVE"
     char fmt[4];              // "fmt" section
-    int Subchunk1Size;        // size of fmt section
+    uint32_t Subchunk1Size;   // size of fmt section
     int16_t AudioFormat;    // encoding format
     int16_t NumOfChan;      // #of channels in the audio (mono/stereo)
     int SamplesPerSec;        // sample rate Hz
@@ -19,7 +19,7 @@ typedef struct WAV_HEADER {
     int16_t blockAlign;     // alignement
     int16_t bitsPerSample;  // bit depth (8/16/etc bits per sample)
     char Subchunk2ID[4];      // data section
-    int Subchunk2Size;        // Size of the data section
+    uint32_t Subchunk2Size;   // Size of the data section
 } wav_header;
 
 #endif  // SRC_FORMATS_WAV_H_
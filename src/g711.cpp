@@ -0,0 +1,186 @@
+// Copyright 2023 Andrei Drozdov
+
+#include "./g711.h"  // NOLINT [build/include]
+#include "./kernels.h"
+
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Table lookup fused with de-interleave, any channel count
+void g711_decode_scalar(const int16_t *table, const char *src,
+        int64_t frames, int channels, char * const *dst) {
+    const uint8_t *codes = reinterpret_cast<const uint8_t*>(src);
+    for (int ch = 0; ch < channels; ch++) {
+        int16_t *out = reinterpret_cast<int16_t*>(dst[ch]);
+        for (int64_t i = 0; i < frames; i++) {
+            out[i] = table[codes[i * channels + ch]];
+        }
+    }
+}
+
+void g711_encode_scalar(g711_law law, const int16_t *src, int64_t samples,
+        char *dst) {
+    for (int64_t i = 0; i < samples; i++) {
+        dst[i] = law == G711_ULAW ? ulaw_code(src[i]) : alaw_code(src[i]);
+    }
+}
+
+#ifdef __SSE2__
+
+// SSE2 encoders, 8 samples per step.
+// The segment is the number of segment ends below the magnitude,
+// the per-lane shift (value >> s) is done as mulhi(value, 1 << (16 - s)),
+// with the multiplier halved for every segment end passed.
+
+inline __m128i select(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+inline __m128i ulaw_encode8(__m128i pcm) {
+    __m128i neg = _mm_cmplt_epi16(pcm, _mm_setzero_si128());
+    __m128i value = _mm_srai_epi16(pcm, 2);
+    // abs(), clip and bias
+    value = _mm_sub_epi16(_mm_xor_si128(value, neg), neg);
+    value = _mm_min_epi16(value, _mm_set1_epi16(8159));
+    value = _mm_add_epi16(value, _mm_set1_epi16(0x21));
+
+    __m128i segment = _mm_setzero_si128();
+    __m128i mult = _mm_set1_epi16(static_cast<int16_t>(0x8000));
+    for (int end = 0x3F; end <= 0x1FFF; end = (end << 1) | 1) {
+        __m128i above = _mm_cmpgt_epi16(value, _mm_set1_epi16(end));
+        segment = _mm_sub_epi16(segment, above);
+        mult = select(above, _mm_srli_epi16(mult, 1), mult);
+    }
+    __m128i mantissa = _mm_and_si128(
+        _mm_mulhi_epu16(value, mult), _mm_set1_epi16(0x0F));
+    __m128i code = _mm_or_si128(_mm_slli_epi16(segment, 4), mantissa);
+    // segment 8 (clipped) saturates to the largest code
+    code = _mm_min_epi16(code, _mm_set1_epi16(0x7F));
+    __m128i mask = select(neg, _mm_set1_epi16(0x7F), _mm_set1_epi16(0xFF));
+    return _mm_xor_si128(code, mask);
+}
+
+inline __m128i alaw_encode8(__m128i pcm) {
+    __m128i neg = _mm_cmplt_epi16(pcm, _mm_setzero_si128());
+    // negative values: -value - 1 == ~value
+    __m128i value = _mm_xor_si128(_mm_srai_epi16(pcm, 3), neg);
+
+    __m128i segment = _mm_setzero_si128();
+    __m128i mult = _mm_set1_epi16(static_cast<int16_t>(0x8000));
+    for (int end = 0x1F; end <= 0xFFF; end = (end << 1) | 1) {
+        __m128i above = _mm_cmpgt_epi16(value, _mm_set1_epi16(end));
+        segment = _mm_sub_epi16(segment, above);
+        // segments 0 and 1 share the same shift
+        if (end > 0x1F) {
+            mult = select(above, _mm_srli_epi16(mult, 1), mult);
+        }
+    }
+    __m128i mantissa = _mm_and_si128(
+        _mm_mulhi_epu16(value, mult), _mm_set1_epi16(0x0F));
+    __m128i code = _mm_or_si128(_mm_slli_epi16(segment, 4), mantissa);
+    __m128i mask = select(neg, _mm_set1_epi16(0x55), _mm_set1_epi16(0xD5));
+    return _mm_xor_si128(code, mask);
+}
+
+void g711_encode_sse2(g711_law law, const int16_t *src, int64_t samples,
+        char *dst) {
+    int64_t i = 0;
+    for (; i + 16 <= samples; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i b = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(src + i + 8));
+        __m128i codes = law == G711_ULAW ?
+            _mm_packus_epi16(ulaw_encode8(a), ulaw_encode8(b)) :
+            _mm_packus_epi16(alaw_encode8(a), alaw_encode8(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), codes);
+    }
+    g711_encode_scalar(law, src + i, samples - i, dst + i);
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+// Look up 16 codes (zero extended bytes) and store 16 samples
+AVX2 inline void lookup16(const int32_t *table, __m128i codes, char *dst) {
+    __m256i lo = _mm256_i32gather_epi32(
+        table, _mm256_cvtepu8_epi32(codes), 4);
+    __m256i hi = _mm256_i32gather_epi32(
+        table, _mm256_cvtepu8_epi32(_mm_srli_si128(codes, 8)), 4);
+    // pack works per 128 bit lane, restore the order with a permute
+    __m256i res = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), res);
+}
+
+// AVX2 gather, mono: 16 frames per iteration
+AVX2 void g711_decode_mono_avx2(const int32_t *table, const int16_t *table16,
+        const char *src, int64_t frames, char * const *dst) {
+    int64_t i = 0;
+    for (; i + 16 <= frames; i += 16) {
+        __m128i codes = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(src + i));
+        lookup16(table, codes, dst[0] + i * 2);
+    }
+    char *tail[1] = {dst[0] + i * 2};
+    g711_decode_scalar(table16, src + i, frames - i, 1, tail);
+}
+
+// AVX2 gather, stereo: split the codes by channel first, 16 frames
+// per iteration
+AVX2 void g711_decode_stereo_avx2(const int32_t *table,
+        const int16_t *table16, const char *src, int64_t frames,
+        char * const *dst) {
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    int64_t i = 0;
+    for (; i + 16 <= frames; i += 16) {
+        __m128i a = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(src + i * 2));
+        __m128i b = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(src + i * 2 + 16));
+        __m128i l = _mm_packus_epi16(
+            _mm_and_si128(a, mask), _mm_and_si128(b, mask));
+        __m128i r = _mm_packus_epi16(
+            _mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+        lookup16(table, l, dst[0] + i * 2);
+        lookup16(table, r, dst[1] + i * 2);
+    }
+    char *tail[2] = {dst[0] + i * 2, dst[1] + i * 2};
+    g711_decode_scalar(table16, src + i * 2, frames - i, 2, tail);
+}
+
+#undef AVX2
+
+#endif  // __SSE2__
+
+}  // namespace
+
+void g711_decode(g711_law law, const char *src, int64_t frames,
+        int channels, char * const *dst) {
+    const int16_t *table16 = law == G711_ULAW ?
+        ULAW_DECODE.value : ALAW_DECODE.value;
+#ifdef __SSE2__
+    const int32_t *table = law == G711_ULAW ?
+        ULAW_DECODE32.value : ALAW_DECODE32.value;
+    if (cpu_has_avx2() && channels == 1) {
+        g711_decode_mono_avx2(table, table16, src, frames, dst);
+        return;
+    }
+    if (cpu_has_avx2() && channels == 2) {
+        g711_decode_stereo_avx2(table, table16, src, frames, dst);
+        return;
+    }
+#endif
+    g711_decode_scalar(table16, src, frames, channels, dst);
+}
+
+void g711_encode(g711_law law, const int16_t *src, int64_t samples,
+        char *dst) {
+#ifdef __SSE2__
+    g711_encode_sse2(law, src, samples, dst);
+#else
+    g711_encode_scalar(law, src, samples, dst);
+#endif
+}
@@ -0,0 +1,136 @@
+// Copyright 2023 Andrei Drozdov
+
+#ifndef SRC_G711_H_
+#define SRC_G711_H_
+
+#include <stdint.h>
+
+// ITU-T G.711 mu-law and a-law codecs.
+// Every 8 bit code maps to one 16 bit sample, so decoding is a lookup
+// in a 256 entry table generated at compile time.
+
+template <typename T>
+struct g711_table {
+    T value[256];
+};
+
+constexpr int16_t ulaw_sample(uint8_t code) {
+    // invert sample
+    int decoded = ~code & 0x00FF;
+    // get first bit (0x80 -> 0b10000000) + shift 7 = first bit
+    int sign = (code & 0x80) >> 7;
+    // get segment 2,3,4 bits, 0x0070 = 0b111000 + shift 4 = 111
+    int segment = (decoded & 0x0070) >> 4;
+    // get last 4 bits 0x000f = 0b1111
+    decoded = (decoded & 0x000f) << 1;
+    // The value 33 is the amount the end- points
+    // of the segments are offset from even powers of two.
+    // 0x0021 = 33
+    decoded += 0x0021;
+    // shift by segment and apply sign
+    decoded = decoded << segment;
+    if (sign) {
+        decoded -= 0x0021;
+    } else {
+        decoded = 0x0021 - decoded;
+    }
+    // normalize to 16 bit
+    return static_cast<int16_t>(decoded * 4);
+}
+
+constexpr int16_t alaw_sample(uint8_t code) {
+    // invert even bits of sample (0x0005 -> 0b101)
+    int tmp = code ^ 0x55;
+    // get first bit
+    int sign = (tmp & 0x80) >> 7;
+    // get the data
+    int decoded = ((tmp & 0x000f) << 1) | 0x0001;
+    // get the segment bits data
+    int segment = (tmp & 0x0070) >> 4;
+    // Update segment boundaries
+    if (segment > 0) {
+        decoded |= 0x0020;
+        decoded = decoded << (segment - 1);
+    }
+    // Remove segment data
+    decoded = decoded << 3;
+    // Sign bit set for positive samples
+    if (!sign) {
+        decoded = -decoded;
+    }
+    return static_cast<int16_t>(decoded);
+}
+
+template <typename T>
+constexpr g711_table<T> make_g711_table(int16_t (*sample)(uint8_t)) {
+    g711_table<T> table = {};
+    for (int i = 0; i < 256; i++) {
+        table.value[i] = sample(static_cast<uint8_t>(i));
+    }
+    return table;
+}
+
+// 16 bit tables for scalar code, 32 bit copies for vector gathers
+inline constexpr g711_table<int16_t> ULAW_DECODE =
+    make_g711_table<int16_t>(ulaw_sample);
+inline constexpr g711_table<int16_t> ALAW_DECODE =
+    make_g711_table<int16_t>(alaw_sample);
+inline constexpr g711_table<int32_t> ULAW_DECODE32 =
+    make_g711_table<int32_t>(ulaw_sample);
+inline constexpr g711_table<int32_t> ALAW_DECODE32 =
+    make_g711_table<int32_t>(alaw_sample);
+
+// Encoders follow the ITU-T G.711 reference (Sun g711.c):
+// 14 bit magnitude for mu-law, 13 bit for a-law
+constexpr uint8_t ulaw_code(int16_t pcm) {
+    const int seg_end[8] = {
+        0x3F, 0x7F, 0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF, 0x1FFF};
+    int value = pcm >> 2;
+    int mask = 0xFF;
+    if (value < 0) {
+        value = -value;
+        mask = 0x7F;
+    }
+    // clip the magnitude and add the bias (33)
+    value = value > 8159 ? 8159 : value;
+    value += 0x21;
+    int segment = 0;
+    while (segment < 8 && value > seg_end[segment]) {
+        segment++;
+    }
+    if (segment >= 8) {
+        return static_cast<uint8_t>(0x7F ^ mask);
+    }
+    int code = (segment << 4) | ((value >> (segment + 1)) & 0x0F);
+    return static_cast<uint8_t>(code ^ mask);
+}
+
+constexpr uint8_t alaw_code(int16_t pcm) {
+    const int seg_end[8] = {
+        0x1F, 0x3F, 0x7F, 0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF};
+    int value = pcm >> 3;
+    // even bits are inverted, sign bit set for positive samples
+    int mask = 0xD5;
+    if (value < 0) {
+        value = -value - 1;
+        mask = 0x55;
+    }
+    int segment = 0;
+    while (segment < 8 && value > seg_end[segment]) {
+        segment++;
+    }
+    int shift = segment < 2 ? 1 : segment;
+    int code = (segment << 4) | ((value >> shift) & 0x0F);
+    return static_cast<uint8_t>(code ^ mask);
+}
+
+enum g711_law { G711_ULAW, G711_ALAW };
+
+// Decode interleaved G.711 frames straight into 16 bit channel buffers
+void g711_decode(g711_law law, const char *src, int64_t frames,
+    int channels, char * const *dst);
+// Encode 16 bit samples into G.711 codes
+void g711_encode(g711_law law, const int16_t *src, int64_t samples,
+    char *dst);
+
+#endif  // SRC_G711_H_
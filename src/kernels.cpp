@@ -0,0 +1,409 @@
+// Copyright 2023 Andrei Drozdov
+
+#include "./kernels.h"  // NOLINT [build/include]
+
+#include <stdint.h>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Scalar kernels
+// C == 0 means the channel count is only known at runtime
+
+template <int B, int C>
+void deinterleave_scalar(const char *src, int64_t frames, int channels,
+        char * const *dst) {
+    const int nch = C ? C : channels;
+    for (int64_t i = 0; i < frames; i++) {
+        for (int ch = 0; ch < nch; ch++) {
+            memcpy(dst[ch] + i * B, src, B);
+            src += B;
+        }
+    }
+}
+
+template <int B, int C>
+void interleave_scalar(const char * const *src, int64_t frames,
+        int channels, char *dst) {
+    const int nch = C ? C : channels;
+    for (int64_t i = 0; i < frames; i++) {
+        for (int ch = 0; ch < nch; ch++) {
+            memcpy(dst, src[ch] + i * B, B);
+            dst += B;
+        }
+    }
+}
+
+template <int B>
+void deinterleave_mono(const char *src, int64_t frames, int channels,
+        char * const *dst) {
+    memcpy(dst[0], src, frames * B);
+}
+
+template <int B>
+void interleave_mono(const char * const *src, int64_t frames,
+        int channels, char *dst) {
+    memcpy(dst, src[0], frames * B);
+}
+
+// Finish the frames left after a vector loop with the scalar kernel
+template <int B, int C>
+void deinterleave_tail(const char *src, int64_t done, int64_t frames,
+        char * const *dst) {
+    char *tail[C];
+    for (int ch = 0; ch < C; ch++) {
+        tail[ch] = dst[ch] + done * B;
+    }
+    deinterleave_scalar<B, C>(src + done * B * C, frames - done, C, tail);
+}
+
+template <int B, int C>
+void interleave_tail(const char * const *src, int64_t done, int64_t frames,
+        char *dst) {
+    const char *tail[C];
+    for (int ch = 0; ch < C; ch++) {
+        tail[ch] = src[ch] + done * B;
+    }
+    interleave_scalar<B, C>(tail, frames - done, C, dst + done * B * C);
+}
+
+#ifdef __SSE2__
+
+inline __m128i load(const char *p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+inline void store(char *p, __m128i v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+
+// SSE2, stereo, 8 bit: 16 frames per iteration
+void deinterleave_u8x2_sse2(const char *src, int64_t frames, int channels,
+        char * const *dst) {
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    int64_t i = 0;
+    for (; i + 16 <= frames; i += 16) {
+        __m128i a = load(src + i * 2);
+        __m128i b = load(src + i * 2 + 16);
+        store(dst[0] + i, _mm_packus_epi16(
+            _mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+        store(dst[1] + i, _mm_packus_epi16(
+            _mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+    }
+    deinterleave_tail<1, 2>(src, i, frames, dst);
+}
+
+// SSE2, stereo, 16 bit: 8 frames per iteration
+void deinterleave_s16x2_sse2(const char *src, int64_t frames, int channels,
+        char * const *dst) {
+    int64_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m128i a = load(src + i * 4);
+        __m128i b = load(src + i * 4 + 16);
+        // left sample is the low half of each 32 bit frame
+        __m128i l = _mm_packs_epi32(
+            _mm_srai_epi32(_mm_slli_epi32(a, 16), 16),
+            _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+        __m128i r = _mm_packs_epi32(
+            _mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+        store(dst[0] + i * 2, l);
+        store(dst[1] + i * 2, r);
+    }
+    deinterleave_tail<2, 2>(src, i, frames, dst);
+}
+
+// SSE2, stereo, 32 bit: 4 frames per iteration
+void deinterleave_s32x2_sse2(const char *src, int64_t frames, int channels,
+        char * const *dst) {
+    int64_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128 a = _mm_castsi128_ps(load(src + i * 8));
+        __m128 b = _mm_castsi128_ps(load(src + i * 8 + 16));
+        store(dst[0] + i * 4, _mm_castps_si128(
+            _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))));
+        store(dst[1] + i * 4, _mm_castps_si128(
+            _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+    }
+    deinterleave_tail<4, 2>(src, i, frames, dst);
+}
+
+// SSE2, 4 channels, 16 bit: 8x4 transpose, 8 frames per iteration
+void deinterleave_s16x4_sse2(const char *src, int64_t frames, int channels,
+        char * const *dst) {
+    int64_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        const char *p = src + i * 8;
+        __m128i a0 = load(p), a1 = load(p + 16);
+        __m128i a2 = load(p + 32), a3 = load(p + 48);
+        __m128i t0 = _mm_unpacklo_epi16(a0, a1);
+        __m128i t1 = _mm_unpackhi_epi16(a0, a1);
+        __m128i t2 = _mm_unpacklo_epi16(a2, a3);
+        __m128i t3 = _mm_unpackhi_epi16(a2, a3);
+        __m128i u0 = _mm_unpacklo_epi16(t0, t1);
+        __m128i u1 = _mm_unpackhi_epi16(t0, t1);
+        __m128i u2 = _mm_unpacklo_epi16(t2, t3);
+        __m128i u3 = _mm_unpackhi_epi16(t2, t3);
+        store(dst[0] + i * 2, _mm_unpacklo_epi64(u0, u2));
+        store(dst[1] + i * 2, _mm_unpackhi_epi64(u0, u2));
+        store(dst[2] + i * 2, _mm_unpacklo_epi64(u1, u3));
+        store(dst[3] + i * 2, _mm_unpackhi_epi64(u1, u3));
+    }
+    deinterleave_tail<2, 4>(src, i, frames, dst);
+}
+
+void interleave_u8x2_sse2(const char * const *src, int64_t frames,
+        int channels, char *dst) {
+    int64_t i = 0;
+    for (; i + 16 <= frames; i += 16) {
+        __m128i l = load(src[0] + i);
+        __m128i r = load(src[1] + i);
+        store(dst + i * 2, _mm_unpacklo_epi8(l, r));
+        store(dst + i * 2 + 16, _mm_unpackhi_epi8(l, r));
+    }
+    interleave_tail<1, 2>(src, i, frames, dst);
+}
+
+void interleave_s16x2_sse2(const char * const *src, int64_t frames,
+        int channels, char *dst) {
+    int64_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m128i l = load(src[0] + i * 2);
+        __m128i r = load(src[1] + i * 2);
+        store(dst + i * 4, _mm_unpacklo_epi16(l, r));
+        store(dst + i * 4 + 16, _mm_unpackhi_epi16(l, r));
+    }
+    interleave_tail<2, 2>(src, i, frames, dst);
+}
+
+void interleave_s32x2_sse2(const char * const *src, int64_t frames,
+        int channels, char *dst) {
+    int64_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128i l = load(src[0] + i * 4);
+        __m128i r = load(src[1] + i * 4);
+        store(dst + i * 8, _mm_unpacklo_epi32(l, r));
+        store(dst + i * 8 + 16, _mm_unpackhi_epi32(l, r));
+    }
+    interleave_tail<4, 2>(src, i, frames, dst);
+}
+
+void interleave_s16x4_sse2(const char * const *src, int64_t frames,
+        int channels, char *dst) {
+    int64_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m128i c0 = load(src[0] + i * 2), c1 = load(src[1] + i * 2);
+        __m128i c2 = load(src[2] + i * 2), c3 = load(src[3] + i * 2);
+        __m128i x0 = _mm_unpacklo_epi16(c0, c1);
+        __m128i x1 = _mm_unpackhi_epi16(c0, c1);
+        __m128i y0 = _mm_unpacklo_epi16(c2, c3);
+        __m128i y1 = _mm_unpackhi_epi16(c2, c3);
+        char *p = dst + i * 8;
+        store(p, _mm_unpacklo_epi32(x0, y0));
+        store(p + 16, _mm_unpackhi_epi32(x0, y0));
+        store(p + 32, _mm_unpacklo_epi32(x1, y1));
+        store(p + 48, _mm_unpackhi_epi32(x1, y1));
+    }
+    interleave_tail<2, 4>(src, i, frames, dst);
+}
+
+// AVX2 versions, compiled for AVX2 regardless of the build flags
+// and only called when the CPU reports support for it
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 inline __m256i load256(const char *p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+AVX2 inline void store256(char *p, __m256i v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+}
+
+// AVX2, stereo, 8 bit: 32 frames per iteration
+AVX2 void deinterleave_u8x2_avx2(const char *src, int64_t frames,
+        int channels, char * const *dst) {
+    const __m256i mask = _mm256_set1_epi16(0x00FF);
+    int64_t i = 0;
+    for (; i + 32 <= frames; i += 32) {
+        __m256i a = load256(src + i * 2);
+        __m256i b = load256(src + i * 2 + 32);
+        // pack works per 128 bit lane, restore the order with a permute
+        __m256i l = _mm256_packus_epi16(
+            _mm256_and_si256(a, mask), _mm256_and_si256(b, mask));
+        __m256i r = _mm256_packus_epi16(
+            _mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+        store256(dst[0] + i, _mm256_permute4x64_epi64(l, 0xD8));
+        store256(dst[1] + i, _mm256_permute4x64_epi64(r, 0xD8));
+    }
+    deinterleave_tail<1, 2>(src, i, frames, dst);
+}
+
+// AVX2, stereo, 16 bit: 16 frames per iteration
+AVX2 void deinterleave_s16x2_avx2(const char *src, int64_t frames,
+        int channels, char * const *dst) {
+    int64_t i = 0;
+    for (; i + 16 <= frames; i += 16) {
+        __m256i a = load256(src + i * 4);
+        __m256i b = load256(src + i * 4 + 32);
+        __m256i l = _mm256_packs_epi32(
+            _mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16),
+            _mm256_srai_epi32(_mm256_slli_epi32(b, 16), 16));
+        __m256i r = _mm256_packs_epi32(
+            _mm256_srai_epi32(a, 16), _mm256_srai_epi32(b, 16));
+        store256(dst[0] + i * 2, _mm256_permute4x64_epi64(l, 0xD8));
+        store256(dst[1] + i * 2, _mm256_permute4x64_epi64(r, 0xD8));
+    }
+    deinterleave_tail<2, 2>(src, i, frames, dst);
+}
+
+// AVX2, stereo, 32 bit: 8 frames per iteration
+AVX2 void deinterleave_s32x2_avx2(const char *src, int64_t frames,
+        int channels, char * const *dst) {
+    const __m256i idx = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    int64_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m256i a = _mm256_permutevar8x32_epi32(load256(src + i * 8), idx);
+        __m256i b = _mm256_permutevar8x32_epi32(
+            load256(src + i * 8 + 32), idx);
+        store256(dst[0] + i * 4, _mm256_permute2x128_si256(a, b, 0x20));
+        store256(dst[1] + i * 4, _mm256_permute2x128_si256(a, b, 0x31));
+    }
+    deinterleave_tail<4, 2>(src, i, frames, dst);
+}
+
+AVX2 void interleave_u8x2_avx2(const char * const *src, int64_t frames,
+        int channels, char *dst) {
+    int64_t i = 0;
+    for (; i + 32 <= frames; i += 32) {
+        __m256i l = load256(src[0] + i);
+        __m256i r = load256(src[1] + i);
+        __m256i lo = _mm256_unpacklo_epi8(l, r);
+        __m256i hi = _mm256_unpackhi_epi8(l, r);
+        store256(dst + i * 2, _mm256_permute2x128_si256(lo, hi, 0x20));
+        store256(dst + i * 2 + 32, _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    interleave_tail<1, 2>(src, i, frames, dst);
+}
+
+AVX2 void interleave_s16x2_avx2(const char * const *src, int64_t frames,
+        int channels, char *dst) {
+    int64_t i = 0;
+    for (; i + 16 <= frames; i += 16) {
+        __m256i l = load256(src[0] + i * 2);
+        __m256i r = load256(src[1] + i * 2);
+        __m256i lo = _mm256_unpacklo_epi16(l, r);
+        __m256i hi = _mm256_unpackhi_epi16(l, r);
+        store256(dst + i * 4, _mm256_permute2x128_si256(lo, hi, 0x20));
+        store256(dst + i * 4 + 32, _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    interleave_tail<2, 2>(src, i, frames, dst);
+}
+
+AVX2 void interleave_s32x2_avx2(const char * const *src, int64_t frames,
+        int channels, char *dst) {
+    int64_t i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m256i l = load256(src[0] + i * 4);
+        __m256i r = load256(src[1] + i * 4);
+        __m256i lo = _mm256_unpacklo_epi32(l, r);
+        __m256i hi = _mm256_unpackhi_epi32(l, r);
+        store256(dst + i * 8, _mm256_permute2x128_si256(lo, hi, 0x20));
+        store256(dst + i * 8 + 32, _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    interleave_tail<4, 2>(src, i, frames, dst);
+}
+
+#undef AVX2
+
+#endif  // __SSE2__
+
+template <int B>
+deinterleave_fn scalar_deinterleave(int channels) {
+    switch (channels) {
+        case 1: return &deinterleave_mono<B>;
+        case 2: return &deinterleave_scalar<B, 2>;
+        case 4: return &deinterleave_scalar<B, 4>;
+        case 6: return &deinterleave_scalar<B, 6>;
+        case 8: return &deinterleave_scalar<B, 8>;
+        default: return &deinterleave_scalar<B, 0>;
+    }
+}
+
+template <int B>
+interleave_fn scalar_interleave(int channels) {
+    switch (channels) {
+        case 1: return &interleave_mono<B>;
+        case 2: return &interleave_scalar<B, 2>;
+        case 4: return &interleave_scalar<B, 4>;
+        case 6: return &interleave_scalar<B, 6>;
+        case 8: return &interleave_scalar<B, 8>;
+        default: return &interleave_scalar<B, 0>;
+    }
+}
+
+}  // namespace
+
+bool cpu_has_avx2() {
+#ifdef __SSE2__
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+deinterleave_fn select_deinterleave(int bytes_per_sample, int channels) {
+#ifdef __SSE2__
+    bool avx2 = cpu_has_avx2();
+    if (channels == 2 && bytes_per_sample == 1) {
+        return avx2 ? &deinterleave_u8x2_avx2 : &deinterleave_u8x2_sse2;
+    }
+    if (channels == 2 && bytes_per_sample == 2) {
+        return avx2 ? &deinterleave_s16x2_avx2 : &deinterleave_s16x2_sse2;
+    }
+    if (channels == 2 && bytes_per_sample == 4) {
+        return avx2 ? &deinterleave_s32x2_avx2 : &deinterleave_s32x2_sse2;
+    }
+    if (channels == 4 && bytes_per_sample == 2) {
+        return &deinterleave_s16x4_sse2;
+    }
+#endif
+    switch (bytes_per_sample) {
+        case 1: return scalar_deinterleave<1>(channels);
+        case 2: return scalar_deinterleave<2>(channels);
+        case 3: return scalar_deinterleave<3>(channels);
+        case 4: return scalar_deinterleave<4>(channels);
+        case 8: return scalar_deinterleave<8>(channels);
+    }
+    return nullptr;
+}
+
+interleave_fn select_interleave(int bytes_per_sample, int channels) {
+#ifdef __SSE2__
+    bool avx2 = cpu_has_avx2();
+    if (channels == 2 && bytes_per_sample == 1) {
+        return avx2 ? &interleave_u8x2_avx2 : &interleave_u8x2_sse2;
+    }
+    if (channels == 2 && bytes_per_sample == 2) {
+        return avx2 ? &interleave_s16x2_avx2 : &interleave_s16x2_sse2;
+    }
+    if (channels == 2 && bytes_per_sample == 4) {
+        return avx2 ? &interleave_s32x2_avx2 : &interleave_s32x2_sse2;
+    }
+    if (channels == 4 && bytes_per_sample == 2) {
+        return &interleave_s16x4_sse2;
+    }
+#endif
+    switch (bytes_per_sample) {
+        case 1: return scalar_interleave<1>(channels);
+        case 2: return scalar_interleave<2>(channels);
+        case 3: return scalar_interleave<3>(channels);
+        case 4: return scalar_interleave<4>(channels);
+        case 8: return scalar_interleave<8>(channels);
+    }
+    return nullptr;
+}
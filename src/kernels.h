@@ -0,0 +1,26 @@
+// Copyright 2023 Andrei Drozdov
+
+#ifndef SRC_KERNELS_H_
+#define SRC_KERNELS_H_
+
+#include <stdint.h>
+
+// Split interleaved frames into per-channel buffers
+// src: l0 r0 l1 r1 ... -> dst[0]: l0 l1 ..., dst[1]: r0 r1 ...
+typedef void (*deinterleave_fn)(const char *src, int64_t frames,
+    int channels, char * const *dst);
+// Reverse direction: per-channel buffers -> interleaved frames
+typedef void (*interleave_fn)(const char * const *src, int64_t frames,
+    int channels, char *dst);
+
+// Kernels are specialized at compile time by sample width
+// (1, 2, 3, 4 or 8 bytes) and channel count (1, 2, 4, 6, 8 or any).
+// SSE2/AVX2 versions are picked at runtime when the CPU supports them.
+// Returns nullptr for unsupported sample widths.
+deinterleave_fn select_deinterleave(int bytes_per_sample, int channels);
+interleave_fn select_interleave(int bytes_per_sample, int channels);
+
+// True when AVX2 code paths can run on this CPU
+bool cpu_has_avx2();
+
+#endif  // SRC_KERNELS_H_
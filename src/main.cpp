@@ -1,12 +1,18 @@
 // Copyright 2023 Andrei Drozdov
 
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <chrono>  // NOLINT [build/c++11]`
+#include <sstream>
 #include <vector>
 
 #include <argparse/argparse.hpp>
 
 #include "./slice.h"
+#include "./pool.h"
+#include "./segments.h"
+#include "./stats.h"
 
 
 void info(std::string filename, bool is_verbose) {
@@ -25,11 +31,115 @@ void info(std::string filename, bool is_verbose) {
     std::cout << "Channels: " << as.Channels() <<std::endl;
     std::cout << "Num samples: " << as.NumSamples() <<std::endl;
     std::cout << "Duration: " << as.Duration() << " sec" << std::endl;
+    if (is_verbose) {
+        for (const riff_chunk& chunk : as.Wave().chunks) {
+            std::cout << "Chunk '" << std::string(chunk.id, 4) << "': ";
+            std::cout << chunk.size << " bytes at " << chunk.offset;
+            std::cout << std::endl;
+        }
+    }
+}
+
+std::string json_string(const std::string& text) {
+    std::string res = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            res += '\\';
+        }
+        res += c;
+    }
+    return res + "\"";
+}
+
+// Level in dBFS, silence has no finite level
+std::string decibels(double level, bool json) {
+    if (level <= 0) {
+        return json ? "null" : "-inf";
+    }
+    std::ostringstream res;
+    res << 20 * std::log10(level);
+    return res.str();
+}
+
+void analyze(std::vector<std::string> filenames, bool is_verbose,
+        int block_size, int jobs, bool json, double window,
+        double silence_db) {
+    for (const std::string& filename : filenames) {
+        auto as = AudioSlicer(filename, is_verbose);
+        as.set_block_size(block_size);
+        as.set_jobs(jobs);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<channel_stats> stats = as.analyze(window, silence_db);
+        auto cnt = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+
+        if (json) {
+            // One object per line (JSON Lines)
+            std::cout << "{\"file\": " << json_string(filename);
+            std::cout << ", \"duration\": " << as.Duration();
+            std::cout << ", \"channels\": [";
+            for (int i=0; i < stats.size(); i++) {
+                const channel_stats& st = stats[i];
+                std::cout << (i > 0 ? ", " : "") << "{\"channel\": " << i;
+                std::cout << ", \"peak\": " << st.peak;
+                std::cout << ", \"peak_db\": " << decibels(st.peak, true);
+                std::cout << ", \"rms\": " << st.rms;
+                std::cout << ", \"rms_db\": " << decibels(st.rms, true);
+                std::cout << ", \"dc_offset\": " << st.dc_offset;
+                std::cout << ", \"clipped\": " << st.clipped;
+                std::cout << ", \"zero_crossing_rate\": ";
+                std::cout << st.zero_crossing_rate;
+                std::cout << ", \"silence_ratio\": " << st.silence_ratio;
+                std::cout << "}";
+            }
+            std::cout << "]}" << std::endl;
+            continue;
+        }
+
+        std::cout << "Filename: " << filename << std::endl;
+        std::cout << "Duration: " << as.Duration() << " sec" << std::endl;
+        for (int i=0; i < stats.size(); i++) {
+            const channel_stats& st = stats[i];
+            std::cout << "Channel " << i << ":" << std::endl;
+            std::cout << "  Peak: " << decibels(st.peak, false);
+            std::cout << " dBFS (" << st.peak << ")" << std::endl;
+            std::cout << "  RMS: " << decibels(st.rms, false);
+            std::cout << " dBFS" << std::endl;
+            std::cout << "  DC offset: " << st.dc_offset << std::endl;
+            std::cout << "  Clipped samples: " << st.clipped << std::endl;
+            std::cout << "  Zero-crossing rate: " << st.zero_crossing_rate;
+            std::cout << std::endl;
+            std::cout << "  Silence: " << st.silence_ratio * 100 << " %";
+            std::cout << std::endl;
+        }
+        std::cout << "Analysis time = " << cnt.count() << " ms\n";
+    }
+}
+
+int16_t output_format(std::string name) {
+    // 0: keep the default of the source
+    if (name == "auto") return 0;
+    if (name == "lpcm") return CT_LPCM;
+    if (name == "float") return CT_IEEEFP;
+    if (name == "mulaw") return CT_MS_MLAW;
+    if (name == "alaw") return CT_MS_ALAW;
+    return -1;
 }
 
-void split(std::string filename, std::string prefix, bool is_verbose) {
+void split(std::string filename, std::string prefix, bool is_verbose,
+        int block_size, int jobs, int16_t format, int bits, bool dither,
+        int rate, std::string mix) {
     std::cout << "Loading..." << std::endl;
     auto as = AudioSlicer(filename, is_verbose);
+    as.set_block_size(block_size);
+    as.set_jobs(jobs);
+    if (format != 0) {
+        as.set_output_format(format);
+    }
+    as.set_output_bits(bits);
+    as.set_dither(dither);
+    as.set_output_rate(rate);
+    as.set_mix(mix);
     auto start = std::chrono::steady_clock::now();
     as.split_channels(prefix);
     auto cnt = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -37,8 +147,25 @@ void split(std::string filename, std::string prefix, bool is_verbose) {
     std::cout << "Split time = " << cnt.count() << " ms\n";
 }
 
-void slice(std::string filename, std::vector<chunk> slices, bool is_verbose) {
+void slice(std::string filename, std::vector<chunk> slices, bool is_verbose,
+        int block_size, int jobs, int16_t format, int bits, bool dither,
+        int rate, std::string mix, bool in_samples) {
     auto as = AudioSlicer(filename, is_verbose);
+    if (in_samples) {
+        for (chunk& c : slices) {
+            c.sec_start /= as.SampleRate();
+            c.sec_end /= as.SampleRate();
+        }
+    }
+    as.set_block_size(block_size);
+    as.set_jobs(jobs);
+    if (format != 0) {
+        as.set_output_format(format);
+    }
+    as.set_output_bits(bits);
+    as.set_dither(dither);
+    as.set_output_rate(rate);
+    as.set_mix(mix);
     auto start = std::chrono::steady_clock::now();
     as.slice(slices);
     auto cnt = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -46,12 +173,174 @@ void slice(std::string filename, std::vector<chunk> slices, bool is_verbose) {
     std::cout << "Extraction time = " << cnt.count() << " ms\n";
 }
 
+void slice_segments(std::string filename, std::vector<chunk> segments,
+        bool is_verbose, int block_size, int jobs, int16_t format, int bits,
+        bool dither, int rate, std::string mix, bool in_samples) {
+    auto as = AudioSlicer(filename, is_verbose);
+    if (in_samples) {
+        for (chunk& c : segments) {
+            c.sec_start /= as.SampleRate();
+            c.sec_end /= as.SampleRate();
+        }
+    }
+    as.set_block_size(block_size);
+    as.set_jobs(jobs);
+    if (format != 0) {
+        as.set_output_format(format);
+    }
+    as.set_output_bits(bits);
+    as.set_dither(dither);
+    as.set_output_rate(rate);
+    as.set_mix(mix);
+    auto start = std::chrono::steady_clock::now();
+    as.slice_segments(segments);
+    auto cnt = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    std::cout << "Extracted " << segments.size() << " segments, time = ";
+    std::cout << cnt.count() << " ms\n";
+}
+
+void vad_split(std::string filename, std::string prefix, bool is_verbose,
+        int block_size, int jobs, int16_t format, int bits, bool dither,
+        int rate, std::string mix, const vad_params& params,
+        std::string list, bool list_only) {
+    auto as = AudioSlicer(filename, is_verbose);
+    as.set_block_size(block_size);
+    as.set_jobs(jobs);
+    if (format != 0) {
+        as.set_output_format(format);
+    }
+    as.set_output_bits(bits);
+    as.set_dither(dither);
+    as.set_output_rate(rate);
+    as.set_mix(mix);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<chunk> segments = as.detect_speech(params, prefix);
+    if (list_only && list.empty()) {
+        list = "-";
+    }
+    auto cnt = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    if (!list.empty()) {
+        // RTTM recording id: file name without directory and extension
+        std::string recording = filename.substr(
+            filename.find_last_of('/') + 1);
+        recording = recording.substr(0, recording.find_last_of('.'));
+        write_segments(list, segments, recording);
+    }
+    if (list != "-") {
+        std::cout << "Found " << segments.size() << " speech segments, ";
+        std::cout << "time = " << cnt.count() << " ms\n";
+    }
+    if (list_only) {
+        return;
+    }
+    start = std::chrono::steady_clock::now();
+    as.slice(segments);
+    cnt = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    if (list != "-") {
+        std::cout << "Extraction time = " << cnt.count() << " ms\n";
+    }
+}
+
+void features(std::string filename, std::string output, bool is_verbose,
+        int block_size, int jobs, const feature_params& params) {
+    auto as = AudioSlicer(filename, is_verbose);
+    as.set_block_size(block_size);
+    as.set_jobs(jobs);
+    auto start = std::chrono::steady_clock::now();
+    int64_t frames = as.features(params, output);
+    auto cnt = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    std::cout << "Extracted " << frames << " frames into '" << output;
+    std::cout << "', time = " << cnt.count() << " ms\n";
+}
+
+void peaks(std::string filename, std::string index, bool is_verbose,
+        int block_size, int jobs, bool rebuild, bool build_only,
+        double start, double end, int pixels, int channel) {
+    auto as = AudioSlicer(filename, is_verbose);
+    as.set_block_size(block_size);
+    as.set_jobs(jobs);
+    if (index.empty()) {
+        index = filename + ".peaks";
+    }
+    auto begin = std::chrono::steady_clock::now();
+    PeakIndex peak_index;
+    bool built = as.peak_index(index, rebuild, &peak_index);
+    auto cnt = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - begin);
+    if (build_only) {
+        std::cout << "Peaks index '" << index << "' ";
+        std::cout << (built ? "built" : "is up to date");
+        std::cout << ", time = " << cnt.count() << " ms\n";
+        return;
+    }
+    if (channel >= peak_index.Channels()) {
+        std::cout << "No channel " << channel << " in " << filename;
+        std::cout << std::endl;
+        exit(1);
+    }
+
+    // One JSON object with min/max/RMS arrays of every channel
+    int64_t first = std::max(llround(start * as.SampleRate()), 0LL);
+    int64_t last = end < 0 ? as.NumSamples() :
+        std::min(int64_t(llround(end * as.SampleRate())), as.NumSamples());
+    int level = peak_index.level_for(
+        static_cast<double>(last - first) / pixels);
+    std::cout << "{\"file\": " << json_string(filename);
+    std::cout << ", \"sample_rate\": " << as.SampleRate();
+    std::cout << ", \"first\": " << first << ", \"last\": " << last;
+    std::cout << ", \"pixels\": " << pixels;
+    std::cout << ", \"samples_per_bin\": " << PEAK_BIN_FRAMES[level];
+    std::cout << ", \"channels\": [";
+    int lo = channel < 0 ? 0 : channel;
+    int hi = channel < 0 ? peak_index.Channels() : channel + 1;
+    for (int ch=lo; ch < hi; ch++) {
+        std::vector<peak_pixel> res = peak_index.query(ch, first, last,
+            pixels);
+        std::ostringstream mins, maxs, rms;
+        for (int p=0; p < res.size(); p++) {
+            const char *sep = p > 0 ? ", " : "";
+            mins << sep << res[p].min;
+            maxs << sep << res[p].max;
+            rms << sep << res[p].rms;
+        }
+        std::cout << (ch > lo ? ", " : "") << "{\"channel\": " << ch;
+        std::cout << ", \"min\": [" << mins.str() << "]";
+        std::cout << ", \"max\": [" << maxs.str() << "]";
+        std::cout << ", \"rms\": [" << rms.str() << "]}";
+    }
+    std::cout << "]}" << std::endl;
+}
+
+void print_stats() {
+    // On every exit path, after the command output
+    std::cout.flush();
+    stats_json(std::cerr);
+    std::cerr << std::endl;
+}
+
 int main(int argc, char* argv[]) {
     argparse::ArgumentParser program("asl - Audio SLicer");
     program.add_argument("--verbose")
         .help("Enable verbose mode")
         .default_value(false)
         .implicit_value(true);
+    program.add_argument("--block-size")
+        .help("Number of frames decoded and written at once")
+        .default_value(static_cast<int>(DEFAULT_BLOCK_FRAMES))
+        .scan<'i', int>();
+    program.add_argument("--jobs")
+        .help("Number of worker threads (default: all hardware threads)")
+        .default_value(WorkerPool::hardware_jobs())
+        .scan<'i', int>();
+    program.add_argument("--stats")
+        .help("Print stage timings, peak memory and allocations as JSON "
+              "to stderr")
+        .default_value(false)
+        .implicit_value(true);
     argparse::ArgumentParser cmd_info("info");
     cmd_info.add_description("Get audio file information");
     cmd_info.add_argument("-f", "--file")
@@ -66,29 +355,255 @@ int main(int argc, char* argv[]) {
     cmd_split.add_argument("-p", "--prefix")
         .required()
         .help("Output filename prefix");
+    cmd_split.add_argument("--output-format")
+        .default_value(std::string("auto"))
+        .help("Output encoding: lpcm, float, mulaw or alaw "
+            "(default: float for float sources, lpcm otherwise)");
+    cmd_split.add_argument("--bits")
+        .help("Output sample depth: 8, 16, 24, 32 (64 for float), "
+            "default: same as the source")
+        .default_value(0)
+        .scan<'i', int>();
+    cmd_split.add_argument("--dither")
+        .help("TPDF dither when samples are rounded to a smaller depth")
+        .default_value(false)
+        .implicit_value(true);
+    cmd_split.add_argument("--rate")
+        .help("Output sample rate in Hz, default: same as the source")
+        .default_value(0)
+        .scan<'i', int>();
+    cmd_split.add_argument("--mix")
+        .default_value(std::string(""))
+        .help("Output channels from the source channels: \"0+1\" "
+            "averages, \"0,2\" keeps 0 and 2, \"0.7*0+0.3*1\" weights, "
+            "\"mono\"");
 
     argparse::ArgumentParser cmd_slice("slice");
     cmd_slice.add_argument("-f", "--file")
         .required()
         .help("Input audio file");
     cmd_slice.add_argument("-s", "--start")
-        .help("Beginnig of the slice in seconds")
-        .required()
-        .scan<'i', int>()
+        .help("Beginnig of the slice in seconds (1.25 = 1 s 250 ms)")
+        .scan<'g', double>()
         .nargs(argparse::nargs_pattern::at_least_one);
     cmd_slice.add_argument("-e", "--end")
-        .help("End of the slice in seconds")
-        .required()
-        .scan<'i', int>()
+        .help("End of the slice in seconds (1.25 = 1 s 250 ms)")
+        .scan<'g', double>()
         .nargs(argparse::nargs_pattern::at_least_one);
+    cmd_slice.add_argument("--samples")
+        .help("Start and end are sample positions instead of seconds")
+        .default_value(false)
+        .implicit_value(true);
     cmd_slice.add_argument("-o", "--output")
-        .required()
         .nargs(argparse::nargs_pattern::at_least_one)
         .help("Output filename");
+    cmd_slice.add_argument("--segments")
+        .help("Segment list instead of -s/-e/-o (.csv, .rttm or .jsonl)");
+    cmd_slice.add_argument("--prefix")
+        .default_value(std::string("segment_"))
+        .help("Output prefix for segments without a file name");
+    cmd_slice.add_argument("--output-format")
+        .default_value(std::string("auto"))
+        .help("Output encoding: lpcm, float, mulaw or alaw "
+            "(default: float for float sources, lpcm otherwise)");
+    cmd_slice.add_argument("--bits")
+        .help("Output sample depth: 8, 16, 24, 32 (64 for float), "
+            "default: same as the source")
+        .default_value(0)
+        .scan<'i', int>();
+    cmd_slice.add_argument("--dither")
+        .help("TPDF dither when samples are rounded to a smaller depth")
+        .default_value(false)
+        .implicit_value(true);
+    cmd_slice.add_argument("--rate")
+        .help("Output sample rate in Hz, default: same as the source")
+        .default_value(0)
+        .scan<'i', int>();
+    cmd_slice.add_argument("--mix")
+        .default_value(std::string(""))
+        .help("Output channels from the source channels: \"0+1\" "
+            "averages, \"0,2\" keeps 0 and 2, \"0.7*0+0.3*1\" weights, "
+            "\"mono\"");
+
+    argparse::ArgumentParser cmd_analyze("analyze");
+    cmd_analyze.add_description(
+        "Per channel peak, RMS, DC offset, clipping, zero crossings "
+        "and silence");
+    cmd_analyze.add_argument("-f", "--file")
+        .required()
+        .nargs(argparse::nargs_pattern::at_least_one)
+        .help("Input audio files");
+    cmd_analyze.add_argument("--json")
+        .help("One JSON object per file")
+        .default_value(false)
+        .implicit_value(true);
+    cmd_analyze.add_argument("--window")
+        .help("Silence detection window in seconds")
+        .default_value(0.02)
+        .scan<'g', double>();
+    cmd_analyze.add_argument("--silence-db")
+        .help("Windows with a lower RMS level (dBFS) are silent")
+        .default_value(-60.0)
+        .scan<'g', double>();
+
+    argparse::ArgumentParser cmd_vad("vad-split");
+    cmd_vad.add_description(
+        "Find speech by frame energy and zero crossings, write the "
+        "segments and/or their list");
+    cmd_vad.add_argument("-f", "--file")
+        .required()
+        .help("Input audio file");
+    cmd_vad.add_argument("-p", "--prefix")
+        .default_value(std::string("speech_"))
+        .help("Output filename prefix");
+    cmd_vad.add_argument("--list")
+        .default_value(std::string(""))
+        .help("Write the segment list (.csv, .rttm or .jsonl, - prints CSV)");
+    cmd_vad.add_argument("--list-only")
+        .help("Only write the segment list, no audio")
+        .default_value(false)
+        .implicit_value(true);
+    cmd_vad.add_argument("--frame")
+        .help("Analysis frame in seconds")
+        .default_value(DEFAULT_VAD_PARAMS.frame_sec)
+        .scan<'g', double>();
+    cmd_vad.add_argument("--threshold-db")
+        .help("Lowest speech level (dBFS)")
+        .default_value(DEFAULT_VAD_PARAMS.threshold_db)
+        .scan<'g', double>();
+    cmd_vad.add_argument("--margin-db")
+        .help("Speech level above the noise floor (dB)")
+        .default_value(DEFAULT_VAD_PARAMS.margin_db)
+        .scan<'g', double>();
+    cmd_vad.add_argument("--zcr")
+        .help("Zero crossings per sample of unvoiced speech (0: off)")
+        .default_value(DEFAULT_VAD_PARAMS.zcr)
+        .scan<'g', double>();
+    cmd_vad.add_argument("--hangover")
+        .help("Pauses shorter than this (seconds) don't end speech")
+        .default_value(DEFAULT_VAD_PARAMS.hangover_sec)
+        .scan<'g', double>();
+    cmd_vad.add_argument("--min-speech")
+        .help("Shorter bursts (seconds) are dropped")
+        .default_value(DEFAULT_VAD_PARAMS.min_speech_sec)
+        .scan<'g', double>();
+    cmd_vad.add_argument("--pad")
+        .help("Seconds added on both sides of every segment")
+        .default_value(DEFAULT_VAD_PARAMS.pad_sec)
+        .scan<'g', double>();
+    cmd_vad.add_argument("--channel")
+        .help("Channel to listen to (default: the loudest)")
+        .default_value(DEFAULT_VAD_PARAMS.channel)
+        .scan<'i', int>();
+    cmd_vad.add_argument("--output-format")
+        .default_value(std::string("auto"))
+        .help("Output encoding: lpcm, float, mulaw or alaw "
+            "(default: float for float sources, lpcm otherwise)");
+    cmd_vad.add_argument("--bits")
+        .help("Output sample depth: 8, 16, 24, 32 (64 for float), "
+            "default: same as the source")
+        .default_value(0)
+        .scan<'i', int>();
+    cmd_vad.add_argument("--dither")
+        .help("TPDF dither when samples are rounded to a smaller depth")
+        .default_value(false)
+        .implicit_value(true);
+    cmd_vad.add_argument("--rate")
+        .help("Output sample rate in Hz, default: same as the source")
+        .default_value(0)
+        .scan<'i', int>();
+    cmd_vad.add_argument("--mix")
+        .default_value(std::string(""))
+        .help("Output channels from the source channels: \"0+1\" "
+            "averages, \"0,2\" keeps 0 and 2, \"0.7*0+0.3*1\" weights, "
+            "\"mono\"");
+
+    argparse::ArgumentParser cmd_features("features");
+    cmd_features.add_description(
+        "Log-mel filterbank or power spectrogram frames as a .npy array");
+    cmd_features.add_argument("-f", "--file")
+        .required()
+        .help("Input audio file");
+    cmd_features.add_argument("-o", "--output")
+        .required()
+        .help("Output .npy file: float32 (frames, bins), "
+            "(channels, frames, bins) for all channels of multichannel "
+            "inputs");
+    cmd_features.add_argument("--frame")
+        .help("Frame length in seconds")
+        .default_value(DEFAULT_FEATURE_PARAMS.frame_sec)
+        .scan<'g', double>();
+    cmd_features.add_argument("--hop")
+        .help("Frame step in seconds")
+        .default_value(DEFAULT_FEATURE_PARAMS.hop_sec)
+        .scan<'g', double>();
+    cmd_features.add_argument("--fft")
+        .help("FFT points, even with factors 2, 3 and 5 "
+            "(default: next power of two of the frame)")
+        .default_value(DEFAULT_FEATURE_PARAMS.fft_size)
+        .scan<'i', int>();
+    cmd_features.add_argument("--mels")
+        .help("Mel bands, 0: power spectrogram")
+        .default_value(DEFAULT_FEATURE_PARAMS.mels)
+        .scan<'i', int>();
+    cmd_features.add_argument("--fmin")
+        .help("Lowest mel filter frequency in Hz")
+        .default_value(DEFAULT_FEATURE_PARAMS.fmin)
+        .scan<'g', double>();
+    cmd_features.add_argument("--fmax")
+        .help("Highest mel filter frequency in Hz (default: Nyquist)")
+        .default_value(DEFAULT_FEATURE_PARAMS.fmax)
+        .scan<'g', double>();
+    cmd_features.add_argument("--linear")
+        .help("Linear values instead of natural logs")
+        .default_value(false)
+        .implicit_value(true);
+    cmd_features.add_argument("--channel")
+        .help("Channel of the features (default: all channels)")
+        .default_value(DEFAULT_FEATURE_PARAMS.channel)
+        .scan<'i', int>();
+
+    argparse::ArgumentParser cmd_peaks("peaks");
+    cmd_peaks.add_description(
+        "Waveform min/max/RMS per pixel from a cached peaks pyramid (JSON)");
+    cmd_peaks.add_argument("-f", "--file")
+        .required()
+        .help("Input audio file");
+    cmd_peaks.add_argument("--index")
+        .default_value(std::string(""))
+        .help("Peaks sidecar file (default: <file>.peaks)");
+    cmd_peaks.add_argument("--rebuild")
+        .help("Rebuild the sidecar even when it is up to date")
+        .default_value(false)
+        .implicit_value(true);
+    cmd_peaks.add_argument("--build-only")
+        .help("Only build or check the sidecar")
+        .default_value(false)
+        .implicit_value(true);
+    cmd_peaks.add_argument("-s", "--start")
+        .help("Beginning of the range in seconds")
+        .default_value(0.0)
+        .scan<'g', double>();
+    cmd_peaks.add_argument("-e", "--end")
+        .help("End of the range in seconds (default: end of the file)")
+        .default_value(-1.0)
+        .scan<'g', double>();
+    cmd_peaks.add_argument("--pixels")
+        .help("Number of pixels (min/max/RMS values) of the range")
+        .default_value(1000)
+        .scan<'i', int>();
+    cmd_peaks.add_argument("--channel")
+        .help("Channel (default: all channels)")
+        .default_value(-1)
+        .scan<'i', int>();
 
     program.add_subparser(cmd_info);
     program.add_subparser(cmd_split);
     program.add_subparser(cmd_slice);
+    program.add_subparser(cmd_analyze);
+    program.add_subparser(cmd_vad);
+    program.add_subparser(cmd_features);
+    program.add_subparser(cmd_peaks);
 
     try {
         program.parse_args(argc, argv);
@@ -100,40 +615,162 @@ int main(int argc, char* argv[]) {
     }
 
     bool is_verbose = program.get<bool>("--verbose");
+    int block_size = program.get<int>("--block-size");
+    if (block_size <= 0) {
+        std::cout << "Block size should be positive" << std::endl;
+        return 1;
+    }
+    int jobs = program.get<int>("--jobs");
+    if (jobs <= 0) {
+        std::cout << "Number of jobs should be positive" << std::endl;
+        return 1;
+    }
+    if (program.get<bool>("--stats")) {
+        std::atexit(print_stats);
+    }
+
+    std::string format_name = "auto";
+    bool dither = false;
+    int bits = 0;
+    int rate = 0;
+    std::string mix;
+    for (auto cmd : {"split", "slice", "vad-split"}) {
+        if (program.is_subcommand_used(cmd)) {
+            mix = program.at<argparse::ArgumentParser>(
+                cmd).get<std::string>("--mix");
+            rate = program.at<argparse::ArgumentParser>(
+                cmd).get<int>("--rate");
+            bits = program.at<argparse::ArgumentParser>(
+                cmd).get<int>("--bits");
+            format_name = program.at<argparse::ArgumentParser>(
+                cmd).get<std::string>("--output-format");
+            dither = program.at<argparse::ArgumentParser>(
+                cmd).get<bool>("--dither");
+        }
+    }
+    int16_t format = output_format(format_name);
+    if (format < 0) {
+        std::cout << "Unknown output format: " << format_name << std::endl;
+        return 1;
+    }
+    if (bits != 0 && bits != 8 && bits != 16 && bits != 24 && bits != 32 &&
+            bits != 64) {
+        std::cout << "Output depth should be 8, 16, 24, 32 or 64 bits";
+        std::cout << std::endl;
+        return 1;
+    }
+    if (rate < 0) {
+        std::cout << "Output rate should be positive" << std::endl;
+        return 1;
+    }
 
     if (program.is_subcommand_used("info")) {
             auto input = program.at<argparse::ArgumentParser>(
             "info").get<std::string>("--file");
            info(input, is_verbose);
 
+    } else if (program.is_subcommand_used("analyze")) {
+        auto& cmd = program.at<argparse::ArgumentParser>("analyze");
+        double window = cmd.get<double>("--window");
+        if (window <= 0) {
+            std::cout << "Window should be positive" << std::endl;
+            return 1;
+        }
+        analyze(cmd.get<std::vector<std::string>>("--file"), is_verbose,
+            block_size, jobs, cmd.get<bool>("--json"), window,
+            cmd.get<double>("--silence-db"));
+    } else if (program.is_subcommand_used("peaks")) {
+        auto& cmd = program.at<argparse::ArgumentParser>("peaks");
+        int pixels = cmd.get<int>("--pixels");
+        if (pixels <= 0) {
+            std::cout << "Number of pixels should be positive" << std::endl;
+            return 1;
+        }
+        peaks(cmd.get<std::string>("--file"),
+            cmd.get<std::string>("--index"), is_verbose, block_size, jobs,
+            cmd.get<bool>("--rebuild"), cmd.get<bool>("--build-only"),
+            cmd.get<double>("--start"), cmd.get<double>("--end"), pixels,
+            cmd.get<int>("--channel"));
+    } else if (program.is_subcommand_used("features")) {
+        auto& cmd = program.at<argparse::ArgumentParser>("features");
+        feature_params params = DEFAULT_FEATURE_PARAMS;
+        params.frame_sec = cmd.get<double>("--frame");
+        params.hop_sec = cmd.get<double>("--hop");
+        params.fft_size = cmd.get<int>("--fft");
+        params.mels = cmd.get<int>("--mels");
+        params.fmin = cmd.get<double>("--fmin");
+        params.fmax = cmd.get<double>("--fmax");
+        params.log = !cmd.get<bool>("--linear");
+        params.channel = cmd.get<int>("--channel");
+        features(cmd.get<std::string>("--file"),
+            cmd.get<std::string>("--output"), is_verbose, block_size, jobs,
+            params);
+    } else if (program.is_subcommand_used("vad-split")) {
+        auto& cmd = program.at<argparse::ArgumentParser>("vad-split");
+        vad_params params = DEFAULT_VAD_PARAMS;
+        params.frame_sec = cmd.get<double>("--frame");
+        params.threshold_db = cmd.get<double>("--threshold-db");
+        params.margin_db = cmd.get<double>("--margin-db");
+        params.zcr = cmd.get<double>("--zcr");
+        params.hangover_sec = cmd.get<double>("--hangover");
+        params.min_speech_sec = cmd.get<double>("--min-speech");
+        params.pad_sec = cmd.get<double>("--pad");
+        params.channel = cmd.get<int>("--channel");
+        if (params.frame_sec <= 0 || params.hangover_sec < 0 ||
+                params.min_speech_sec < 0 || params.pad_sec < 0) {
+            std::cout << "Frame should be positive, durations ";
+            std::cout << "should not be negative" << std::endl;
+            return 1;
+        }
+        vad_split(cmd.get<std::string>("--file"),
+            cmd.get<std::string>("--prefix"), is_verbose, block_size, jobs,
+            format, bits, dither, rate, mix, params,
+            cmd.get<std::string>("--list"),
+            cmd.get<bool>("--list-only"));
     } else if (program.is_subcommand_used("split")) {
             auto input = program.at<argparse::ArgumentParser>(
             "split").get<std::string>("--file");
             auto prefix = program.at<argparse::ArgumentParser>(
             "split").get<std::string>("--prefix");
-           split(input, prefix, is_verbose);
+           split(input, prefix, is_verbose, block_size, jobs, format,
+               bits, dither, rate, mix);
     } else if (program.is_subcommand_used("slice")) {
         auto input = program.at<argparse::ArgumentParser>(
             "slice").get<std::string>("--file");
+        auto segments = program.at<argparse::ArgumentParser>(
+            "slice").present<std::string>("--segments");
         auto starts = program.at<argparse::ArgumentParser>(
-            "slice").get<std::vector<int>>("--start");
+            "slice").present<std::vector<double>>("--start");
         auto ends = program.at<argparse::ArgumentParser>(
-            "slice").get<std::vector<int>>("--end");
+            "slice").present<std::vector<double>>("--end");
         auto outs = program.at<argparse::ArgumentParser>(
-            "slice").get<std::vector<std::string>>("--output");
+            "slice").present<std::vector<std::string>>("--output");
+        bool in_samples = program.at<argparse::ArgumentParser>(
+            "slice").get<bool>("--samples");
+
+        if (segments) {
+            auto prefix = program.at<argparse::ArgumentParser>(
+                "slice").get<std::string>("--prefix");
+            slice_segments(input, read_segments(*segments, prefix),
+                is_verbose, block_size, jobs, format, bits, dither, rate,
+                mix, in_samples);
+            return 0;
+        }
 
-        if ((starts.size() != ends.size()) ||
-                (ends.size() != outs.size())) {
+        if (!starts || !ends || !outs ||
+                (starts->size() != ends->size()) ||
+                (ends->size() != outs->size())) {
                std::cout << "Number of slice params should be same";
                std::cout << std::endl;
                return 1;
         }
 
         std::vector<chunk> slices = std::vector<chunk>();
-        for (int i=0; i < starts.size(); i++) {
-            slices.push_back(chunk{starts[i], ends[i], outs[i]});
+        for (int i=0; i < starts->size(); i++) {
+            slices.push_back(chunk{(*starts)[i], (*ends)[i], (*outs)[i]});
         }
-        slice(input, slices, is_verbose);
+        slice(input, slices, is_verbose, block_size, jobs, format, bits,
+            dither, rate, mix, in_samples);
     } else {
         std::cout << program;
         return 0;
@@ -0,0 +1,277 @@
+// Copyright 2023 Andrei Drozdov
+
+#include "./mix.h"  // NOLINT [build/include]
+#include "./kernels.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+using namespace std;  // NOLINT [build/namespaces]
+
+namespace {
+
+// Frames per tile: all channels of a tile stay in L1/L2
+const int64_t MIX_TILE_FRAMES = 1024;
+
+// One output channel of n frames from planar float inputs
+typedef void (*mix_row_fn)(const float * const *in, const float *w,
+    int inputs, int64_t n, float *out);
+
+inline void mix_tail(const float * const *in, const float *w, int inputs,
+        int64_t first, int64_t n, float *out) {
+    for (int64_t i = first; i < n; i++) {
+        float acc = 0;
+        for (int c = 0; c < inputs; c++) {
+            acc += w[c] * in[c][i];
+        }
+        out[i] = acc;
+    }
+}
+
+#ifdef __SSE2__
+
+void mix_row_sse2(const float * const *in, const float *w, int inputs,
+        int64_t n, float *out) {
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 acc = _mm_setzero_ps();
+        for (int c = 0; c < inputs; c++) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[c]),
+                _mm_loadu_ps(in[c] + i)));
+        }
+        _mm_storeu_ps(out + i, acc);
+    }
+    mix_tail(in, w, inputs, i, n, out);
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 void mix_row_avx2(const float * const *in, const float *w, int inputs,
+        int64_t n, float *out) {
+    int64_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 acc = _mm256_setzero_ps();
+        for (int c = 0; c < inputs; c++) {
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(w[c]),
+                _mm256_loadu_ps(in[c] + i)));
+        }
+        _mm256_storeu_ps(out + i, acc);
+    }
+    mix_tail(in, w, inputs, i, n, out);
+}
+
+#undef AVX2
+
+#else
+
+void mix_row_scalar(const float * const *in, const float *w, int inputs,
+        int64_t n, float *out) {
+    mix_tail(in, w, inputs, 0, n, out);
+}
+
+#endif  // __SSE2__
+
+mix_row_fn select_mix_row() {
+#ifdef __SSE2__
+    return cpu_has_avx2() ? &mix_row_avx2 : &mix_row_sse2;
+#else
+    return &mix_row_scalar;
+#endif
+}
+
+// Input copied by output r, -1 when it is a mix
+int selected(const mix_matrix& mix, int r) {
+    int res = -1;
+    for (int c = 0; c < mix.inputs; c++) {
+        float w = mix.weights[r * mix.inputs + c];
+        if (w == 1.0f && res < 0) {
+            res = c;
+        } else if (w != 0.0f) {
+            return -1;
+        }
+    }
+    return res;
+}
+
+bool is_selection(const mix_matrix& mix) {
+    for (int r = 0; r < mix.outputs; r++) {
+        if (selected(mix, r) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Planar tiles of every input and the mixed output channels.
+// Selections keep the output type, mixes work in float.
+class mix_tiles{
+ public:
+        mix_tiles(const mix_matrix& mix, sample_type type)
+                : mix(mix), selection(is_selection(mix)) {
+            this->work = this->selection ? type : SAMPLE_F32;
+            this->bytes = sample_bytes(this->work);
+            this->data.resize(MIX_TILE_FRAMES * mix.inputs * this->bytes);
+            this->row.resize(MIX_TILE_FRAMES);
+            for (int c = 0; c < mix.inputs; c++) {
+                this->in.push_back(this->data.data() +
+                    c * MIX_TILE_FRAMES * this->bytes);
+                this->planar.push_back(
+                    reinterpret_cast<const float*>(this->in.back()));
+            }
+            this->from_work = select_convert(this->work, type);
+        }
+
+        // Output channel r of the n frames in the input tiles
+        void write(int r, int64_t n, char *out, bool dither) {
+            static const mix_row_fn mix_row = select_mix_row();
+            if (this->selection) {
+                memcpy(out, this->in[selected(this->mix, r)],
+                    n * this->bytes);
+                return;
+            }
+            const float *w = this->mix.weights.data() + r * this->mix.inputs;
+            float *dst = this->from_work == nullptr ?
+                reinterpret_cast<float*>(out) : this->row.data();
+            mix_row(this->planar.data(), w, this->mix.inputs, n, dst);
+            if (this->from_work != nullptr) {
+                this->from_work(reinterpret_cast<const char*>(dst), n, out,
+                    dither);
+            }
+        }
+
+        const mix_matrix& mix;
+        bool selection;
+        sample_type work;
+        int64_t bytes;
+        std::vector<char*> in;
+
+ private:
+        std::vector<char> data;
+        // The input tiles as floats (mixes only)
+        std::vector<const float*> planar;
+        std::vector<float> row;
+        convert_fn from_work;
+};
+
+}  // namespace
+
+bool parse_mix(const string& spec, int inputs, mix_matrix* mix,
+        string* error) {
+    *mix = mix_matrix{inputs, 0, {}};
+    if (spec == "mono") {
+        mix->outputs = 1;
+        mix->weights.assign(inputs, 1.0f / inputs);
+        return true;
+    }
+    istringstream rows(spec);
+    string row;
+    // getline() drops empty last rows and terms
+    bool trailing = !spec.empty() && spec.back() == ',';
+    while (getline(rows, row, ',')) {
+        if (trailing || row.empty() || row.back() == '+') {
+            *error = "empty output channel";
+            return false;
+        }
+        vector<double> weights(inputs, 0);
+        vector<int> plain;
+        bool weighted = false;
+        istringstream terms(row);
+        string term;
+        while (getline(terms, term, '+')) {
+            size_t star = term.find('*');
+            string channel = star == string::npos ? term :
+                term.substr(star + 1);
+            char *end = nullptr;
+            double weight = 1;
+            if (star != string::npos) {
+                string text = term.substr(0, star);
+                weight = strtod(text.c_str(), &end);
+                if (end == text.c_str() || *end != '\0') {
+                    *error = "bad weight '" + text + "'";
+                    return false;
+                }
+                weighted = true;
+            }
+            long c = strtol(channel.c_str(), &end, 10);  // NOLINT
+            if (end == channel.c_str() || *end != '\0' || c < 0 ||
+                    c >= inputs) {
+                *error = "no input channel '" + channel + "'";
+                return false;
+            }
+            if (star == string::npos) {
+                plain.push_back(c);
+            } else {
+                weights[c] += weight;
+            }
+        }
+        // Channels without weights are averaged, unless the row has
+        // weighted terms
+        for (int c : plain) {
+            weights[c] += weighted ? 1.0 : 1.0 / plain.size();
+        }
+        mix->weights.insert(mix->weights.end(), weights.begin(),
+            weights.end());
+        mix->outputs++;
+    }
+    if (mix->outputs == 0) {
+        *error = "no output channels";
+        return false;
+    }
+    return true;
+}
+
+void mix_deinterleave(const mix_matrix& mix, sample_type from,
+        sample_type to, const char *src, int64_t frames, char * const *dst,
+        bool dither) {
+    mix_tiles tiles(mix, to);
+    convert_fn to_work = select_convert(from, tiles.work);
+    deinterleave_fn split = select_deinterleave(tiles.bytes, mix.inputs);
+    int64_t from_frame = sample_bytes(from) * mix.inputs;
+    int64_t to_bytes = sample_bytes(to);
+    vector<char> tile(to_work == nullptr ? 0 :
+        MIX_TILE_FRAMES * mix.inputs * tiles.bytes);
+    for (int64_t done = 0; done < frames; done += MIX_TILE_FRAMES) {
+        int64_t n = min(MIX_TILE_FRAMES, frames - done);
+        const char *frame = src + done * from_frame;
+        if (to_work != nullptr) {
+            to_work(frame, n * mix.inputs, tile.data(), dither);
+            frame = tile.data();
+        }
+        split(frame, n, mix.inputs, tiles.in.data());
+        for (int r = 0; r < mix.outputs; r++) {
+            tiles.write(r, n, dst[r] + done * to_bytes, dither);
+        }
+    }
+}
+
+void mix_in_place(const mix_matrix& mix, sample_type type,
+        char * const *channels, int64_t frames, bool dither) {
+    // A tile of every input is read before its outputs are written
+    mix_tiles tiles(mix, type);
+    convert_fn to_work = select_convert(type, tiles.work);
+    int64_t bytes = sample_bytes(type);
+    for (int64_t done = 0; done < frames; done += MIX_TILE_FRAMES) {
+        int64_t n = min(MIX_TILE_FRAMES, frames - done);
+        for (int c = 0; c < mix.inputs; c++) {
+            const char *src = channels[c] + done * bytes;
+            if (to_work == nullptr) {
+                memcpy(tiles.in[c], src, n * bytes);
+            } else {
+                to_work(src, n, tiles.in[c], false);
+            }
+        }
+        for (int r = 0; r < mix.outputs; r++) {
+            tiles.write(r, n, channels[r] + done * bytes, dither);
+        }
+    }
+}
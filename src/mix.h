@@ -0,0 +1,44 @@
+// Copyright 2023 Andrei Drozdov
+
+#ifndef SRC_MIX_H_
+#define SRC_MIX_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "./convert.h"
+
+// Channel remix matrix.
+// Output channel r is the sum of weights[r * inputs + c] * input c.
+// Selections (every output is one input as it is) move samples without
+// touching them, weighted mixes are computed in 32 bit float and
+// rounded back to the sample type.
+
+typedef struct {
+    int inputs;
+    // 0: no remix
+    int outputs;
+    std::vector<float> weights;
+} mix_matrix;
+
+// Parse a mix of `inputs` channels: output channels separated by ','
+// and made of input channels joined by '+', "0+2,1" averages 0 and 2
+// into the first output and copies 1 into the second. Weighted terms
+// ("0.7*0+0.3*2") keep their weights, "mono" averages all channels.
+// Returns false with a message on bad specs.
+bool parse_mix(const std::string& spec, int inputs, mix_matrix* mix,
+    std::string* error);
+
+// Interleaved `from` samples into `to` channel buffers (one per output):
+// conversion, de-interleave and remix in one pass over cache sized tiles
+void mix_deinterleave(const mix_matrix& mix, sample_type from,
+    sample_type to, const char *src, int64_t frames, char * const *dst,
+    bool dither);
+
+// Remix channel buffers in place, there are max(inputs, outputs) of them
+void mix_in_place(const mix_matrix& mix, sample_type type,
+    char * const *channels, int64_t frames, bool dither);
+
+#endif  // SRC_MIX_H_
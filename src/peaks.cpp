@@ -0,0 +1,275 @@
+// Copyright 2023 Andrei Drozdov
+
+#include "./peaks.h"  // NOLINT [build/include]
+#include "./kernels.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+using namespace std;  // NOLINT [build/namespaces]
+
+namespace {
+
+const char PEAK_MAGIC[8] = {'A', 'S', 'L', 'P', 'E', 'A', 'K', '1'};
+
+// Min, max and the sum of squares (in `power`) of one bin
+typedef peak_bin (*bin_fn)(const float *x, int64_t n);
+
+inline void bin_tail(const float *x, int64_t first, int64_t n,
+        peak_bin *res) {
+    for (int64_t i = first; i < n; i++) {
+        res->lo = min(res->lo, x[i]);
+        res->hi = max(res->hi, x[i]);
+        res->power += x[i] * x[i];
+    }
+}
+
+#ifdef __SSE2__
+
+inline float hsum(__m128 v) {
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+inline float hmin(__m128 v) {
+    v = _mm_min_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_min_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+inline float hmax(__m128 v) {
+    v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+peak_bin bin_sse2(const float *x, int64_t n) {
+    __m128 lo = _mm_set1_ps(HUGE_VALF), hi = _mm_set1_ps(-HUGE_VALF);
+    __m128 sq = _mm_setzero_ps();
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(x + i);
+        lo = _mm_min_ps(lo, v);
+        hi = _mm_max_ps(hi, v);
+        sq = _mm_add_ps(sq, _mm_mul_ps(v, v));
+    }
+    peak_bin res = peak_bin{hmin(lo), hmax(hi), hsum(sq)};
+    bin_tail(x, i, n, &res);
+    return res;
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 peak_bin bin_avx2(const float *x, int64_t n) {
+    __m256 lo = _mm256_set1_ps(HUGE_VALF), hi = _mm256_set1_ps(-HUGE_VALF);
+    __m256 sq = _mm256_setzero_ps();
+    int64_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(x + i);
+        lo = _mm256_min_ps(lo, v);
+        hi = _mm256_max_ps(hi, v);
+        sq = _mm256_add_ps(sq, _mm256_mul_ps(v, v));
+    }
+    peak_bin res = peak_bin{
+        hmin(_mm_min_ps(_mm256_castps256_ps128(lo),
+            _mm256_extractf128_ps(lo, 1))),
+        hmax(_mm_max_ps(_mm256_castps256_ps128(hi),
+            _mm256_extractf128_ps(hi, 1))),
+        hsum(_mm_add_ps(_mm256_castps256_ps128(sq),
+            _mm256_extractf128_ps(sq, 1)))};
+    bin_tail(x, i, n, &res);
+    return res;
+}
+
+#undef AVX2
+
+#else
+
+peak_bin bin_scalar(const float *x, int64_t n) {
+    peak_bin res = peak_bin{HUGE_VALF, -HUGE_VALF, 0};
+    bin_tail(x, 0, n, &res);
+    return res;
+}
+
+#endif  // __SSE2__
+
+bin_fn select_bin() {
+#ifdef __SSE2__
+    return cpu_has_avx2() ? &bin_avx2 : &bin_sse2;
+#else
+    return &bin_scalar;
+#endif
+}
+
+}  // namespace
+
+int64_t peak_bins(int64_t frames, int level) {
+    return (frames + PEAK_BIN_FRAMES[level] - 1) / PEAK_BIN_FRAMES[level];
+}
+
+void accumulate_peaks(const float *x, int64_t n, int64_t bin_frames,
+        peak_bin *bins) {
+    static const bin_fn bin = select_bin();
+    for (int64_t first = 0; first < n; first += bin_frames) {
+        int64_t count = min(bin_frames, n - first);
+        peak_bin res = bin(x + first, count);
+        res.power /= count;
+        *bins++ = res;
+    }
+}
+
+void merge_peaks(const peak_bin *in, int64_t n, int64_t in_frames,
+        int factor, peak_bin *out) {
+    int64_t count = (n + in_frames - 1) / in_frames;
+    for (int64_t first = 0; first < count; first += factor) {
+        peak_bin res = in[first];
+        // Mean squares weighted by the samples of every bin
+        double power = 0;
+        int64_t last = min(first + factor, count);
+        for (int64_t i = first; i < last; i++) {
+            res.lo = min(res.lo, in[i].lo);
+            res.hi = max(res.hi, in[i].hi);
+            power += static_cast<double>(in[i].power) *
+                min(in_frames, n - i * in_frames);
+        }
+        res.power = power / min(in_frames * factor, n - first * in_frames);
+        *out++ = res;
+    }
+}
+
+PeakIndex::PeakIndex() : fd(-1), header(peak_header{}), offsets() {}
+
+PeakIndex::~PeakIndex() {
+    this->close();
+}
+
+bool PeakIndex::write(const string& fname, const peak_header& header,
+        const vector<vector<peak_bin>>& levels) {
+    // Written under a temporary name and renamed: readers never see a
+    // partial sidecar
+    string tmp = fname + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    peak_header head = header;
+    memcpy(head.magic, PEAK_MAGIC, sizeof(PEAK_MAGIC));
+    bool done = ::write(fd, &head, sizeof(head)) == sizeof(head);
+    for (int l = 0; done && l < PEAK_LEVELS; l++) {
+        int64_t size = levels[l].size() * sizeof(peak_bin);
+        const char *buf = reinterpret_cast<const char*>(levels[l].data());
+        for (int64_t pos = 0; done && pos < size; ) {
+            ssize_t was_wr = ::write(fd, buf + pos, size - pos);
+            done = was_wr > 0;
+            pos += max(was_wr, ssize_t(0));
+        }
+    }
+    done = ::close(fd) == 0 && done;
+    if (!done || rename(tmp.c_str(), fname.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool PeakIndex::open(const string& fname, int64_t source_size,
+        int64_t source_mtime) {
+    this->close();
+    this->fd = ::open(fname.c_str(), O_RDONLY);
+    if (this->fd < 0) {
+        return false;
+    }
+    peak_header& head = this->header;
+    int64_t size = lseek(this->fd, 0, SEEK_END);
+    bool valid = pread(this->fd, &head, sizeof(head), 0) == sizeof(head) &&
+        memcmp(head.magic, PEAK_MAGIC, sizeof(PEAK_MAGIC)) == 0 &&
+        head.source_size == source_size &&
+        head.source_mtime == source_mtime &&
+        head.frames >= 0 && head.channels > 0;
+    int64_t pos = sizeof(head);
+    for (int l = 0; valid && l < PEAK_LEVELS; l++) {
+        this->offsets[l] = pos;
+        pos += peak_bins(head.frames, l) * head.channels * sizeof(peak_bin);
+    }
+    if (!valid || pos != size) {
+        this->close();
+        return false;
+    }
+    return true;
+}
+
+void PeakIndex::close() {
+    if (this->fd >= 0) {
+        ::close(this->fd);
+        this->fd = -1;
+    }
+    this->header = peak_header{};
+}
+
+int PeakIndex::level_for(double frames_per_pixel) const {
+    int level = 0;
+    while (level + 1 < PEAK_LEVELS &&
+            PEAK_BIN_FRAMES[level + 1] <= frames_per_pixel) {
+        level++;
+    }
+    return level;
+}
+
+vector<peak_pixel> PeakIndex::query(int channel, int64_t first,
+        int64_t last, int pixels) const {
+    last = min(last, this->header.frames);
+    if (this->fd < 0 || channel < 0 || channel >= this->header.channels ||
+            first < 0 || first >= last || pixels <= 0) {
+        return {};
+    }
+    int64_t span = last - first;
+    int level = this->level_for(static_cast<double>(span) / pixels);
+    int64_t bin_frames = PEAK_BIN_FRAMES[level];
+    int64_t count = peak_bins(this->header.frames, level);
+
+    // Only the bins of the range are read
+    int64_t lo = first / bin_frames;
+    int64_t hi = min((last + bin_frames - 1) / bin_frames, count);
+    vector<peak_bin> bins(hi - lo);
+    int64_t size = bins.size() * sizeof(peak_bin);
+    int64_t pos = this->offsets[level] +
+        (channel * count + lo) * sizeof(peak_bin);
+    if (pread(this->fd, bins.data(), size, pos) != size) {
+        return {};
+    }
+
+    vector<peak_pixel> res(pixels);
+    for (int p = 0; p < pixels; p++) {
+        // Bins overlapping the pixel, at least the one it starts in
+        int64_t start = first + span * p / pixels;
+        int64_t end = first + span * (p + 1) / pixels;
+        int64_t b0 = start / bin_frames;
+        int64_t b1 = max(b0 + 1, min((end + bin_frames - 1) / bin_frames,
+            hi));
+        float mn = HUGE_VALF, mx = -HUGE_VALF;
+        double power = 0;
+        int64_t frames = 0;
+        for (int64_t b = b0; b < b1; b++) {
+            const peak_bin& bin = bins[b - lo];
+            int64_t n = min(bin_frames, this->header.frames - b * bin_frames);
+            mn = min(mn, bin.lo);
+            mx = max(mx, bin.hi);
+            power += static_cast<double>(bin.power) * n;
+            frames += n;
+        }
+        res[p] = peak_pixel{mn, mx, static_cast<float>(sqrt(power / frames))};
+    }
+    return res;
+}
@@ -0,0 +1,99 @@
+// Copyright 2023 Andrei Drozdov
+
+#ifndef SRC_PEAKS_H_
+#define SRC_PEAKS_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// Waveform overview pyramid.
+// Every channel is summarized in bins of 256, 4096 and 65536 samples
+// (min, max and mean square of the float samples). The pyramid is kept
+// in a sidecar file next to the recording, keyed by the size and mtime
+// of the source. A query for a range at N pixels reads only the level
+// whose bins are the largest not wider than a pixel, so each pixel
+// merges fewer than 16 bins (below 256 samples per pixel, the bins of
+// the finest level are repeated).
+
+const int PEAK_LEVELS = 3;
+const int64_t PEAK_BIN_FRAMES[PEAK_LEVELS] = {256, 4096, 65536};
+
+// Samples of one bin
+typedef struct {
+    float lo;
+    float hi;
+    // Mean square
+    float power;
+} peak_bin;
+
+// Samples of one pixel
+typedef struct {
+    float min;
+    float max;
+    float rms;
+} peak_pixel;
+
+// Sidecar header, the levels follow it: bins of channel 0, then
+// channel 1, ... of level 0, then level 1 ...
+typedef struct {
+    char magic[8];
+    int64_t source_size;
+    // Modification time of the source (ns since the epoch)
+    int64_t source_mtime;
+    int64_t frames;
+    int32_t sample_rate;
+    int32_t channels;
+} peak_header;
+
+// Bins of a level for `frames` samples
+int64_t peak_bins(int64_t frames, int level);
+
+// Bins of `bin_frames` of n samples starting at a bin boundary, the
+// last one may be shorter. SSE2/AVX2 versions are picked at runtime.
+void accumulate_peaks(const float *x, int64_t n, int64_t bin_frames,
+    peak_bin *bins);
+// Bins of `factor` times more samples from `in` bins of `in_frames`
+// covering n samples
+void merge_peaks(const peak_bin *in, int64_t n, int64_t in_frames,
+    int factor, peak_bin *out);
+
+class PeakIndex{
+ public:
+        PeakIndex();
+        ~PeakIndex();
+        PeakIndex(const PeakIndex&) = delete;
+        PeakIndex& operator=(const PeakIndex&) = delete;
+
+        // Write a sidecar, levels[l] holds peak_bins(frames, l) bins of
+        // every channel
+        static bool write(const std::string& fname,
+            const peak_header& header,
+            const std::vector<std::vector<peak_bin>>& levels);
+
+        // Open a sidecar made for a source of this size and mtime,
+        // false when it is missing, stale or broken
+        bool open(const std::string& fname, int64_t source_size,
+            int64_t source_mtime);
+        void close();
+
+        // Peaks of frames [first, last) of a channel at `pixels` pixels,
+        // pixel p covers [first + (last - first) * p / pixels, ...)
+        std::vector<peak_pixel> query(int channel, int64_t first,
+            int64_t last, int pixels) const;
+        // Level used by query() for this many frames per pixel
+        int level_for(double frames_per_pixel) const;
+
+        inline int64_t Frames() const { return this->header.frames; }
+        inline int Channels() const { return this->header.channels; }
+        inline int SampleRate() const { return this->header.sample_rate; }
+
+ private:
+        int fd;
+        peak_header header;
+        // File position of every level
+        int64_t offsets[PEAK_LEVELS];
+};
+
+#endif  // SRC_PEAKS_H_
@@ -0,0 +1,87 @@
+// Copyright 2023 Andrei Drozdov
+
+#include "./pool.h"  // NOLINT [build/include]
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>  // NOLINT [build/c++11]
+#include <thread>  // NOLINT [build/c++11]
+#include <vector>
+
+using namespace std;  // NOLINT [build/namespaces]
+
+WorkerPool::WorkerPool(int jobs) : fn(nullptr), tasks(0), next(0),
+        generation(0), busy(0), stop(false) {
+    this->jobs = max(jobs, 1);
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        lock_guard<mutex> guard(this->lock);
+        this->stop = true;
+    }
+    this->wake.notify_all();
+    for (int i=0; i < this->threads.size(); i++) {
+        this->threads[i].join();
+    }
+}
+
+int WorkerPool::hardware_jobs() {
+    return max(static_cast<int>(thread::hardware_concurrency()), 1);
+}
+
+void WorkerPool::work(int id) {
+    for (int64_t task = this->next++; task < this->tasks;
+            task = this->next++) {
+        (*this->fn)(task, id);
+    }
+}
+
+void WorkerPool::worker(int id) {
+    int64_t seen = 0;
+    unique_lock<mutex> guard(this->lock);
+    while (true) {
+        this->wake.wait(guard, [this, &seen]() {
+            return this->stop || this->generation != seen;
+        });
+        if (this->stop) {
+            return;
+        }
+        seen = this->generation;
+        guard.unlock();
+        this->work(id);
+        guard.lock();
+        if (--this->busy == 0) {
+            this->done.notify_one();
+        }
+    }
+}
+
+void WorkerPool::run(int64_t tasks, const task_fn& fn) {
+    if (min(int64_t(this->jobs), tasks) <= 1) {
+        for (int64_t task = 0; task < tasks; task++) {
+            fn(task, 0);
+        }
+        return;
+    }
+    if (this->threads.empty()) {
+        for (int i=1; i < this->jobs; i++) {
+            this->threads.emplace_back(&WorkerPool::worker, this, i);
+        }
+    }
+    {
+        lock_guard<mutex> guard(this->lock);
+        this->fn = &fn;
+        this->tasks = tasks;
+        this->next = 0;
+        this->busy = static_cast<int>(this->threads.size());
+        this->generation++;
+    }
+    this->wake.notify_all();
+    this->work(0);
+    unique_lock<mutex> guard(this->lock);
+    this->done.wait(guard, [this]() { return this->busy == 0; });
+    this->fn = nullptr;
+}
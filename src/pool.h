@@ -0,0 +1,58 @@
+// Copyright 2023 Andrei Drozdov
+
+#ifndef SRC_POOL_H_
+#define SRC_POOL_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>  // NOLINT [build/c++11]
+#include <functional>
+#include <mutex>  // NOLINT [build/c++11]
+#include <thread>  // NOLINT [build/c++11]
+#include <vector>
+
+// Runs independent tasks on a fixed number of threads.
+// Workers take the next task index from a shared counter, so long
+// tasks don't hold back the rest of the queue. The threads start with
+// the first parallel run() and wait for the next one in between, a
+// pool kept across runs never spawns threads again.
+class WorkerPool{
+ public:
+        // Task callback: task index and worker index (< Jobs())
+        typedef std::function<void(int64_t task, int worker)> task_fn;
+
+        explicit WorkerPool(int jobs);
+        ~WorkerPool();
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        // Run tasks [0, tasks) and wait for all of them, one run at a
+        // time
+        void run(int64_t tasks, const task_fn& fn);
+
+        inline int Jobs() const { return this->jobs; }
+
+        // Number of hardware threads (at least 1)
+        static int hardware_jobs();
+
+ private:
+        int jobs;
+        // Workers 1..jobs-1, the calling thread is worker 0
+        std::vector<std::thread> threads;
+        std::mutex lock;
+        std::condition_variable wake;
+        std::condition_variable done;
+        // Current run, a new generation wakes the workers
+        const task_fn* fn;
+        int64_t tasks;
+        std::atomic<int64_t> next;
+        int64_t generation;
+        int busy;
+        bool stop;
+
+        void work(int id);
+        void worker(int id);
+};
+
+#endif  // SRC_POOL_H_
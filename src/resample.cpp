@@ -0,0 +1,259 @@
+// Copyright 2023 Andrei Drozdov
+
+#include "./resample.h"  // NOLINT [build/include]
+#include "./kernels.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT [build/c++11]
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+using namespace std;  // NOLINT [build/namespaces]
+
+namespace {
+
+// Sinc zero crossings on each side of the output position (at the
+// input rate, more when the cutoff is lower)
+const int FILTER_ZEROS = 16;
+// Cutoff relative to the lower Nyquist frequency: the transition band
+// ends below it
+const double FILTER_ROLLOFF = 0.92;
+// Kaiser window shape, about 80 dB of stopband attenuation
+const double KAISER_BETA = 8.0;
+// Largest bank (coefficients), ratios of huge coprime rates
+const int64_t MAX_BANK_SIZE = int64_t(1) << 24;
+
+typedef float (*dot_fn)(const float *a, const float *b, int n);
+
+#ifdef __SSE2__
+
+// SSE2 and AVX2: n is a multiple of 8 (padded taps)
+float dot_sse2(const float *a, const float *b, int n) {
+    __m128 lo = _mm_setzero_ps(), hi = _mm_setzero_ps();
+    for (int i = 0; i < n; i += 8) {
+        lo = _mm_add_ps(lo, _mm_mul_ps(_mm_loadu_ps(a + i),
+            _mm_loadu_ps(b + i)));
+        hi = _mm_add_ps(hi, _mm_mul_ps(_mm_loadu_ps(a + i + 4),
+            _mm_loadu_ps(b + i + 4)));
+    }
+    __m128 v = _mm_add_ps(lo, hi);
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 float dot_avx2(const float *a, const float *b, int n) {
+    __m256 sum = _mm256_setzero_ps();
+    for (int i = 0; i < n; i += 8) {
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a + i),
+            _mm256_loadu_ps(b + i)));
+    }
+    __m128 v = _mm_add_ps(_mm256_castps256_ps128(sum),
+        _mm256_extractf128_ps(sum, 1));
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+#undef AVX2
+
+#else
+
+float dot_scalar(const float *a, const float *b, int n) {
+    float sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+#endif  // __SSE2__
+
+dot_fn select_dot() {
+#ifdef __SSE2__
+    return cpu_has_avx2() ? &dot_avx2 : &dot_sse2;
+#else
+    return &dot_scalar;
+#endif
+}
+
+double bessel_i0(double x) {
+    double sum = 1, term = 1;
+    for (int k = 1; k < 64 && term > sum * 1e-15; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+int reach_of(int up, int down) {
+    double scale = min(1.0, static_cast<double>(up) / down);
+    return static_cast<int>(ceil(FILTER_ZEROS / scale));
+}
+
+shared_ptr<const filter_bank> design(int up, int down) {
+    shared_ptr<filter_bank> bank = make_shared<filter_bank>();
+    bank->up = up;
+    bank->down = down;
+    bank->reach = reach_of(up, down);
+    // Window of 2 * reach frames padded for the vector loops, the
+    // padding coefficients fall outside of the window and are 0
+    bank->taps = (2 * bank->reach + 7) / 8 * 8;
+    if (static_cast<int64_t>(up) * bank->taps > MAX_BANK_SIZE) {
+        cout << "Unsupported resampling ratio " << up << "/" << down << endl;
+        exit(1);
+    }
+    double cutoff = min(1.0, static_cast<double>(up) / down) *
+        FILTER_ROLLOFF;
+    double norm = bessel_i0(KAISER_BETA);
+    bank->coefs.resize(static_cast<size_t>(up) * bank->taps);
+    vector<double> phase(bank->taps);
+    for (int p = 0; p < up; p++) {
+        // Coefficient j weights input frame n0 + reach - taps + 1 + j,
+        // x is its distance to the output position n0 + p / up
+        for (int j = 0; j < bank->taps; j++) {
+            double x = static_cast<double>(p) / up -
+                (bank->reach - bank->taps + 1 + j);
+            double r = x / bank->reach;
+            double window = fabs(r) < 1 ?
+                bessel_i0(KAISER_BETA * sqrt(1 - r * r)) / norm : 0;
+            double arg = M_PI * cutoff * x;
+            double sinc = x == 0 ? 1 : sin(arg) / arg;
+            phase[j] = cutoff * sinc * window;
+        }
+        // Unit gain at 0 Hz for every phase
+        double sum = accumulate(phase.begin(), phase.end(), 0.0);
+        for (int j = 0; j < bank->taps; j++) {
+            bank->coefs[static_cast<size_t>(p) * bank->taps + j] =
+                static_cast<float>(phase[j] / sum);
+        }
+    }
+    return bank;
+}
+
+shared_ptr<const filter_bank> cached_bank(int up, int down) {
+    // One bank per ratio for all streams of the process
+    static mutex lock;
+    static map<pair<int, int>, shared_ptr<const filter_bank>> banks;
+    lock_guard<mutex> guard(lock);
+    shared_ptr<const filter_bank>& bank = banks[{up, down}];
+    if (!bank) {
+        bank = design(up, down);
+    }
+    return bank;
+}
+
+pair<int64_t, int64_t> reduce(int in_rate, int out_rate) {
+    int64_t g = gcd(in_rate, out_rate);
+    return {out_rate / g, in_rate / g};
+}
+
+}  // namespace
+
+int64_t resampled_frames(int in_rate, int out_rate, int64_t frames) {
+    pair<int64_t, int64_t> ratio = reduce(in_rate, out_rate);
+    return (frames * ratio.first + ratio.second - 1) / ratio.second;
+}
+
+int64_t resample_capacity(int in_rate, int out_rate, int64_t frames) {
+    // Outputs delayed by the filter reach come out with the last call
+    pair<int64_t, int64_t> ratio = reduce(in_rate, out_rate);
+    int64_t reach = reach_of(ratio.first, ratio.second);
+    return (frames + reach) * ratio.first / ratio.second + 2;
+}
+
+Resampler::Resampler(int in_rate, int out_rate, int channels,
+        sample_type type, bool dither) {
+    assert(in_rate > 0 && out_rate > 0);
+    pair<int64_t, int64_t> ratio = reduce(in_rate, out_rate);
+    this->bank = cached_bank(ratio.first, ratio.second);
+    this->channels = channels;
+    this->to_float = select_convert(type, SAMPLE_F32);
+    this->from_float = select_convert(SAMPLE_F32, type);
+    this->dither = dither;
+    // Silence before the first frame fills the first window
+    this->origin = this->bank->reach - this->bank->taps + 1;
+    this->history.assign(channels, vector<float>(-this->origin, 0.0f));
+    this->consumed = 0;
+    this->next = 0;
+}
+
+int64_t Resampler::process(const char * const *in, int64_t frames,
+        bool last, char * const *out) {
+    static const dot_fn dot = select_dot();
+    const filter_bank& bank = *this->bank;
+    int64_t size = this->history[0].size();
+    for (int ch = 0; ch < this->channels; ch++) {
+        // New frames as floats, silence after the last one
+        vector<float>& h = this->history[ch];
+        h.resize(size + frames + (last ? bank.reach : 0), 0.0f);
+        char *dst = reinterpret_cast<char*>(h.data() + size);
+        if (frames <= 0) {
+            continue;
+        } else if (this->to_float == nullptr) {
+            memcpy(dst, in[ch], frames * sizeof(float));
+        } else {
+            this->to_float(in[ch], frames, dst, false);
+        }
+    }
+    this->consumed += max(frames, int64_t(0));
+
+    // Outputs whose windows are complete
+    int64_t total = (this->consumed * bank.up + bank.down - 1) / bank.down;
+    int64_t limit = total;
+    if (!last) {
+        int64_t end = this->origin +
+            static_cast<int64_t>(this->history[0].size()) - bank.reach;
+        limit = end <= 0 ? 0 :
+            min(total, (end * bank.up + bank.down - 1) / bank.down);
+    }
+    int64_t count = max(limit - this->next, int64_t(0));
+    this->output.resize(count);
+    for (int ch = 0; ch < this->channels; ch++) {
+        const float *h = this->history[ch].data();
+        for (int64_t i = 0; i < count; i++) {
+            int64_t pos = (this->next + i) * bank.down;
+            int64_t n0 = pos / bank.up;
+            int64_t phase = pos - n0 * bank.up;
+            this->output[i] = dot(bank.coefs.data() + phase * bank.taps,
+                h + (n0 + bank.reach - bank.taps + 1 - this->origin),
+                bank.taps);
+        }
+        if (this->from_float == nullptr) {
+            memcpy(out[ch], this->output.data(), count * sizeof(float));
+        } else {
+            this->from_float(reinterpret_cast<const char*>(
+                this->output.data()), count, out[ch], this->dither);
+        }
+    }
+    this->next += count;
+
+    // Frames before the window of the next output are not needed
+    int64_t keep = this->next * bank.down / bank.up + bank.reach -
+        bank.taps + 1;
+    int64_t drop = min(keep - this->origin,
+        static_cast<int64_t>(this->history[0].size()));
+    if (drop > 0) {
+        for (int ch = 0; ch < this->channels; ch++) {
+            this->history[ch].erase(this->history[ch].begin(),
+                this->history[ch].begin() + drop);
+        }
+        this->origin += drop;
+    }
+    return count;
+}
@@ -0,0 +1,68 @@
+// Copyright 2023 Andrei Drozdov
+
+#ifndef SRC_RESAMPLE_H_
+#define SRC_RESAMPLE_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "./convert.h"
+
+// Polyphase FIR sample rate conversion.
+// The rate ratio is reduced to up / down (16000 / 44100 = 160 / 441).
+// Output frame k sits at input position k * down / up, it is the inner
+// product of the input around that position with one of `up` phases of
+// a Kaiser windowed sinc low-pass (cutoff below the lower Nyquist
+// frequency). Phases are computed once per ratio and shared.
+// Streams start and end with silence: n input frames always give
+// ceil(n * up / down) output frames, whatever the block sizes.
+
+// Filter phases of one ratio, `taps` coefficients per phase
+typedef struct {
+    int up;
+    int down;
+    int taps;
+    // Input frames after the output position a phase reaches
+    int reach;
+    std::vector<float> coefs;
+} filter_bank;
+
+// Output frames of a stream of `frames` input frames
+int64_t resampled_frames(int in_rate, int out_rate, int64_t frames);
+// Most output frames one Resampler::process() call may write for
+// `frames` input frames
+int64_t resample_capacity(int in_rate, int out_rate, int64_t frames);
+
+class Resampler{
+ public:
+        // Channel buffers of `type` samples in and out. Samples are
+        // filtered as 32 bit floats, integer output is rounded (with
+        // optional TPDF dither).
+        Resampler(int in_rate, int out_rate, int channels,
+            sample_type type, bool dither);
+
+        // Resample `frames` more input frames of every channel into
+        // `out` (resample_capacity() frames each), `last` flushes the
+        // end of the stream. Returns the number of output frames.
+        int64_t process(const char * const *in, int64_t frames, bool last,
+            char * const *out);
+
+ private:
+        std::shared_ptr<const filter_bank> bank;
+        int channels;
+        convert_fn to_float;
+        convert_fn from_float;
+        bool dither;
+        // Input frames not needed by earlier outputs, per channel;
+        // history[ch][0] is input frame `origin`
+        std::vector<std::vector<float>> history;
+        int64_t origin;
+        // Input frames received and the next output frame
+        int64_t consumed;
+        int64_t next;
+        std::vector<float> output;
+};
+
+#endif  // SRC_RESAMPLE_H_
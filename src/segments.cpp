@@ -0,0 +1,260 @@
+// Copyright 2023 Andrei Drozdov
+
+#include "./segments.h"  // NOLINT [build/include]
+
+#include <stdlib.h>
+
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;  // NOLINT [build/namespaces]
+
+namespace {
+
+void fail(const string& fname, int line, const string& message) {
+    cout << "Bad segment in " << fname << ":" << line << ": ";
+    cout << message << endl;
+    exit(1);
+}
+
+bool to_seconds(const string& text, double* value) {
+    char *end = nullptr;
+    *value = strtod(text.c_str(), &end);
+    return end != text.c_str() && *end == '\0';
+}
+
+string output_name(const string& prefix, int line, const string& speaker) {
+    string name = prefix + to_string(line);
+    if (!speaker.empty()) {
+        name += "_" + speaker;
+    }
+    return name + ".wav";
+}
+
+string trim(const string& text) {
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == string::npos) {
+        return "";
+    }
+    size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+// start,end[,output]
+bool parse_csv(const string& text, const string& prefix, int line,
+        chunk* segment) {
+    vector<string> fields;
+    string field;
+    istringstream row(text);
+    char sep = text.find('\t') != string::npos ? '\t' : ',';
+    while (getline(row, field, sep)) {
+        fields.push_back(trim(field));
+    }
+    if (fields.size() < 2) {
+        return false;
+    }
+    if (!to_seconds(fields[0], &segment->sec_start) ||
+            !to_seconds(fields[1], &segment->sec_end)) {
+        return false;
+    }
+    segment->filename = fields.size() > 2 && !fields[2].empty() ?
+        fields[2] : output_name(prefix, line, "");
+    return true;
+}
+
+// SPEAKER file chan onset duration <NA> <NA> name <NA> <NA>
+bool parse_rttm(const string& text, const string& prefix, int line,
+        chunk* segment) {
+    vector<string> fields;
+    string field;
+    istringstream row(text);
+    while (row >> field) {
+        fields.push_back(field);
+    }
+    if (fields.size() < 5 || fields[0] != "SPEAKER") {
+        return false;
+    }
+    double duration = 0;
+    if (!to_seconds(fields[3], &segment->sec_start) ||
+            !to_seconds(fields[4], &duration)) {
+        return false;
+    }
+    segment->sec_end = segment->sec_start + duration;
+    string speaker = fields.size() > 7 && fields[7] != "<NA>" ?
+        fields[7] : "";
+    segment->filename = output_name(prefix, line, speaker);
+    return true;
+}
+
+// Flat JSON object: string and number values only
+bool parse_json(const string& text, map<string, string>* values) {
+    size_t pos = 0;
+    auto skip = [&text, &pos]() {
+        while (pos < text.size() && isspace(text[pos])) pos++;
+    };
+    auto read_string = [&text, &pos](string* out) {
+        if (pos >= text.size() || text[pos] != '"') return false;
+        for (pos++; pos < text.size() && text[pos] != '"'; pos++) {
+            if (text[pos] == '\\' && pos + 1 < text.size()) {
+                pos++;
+                char c = text[pos];
+                out->push_back(c == 'n' ? '\n' : c == 't' ? '\t' : c);
+            } else {
+                out->push_back(text[pos]);
+            }
+        }
+        pos++;
+        return pos <= text.size();
+    };
+
+    skip();
+    if (pos >= text.size() || text[pos++] != '{') {
+        return false;
+    }
+    while (true) {
+        skip();
+        if (pos < text.size() && text[pos] == '}') {
+            return true;
+        }
+        string key, value;
+        if (!read_string(&key)) {
+            return false;
+        }
+        skip();
+        if (pos >= text.size() || text[pos++] != ':') {
+            return false;
+        }
+        skip();
+        if (pos < text.size() && text[pos] == '"') {
+            if (!read_string(&value)) {
+                return false;
+            }
+        } else {
+            size_t end = text.find_first_of(",}", pos);
+            if (end == string::npos) {
+                return false;
+            }
+            value = trim(text.substr(pos, end - pos));
+            pos = end;
+        }
+        (*values)[key] = value;
+        skip();
+        if (pos < text.size() && text[pos] == ',') {
+            pos++;
+        }
+    }
+}
+
+bool parse_jsonl(const string& text, const string& prefix, int line,
+        chunk* segment) {
+    map<string, string> values;
+    if (!parse_json(text, &values) || values.count("start") == 0) {
+        return false;
+    }
+    if (!to_seconds(values["start"], &segment->sec_start)) {
+        return false;
+    }
+    if (values.count("end") > 0) {
+        if (!to_seconds(values["end"], &segment->sec_end)) {
+            return false;
+        }
+    } else {
+        double duration = 0;
+        if (!to_seconds(values["duration"], &duration)) {
+            return false;
+        }
+        segment->sec_end = segment->sec_start + duration;
+    }
+    segment->filename = values.count("output") > 0 ?
+        values["output"] : output_name(prefix, line, values["speaker"]);
+    return true;
+}
+
+}  // namespace
+
+vector<chunk> read_segments(const string& fname, const string& prefix) {
+    ifstream input(fname);
+    if (!input.is_open()) {
+        cout << "Unable to read segments file: " << fname << endl;
+        exit(1);
+    }
+
+    string ext = fname.substr(fname.find_last_of('.') + 1);
+    for (char& c : ext) {
+        c = tolower(c);
+    }
+    bool (*parse)(const string&, const string&, int, chunk*) = parse_csv;
+    if (ext == "rttm") {
+        parse = parse_rttm;
+    } else if (ext == "jsonl" || ext == "json") {
+        parse = parse_jsonl;
+    }
+
+    vector<chunk> segments;
+    string text;
+    int line = 0;
+    while (getline(input, text)) {
+        line++;
+        text = trim(text);
+        if (text.empty() || text[0] == '#' || text == "[" || text == "]") {
+            continue;
+        }
+        chunk segment = chunk{};
+        if (!parse(text, prefix, line, &segment)) {
+            // First CSV row may name the columns
+            if (parse == parse_csv && segments.empty() && line == 1) {
+                continue;
+            }
+            fail(fname, line, text);
+        }
+        if (segment.sec_start < 0 || segment.sec_end < segment.sec_start) {
+            fail(fname, line, "negative or reversed interval");
+        }
+        segments.push_back(segment);
+    }
+    return segments;
+}
+
+void write_segments(const string& fname, const vector<chunk>& segments,
+        const string& recording) {
+    ofstream file;
+    if (fname != "-") {
+        file.open(fname);
+        if (!file.is_open()) {
+            cout << "Unable to write segments file: " << fname << endl;
+            exit(1);
+        }
+    }
+    ostream& out = fname == "-" ? cout : file;
+
+    string ext = fname.substr(fname.find_last_of('.') + 1);
+    for (char& c : ext) {
+        c = tolower(c);
+    }
+    // Microseconds, finer than a sample at common rates
+    out << fixed << setprecision(6);
+    if (ext != "rttm" && ext != "jsonl" && ext != "json") {
+        out << "start,end,output" << endl;
+    }
+    for (const chunk& s : segments) {
+        if (ext == "rttm") {
+            out << "SPEAKER " << recording << " 1 " << s.sec_start << " ";
+            out << s.sec_end - s.sec_start;
+            out << " <NA> <NA> speech <NA> <NA>" << endl;
+        } else if (ext == "jsonl" || ext == "json") {
+            out << "{\"start\": " << s.sec_start << ", \"end\": ";
+            out << s.sec_end << ", \"output\": \"" << s.filename << "\"}";
+            out << endl;
+        } else {
+            out << s.sec_start << "," << s.sec_end << "," << s.filename;
+            out << endl;
+        }
+    }
+    out << defaultfloat;
+}
@@ -0,0 +1,29 @@
+// Copyright 2023 Andrei Drozdov
+
+#ifndef SRC_SEGMENTS_H_
+#define SRC_SEGMENTS_H_
+
+#include <string>
+#include <vector>
+
+#include "./slice.h"
+
+// Segment manifests produced by diarization / ASR tools.
+// The format is picked by the file extension:
+//   .csv / .tsv   start,end[,output] in seconds, '#' comments and a
+//                 header row are skipped
+//   .rttm         SPEAKER <file> <chan> <onset> <duration> ... <name>
+//   .jsonl/.json  one object per line: "start", "end" or "duration",
+//                 optional "output" and "speaker"
+// Segments without an output name are written to
+// <prefix><line>.wav (<prefix><line>_<speaker>.wav when known).
+std::vector<chunk> read_segments(const std::string& fname,
+    const std::string& prefix);
+
+// Write segments in the format of the file extension (CSV when unknown),
+// "-" prints CSV. RTTM lines name the recording and the speaker
+// "speech", read_segments() reads every format back.
+void write_segments(const std::string& fname,
+    const std::vector<chunk>& segments, const std::string& recording);
+
+#endif  // SRC_SEGMENTS_H_
@@ -1,14 +1,29 @@
 // Copyright 2023 Andrei Drozdov
 
 #include "./slice.h"  // NOLINT [build/include]
+#include "./g711.h"
+#include "./pool.h"
+#include "./stats.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <stdint.h>
 #include <string>
 #include <iostream>
+#include <sstream>
 #include <vector>
-#include <cstdio>
 #include <cassert>
+#include <cstring>
 #include <map>
+#include <algorithm>
+#include <cmath>
+#include <future>  // NOLINT [build/c++11]
+#include <list>
+#include <memory>
+#include <numeric>
+#include <utility>
 
 using namespace std;  // NOLINT [build/namespaces]
 
@@ -19,7 +34,7 @@ map<int16_t, string> AudioSlicer::format_mapping = {
     {CT_IBM_CVSD, "IBM CVSD"},
     {CT_MS_ALAW, "Microsoft ALAW (8-bit ITU-T G.711BA ALAW)"},
     {CT_MS_MLAW, "Microsoft M-LAW (8-bit ITU-T G.711 M-LAW"},
-    {0x11, "Intel IMA/DVI ADPCM"},
+    {CT_IMA_ADPCM, "Intel IMA/DVI ADPCM"},
     {0x16, "ITU G.723 ADPCM"},
     {0x17, "Dialogic OKI ADPCM"},
     {0x30, "Dolby AAC"},
@@ -42,161 +57,346 @@ const string AudioSlicer::audio_format() {
 
 void AudioSlicer::init(const string& fname) {
     this->filename = fname;
-    FILE* wavFile = this->read_header();
-    fclose(wavFile);
-    int format = this->header.AudioFormat;
-    if (format == CT_MS_MLAW || format == CT_MS_ALAW) {
-        wavFile = this->read_ulaw_header();
-        fclose(wavFile);
+    if (!this->source.open(fname)) {
+        cout << "Unable to read wave file: " << this->filename << endl;
     }
+    assert(this->source.mode() != DataSource::CLOSED);
+
+    this->read_header();
     this->is_verbose = false;
+    this->block_frames = DEFAULT_BLOCK_FRAMES;
+    // Float sources stay float unless asked otherwise
+    this->output_format = this->header.AudioFormat == CT_IEEEFP ?
+        CT_IEEEFP : CT_LPCM;
+    this->dither = false;
+    this->output_bits = 0;
+    this->output_rate = 0;
+    this->mix = mix_matrix{};
+    this->jobs = WorkerPool::hardware_jobs();
+    this->decode_jobs = this->jobs;
 
     this->codecs = {
         {CT_LPCM, &AudioSlicer::lpcm_decoder},
+        {CT_IEEEFP, &AudioSlicer::lpcm_decoder},
         {CT_MS_MLAW, &AudioSlicer::mu_law_decoder},
-        {CT_MS_ALAW, &AudioSlicer::a_law_decoder}
+        {CT_MS_ALAW, &AudioSlicer::a_law_decoder},
+        {CT_IMA_ADPCM, &AudioSlicer::ima_decoder},
+        {CT_MSADPCM, &AudioSlicer::ms_adpcm_decoder}
     };
+    this->setup_stream();
+
+    // Block codecs without a fact section: count whole blocks
+    if (this->num_samples == 0 && this->codec_block_frames > 1) {
+        this->num_samples = this->wave.data_size /
+            this->codec_block_bytes * this->codec_block_frames;
+        this->duration = static_cast<double>(this->num_samples) /
+            static_cast<double>(this->header.SamplesPerSec);
+    }
+}
+
+bool AudioSlicer::is_passthrough() {
+    // G.711 source written in the same encoding: copy the codes
+    int format = this->header.AudioFormat;
+    return (format == CT_MS_MLAW || format == CT_MS_ALAW) &&
+        format == this->output_format && !this->is_resampled() &&
+        !this->is_mixed();
+}
+
+bool AudioSlicer::is_encoded() {
+    // Decoded samples are G.711 encoded on the way out
+    return (this->output_format == CT_MS_MLAW ||
+        this->output_format == CT_MS_ALAW) && !this->is_passthrough();
+}
+
+bool AudioSlicer::is_copy() {
+    // Output bytes are exactly the source bytes of the data section
+    int format = this->header.AudioFormat;
+    return this->is_passthrough() || (this->output_format == format &&
+        (format == CT_LPCM || format == CT_IEEEFP) &&
+        this->convert == nullptr && !this->is_resampled() &&
+        !this->is_mixed());
+}
+
+bool AudioSlicer::is_resampled() {
+    return this->output_rate > 0 &&
+        this->output_rate != static_cast<int>(this->header.SamplesPerSec);
+}
+
+bool AudioSlicer::is_mixed() {
+    return this->mix.outputs > 0;
+}
+
+int AudioSlicer::out_channels() {
+    return this->is_mixed() ? this->mix.outputs : this->header.NumOfChan;
+}
+
+int AudioSlicer::out_rate() {
+    return this->is_resampled() ? this->output_rate :
+        static_cast<int>(this->header.SamplesPerSec);
+}
+
+int64_t AudioSlicer::frame_at(double sec) {
+    return llround(sec * this->header.SamplesPerSec);
+}
+
+void AudioSlicer::setup_stream() {
+    int format = this->header.AudioFormat;
+    this->decoder = nullptr;
+    if (this->codecs.find(format) != this->codecs.end()) {
+        this->decoder = this->codecs[format];
+    }
+
+    // Sample width of the decoded stream
+    this->pcm_bytes = this->header.bitsPerSample / 8;
+    this->convert = nullptr;
+    if (this->is_passthrough()) {
+        // Channel buffers keep the source codes
+        this->decoder = &AudioSlicer::lpcm_decoder;
+    } else if (format == CT_MS_MLAW || format == CT_MS_ALAW) {
+        // Decoded sizes 8bit -> 16 bit
+        this->pcm_bytes = 2;
+    }
+    // Frame codecs: every frame can be addressed on its own
+    this->codec_block_frames = 1;
+    this->codec_block_bytes = this->header.NumOfChan *
+        (this->header.bitsPerSample / 8);
+    if (format == CT_IMA_ADPCM) {
+        // Blocks of blockAlign bytes, 4 bit codes -> 16 bit samples
+        int channels = this->header.NumOfChan;
+        int block = this->header.blockAlign;
+        this->pcm_bytes = 2;
+        this->codec_block_bytes = block;
+        this->codec_block_frames = ima_samples_per_block(block, channels);
+        if (this->codec_block_frames == 0 ||
+                (block - 4 * channels) % (4 * channels) != 0) {
+            // Broken layout, check_codec() reports it
+            this->decoder = nullptr;
+            this->codec_block_frames = 1;
+        }
+    } else if (format == CT_MSADPCM) {
+        this->setup_ms_adpcm();
+    }
+
+    // Samples the decoder produces and the type the output needs
+    this->decoded_type = sample_type_of(format == CT_IEEEFP,
+        this->pcm_bytes);
+    this->pcm_type = this->decoded_type;
+    bool is_float = is_float_sample(this->decoded_type);
+    int out_bytes = this->output_bits / 8;
+    if (this->output_format == CT_IEEEFP) {
+        if (out_bytes > 0) {
+            this->pcm_type = sample_type_of(true, out_bytes);
+        } else if (!is_float) {
+            this->pcm_type = SAMPLE_F32;
+        }
+    } else if (this->is_encoded()) {
+        // G.711 encoders take 16 bit samples
+        this->pcm_type = SAMPLE_S16;
+    } else if (this->output_format == CT_LPCM) {
+        if (out_bytes > 0) {
+            this->pcm_type = sample_type_of(false, out_bytes);
+        } else if (is_float) {
+            this->pcm_type = SAMPLE_S16;
+        }
+    }
+    if (this->pcm_type != this->decoded_type && !this->is_passthrough()) {
+        this->convert = select_convert(this->decoded_type, this->pcm_type);
+        if (this->convert == nullptr) {
+            // check_codec() reports it
+            this->decoder = nullptr;
+        }
+        this->pcm_bytes = sample_bytes(this->pcm_type);
+    }
+    this->deinterleave = select_deinterleave(
+        this->pcm_bytes, this->header.NumOfChan);
+    this->interleave = select_interleave(
+        this->pcm_bytes, this->out_channels());
+}
+
+void AudioSlicer::set_output_format(int16_t format) {
+    assert(format == CT_LPCM || format == CT_IEEEFP ||
+        format == CT_MS_MLAW || format == CT_MS_ALAW);
+    this->output_format = format;
+    this->setup_stream();
+}
+
+void AudioSlicer::set_output_bits(int bits) {
+    assert(bits >= 0 && bits <= 64 && bits % 8 == 0);
+    this->output_bits = bits;
+    this->setup_stream();
+}
+
+void AudioSlicer::set_dither(bool dither) {
+    this->dither = dither;
+}
+
+void AudioSlicer::set_output_rate(int rate) {
+    assert(rate >= 0);
+    this->output_rate = rate;
+    this->setup_stream();
+}
+
+void AudioSlicer::set_mix(const string& spec) {
+    this->mix = mix_matrix{};
+    string error;
+    if (!spec.empty() &&
+            !parse_mix(spec, this->header.NumOfChan, &this->mix, &error)) {
+        cout << "Bad channel mix '" << spec << "': " << error << endl;
+        exit(1);
+    }
+    this->setup_stream();
+}
+
+void AudioSlicer::set_block_size(int64_t frames) {
+    assert(frames > 0);
+    this->block_frames = frames;
+}
+
+void AudioSlicer::set_jobs(int jobs) {
+    assert(jobs > 0);
+    this->jobs = jobs;
+    this->decode_jobs = jobs;
+}
+
+void AudioSlicer::alloc_channels(stream_buffers* stream, int64_t frames) {
+    // Buffers of the previous stream go back to the pool first
+    *stream = stream_buffers{};
+    // Whole codec blocks are decoded around both ends of the range
+    int64_t capacity = frames + 2 * this->codec_block_frames;
+    // Decoders may write wider samples than the converted ones
+    int bytes = max(this->pcm_bytes, sample_bytes(this->decoded_type));
+    // Remixes to more channels than the source are done in place
+    int buffers = max(int(this->header.NumOfChan), this->out_channels());
+    for (int i=0; i < buffers; i++) {
+        stream->storage.emplace_back(capacity * bytes);
+        stream->channels.push_back(stream->storage.back().data());
+    }
+    if (this->is_resampled()) {
+        // Output frames of one block, more than its input when upsampling
+        int64_t out = resample_capacity(this->header.SamplesPerSec,
+            this->output_rate, capacity);
+        for (int i=0; i < this->out_channels(); i++) {
+            stream->storage.emplace_back(out * this->pcm_bytes);
+            stream->resampled.push_back(stream->storage.back().data());
+        }
+        frames = max(frames, out);
+    }
+    stream->interleaved = SampleBuffer(
+        frames * this->pcm_bytes * this->out_channels());
+    if (this->is_encoded()) {
+        stream->encoded = SampleBuffer(frames * this->out_channels());
+    }
+}
+
+void AudioSlicer::load_channels(const char *buf, int64_t frames,
+        char * const *channels) {
+    if (this->is_mixed()) {
+        // Conversion and remix fused with the de-interleave
+        mix_deinterleave(this->mix, this->decoded_type, this->pcm_type,
+            buf, frames, channels, this->dither);
+        return;
+    }
+    this->deinterleave(buf, frames, this->header.NumOfChan, channels);
+}
+
+void AudioSlicer::lpcm_decoder(const char *buf, int64_t frames,
+        char * const *channels) {
+    if (this->convert != nullptr && !this->is_mixed()) {
+        // Sample type conversion fused with the de-interleave
+        convert_deinterleave(this->convert, this->deinterleave,
+            this->decoded_type, this->pcm_type, buf, frames,
+            this->header.NumOfChan, channels, this->dither);
+        return;
+    }
+    this->load_channels(buf, frames, channels);
+}
+
+void AudioSlicer::a_law_decoder(const char *buf, int64_t frames,
+        char * const *channels) {
+    // 8 bit codes -> 16 bit samples, decoded straight into the channels
+    g711_decode(G711_ALAW, buf, frames, this->header.NumOfChan, channels);
+}
+
+void AudioSlicer::mu_law_decoder(const char *buf, int64_t frames,
+        char * const *channels) {
+    g711_decode(G711_ULAW, buf, frames, this->header.NumOfChan, channels);
+}
+
+void AudioSlicer::decode_blocks(const char *buf, int64_t frames,
+        char * const *channels, const block_fn& decode) {
+    // Blocks are independent: big ranges are split between threads
+    int64_t blocks = frames / this->codec_block_frames;
+    int64_t tasks = min(int64_t(this->decode_jobs), blocks / 16);
+    if (tasks <= 1) {
+        decode(buf, blocks, channels);
+        return;
+    }
+    if (this->block_pool == nullptr ||
+            this->block_pool->Jobs() != this->decode_jobs) {
+        this->block_pool = make_unique<WorkerPool>(this->decode_jobs);
+    }
+    this->block_pool->run(tasks, [&](int64_t task, int worker) {
+        int64_t first = blocks * task / tasks;
+        int64_t last = blocks * (task + 1) / tasks;
+        // Decoders write their own samples, converted ones are wider
+        int64_t offset = first * this->codec_block_frames *
+            sample_bytes(this->decoded_type);
+        vector<char*> dst(this->header.NumOfChan);
+        for (int ch=0; ch < dst.size(); ch++) {
+            dst[ch] = channels[ch] + offset;
+        }
+        decode(buf + first * this->codec_block_bytes, last - first,
+            dst.data());
+    });
+}
+
+void AudioSlicer::ima_decoder(const char *buf, int64_t frames,
+        char * const *channels) {
+    this->decode_blocks(buf, frames, channels,
+        [this](const char *src, int64_t blocks, char * const *dst) {
+            ima_decode(src, blocks, this->codec_block_bytes,
+                this->header.NumOfChan, dst);
+        });
+}
+
+void AudioSlicer::ms_adpcm_decoder(const char *buf, int64_t frames,
+        char * const *channels) {
+    this->decode_blocks(buf, frames, channels,
+        [this](const char *src, int64_t blocks, char * const *dst) {
+            ms_adpcm_decode(src, blocks, this->codec_block_bytes,
+                this->codec_block_frames, this->header.NumOfChan,
+                this->adpcm_coefs.data(), this->adpcm_coefs.size(), dst);
+        });
 }
 
-void AudioSlicer::load_channels(char *buf) {
-    int bytes_per_sample = this->header.bitsPerSample / 8.0;
-    map<int, int> ch_pos = map<int, int>();
-    this->channels = vector<char*>();
-    for (int i=0; i < this->header.NumOfChan; i++) {
-        this->channels.push_back(
-            reinterpret_cast<char*>(malloc(
-                this->num_samples * this->header.bitsPerSample / 8.0)));
-        ch_pos[i] = 0;
-    }
-
-    int ch = 0;
-    for (int i=0; i < this->header.Subchunk2Size; i+=bytes_per_sample) {
-        for (int j=0; j < bytes_per_sample; j++) {
-            this->channels[ch][ch_pos[ch]++] = buf[i+j];
-        }
-        ch = (ch+1) % (this->channels.size());
-    }
-    free(buf);
-}
-
-void AudioSlicer::lpcm_decoder() {
-    FILE* wavFile = this->read_header();
-    char *buf = reinterpret_cast<char*>(malloc(this->header.Subchunk2Size));
-    size_t was_rd = fread(buf, 1, this->header.Subchunk2Size, wavFile);
-    assert(was_rd);
-    fclose(wavFile);
-
-    this->load_channels(buf);
-}
-
-void AudioSlicer::a_law_decoder() {
-    FILE* wavFile = this->read_ulaw_header();
-    char *buf = reinterpret_cast<char*>(
-        malloc(this->header.Subchunk2Size));
-    size_t was_rd = fread(buf, 1, this->header.Subchunk2Size, wavFile);
-    assert(was_rd);
-
-    int16_t *decoded_buf = reinterpret_cast<int16_t*>(
-        malloc(this->header.Subchunk2Size*2));
-
-    int8_t tmp = 0;
-    int8_t segment = 0;
-    int8_t sign = 0;
-    int16_t decoded = 0;
-    for (int i = 0; i < this->header.Subchunk2Size; i++) {
-        // invert even bits of sample (0x0005 -> 0b101)
-        tmp = buf[i] ^ 0x55;
-        // get first bit
-        sign = (tmp & 0x80) >> 7;
-        // get the data
-        decoded = ((tmp & 0x000f) << 1) | 0x0001;
-        // get the segment bits data
-        segment = (tmp & 0x0070) >> 4;
-        // Update segment boundaries
-        if ((segment - 1) == 0) {
-            decoded |= 0x0020;
-        } else if ((segment - 1) > 0) {
-            decoded |= 0x0020;
-            decoded = decoded << (segment - 1);
-        }
-        // Remove segment data
-        decoded = decoded << 3;
-        // Set sign
-        if (sign) {
-            decoded = 0-decoded;
-        }
-
-        // Store the result sample
-        decoded_buf[i] = decoded;
-    }
-
-    char *result_buf = reinterpret_cast<char*>(decoded_buf);
-
-    // Set audio format Liner PCM
-    this->header.AudioFormat = CT_LPCM;
-    // Set decoded sizes 8bit -> 16 bit
-    this->header.bitsPerSample *= 2;
-    this->header.bytesPerSec *= 2;
-    this->header.Subchunk2Size *= 2;
-    // Set LPCM header size
-    this->header.Subchunk1Size = 0x10;
-
-    this->load_channels(result_buf);
-}
-
-void AudioSlicer::mu_law_decoder() {
-    FILE* wavFile = this->read_ulaw_header();
-    char *buf = reinterpret_cast<char*>(
-        malloc(this->header.Subchunk2Size));
-    size_t was_rd = fread(buf, 1, this->header.Subchunk2Size, wavFile);
-    assert(was_rd);
-
-    // allocate decoded space 8 bit -> 16 bit = size * 2
-    int16_t *decoded_buf = reinterpret_cast<int16_t*>(
-        malloc(this->header.Subchunk2Size*2));
-    int16_t decoded = 0;
-    int16_t sign = 0;
-    int16_t segment = 0;
-    for (int i = 0; i < this->header.Subchunk2Size; i++) {
-        // invert sample
-        decoded = ~buf[i] & 0x00FF;
-        // get first bit (0x80 -> 0b10000000) + shift 7 = first bit
-        sign = (buf[i] & 0x80) >> 7;
-        // get segment 2,3,4 bits, 0x0070 = 0b111000 + shift 4 = 111
-        segment = (decoded & 0x0070) >> 4;
-        // get last 4 bits 0x000f = 0b1111
-        decoded = (decoded & 0x000f) << 1;
-
-        // The value 33 is the amount the end- points
-        // of the segments are offset from even powers of two.
-        // 0x0021 = 33
-        decoded += 0x0021;
-        // shift by segment and apply sign
-        decoded = decoded << segment;
-        if (sign) {
-            decoded -= 0x0021;
-        } else {
-            decoded = 0x0021 - decoded;
-        }
-        // normalize to 16 bit
-        decoded = decoded << 2;
-
-        // write decoded sample
-        decoded_buf[i] = decoded;
-    }
-
-    char *result_buf = reinterpret_cast<char*>(decoded_buf);
-
-    // Set audio format Liner PCM
-    this->header.AudioFormat = CT_LPCM;
-    // Set decoded sizes 8bit -> 16 bit
-    this->header.bitsPerSample *= 2;
-    this->header.bytesPerSec *= 2;
-    this->header.Subchunk2Size *= 2;
-    // Set LPCM header size
-    this->header.Subchunk1Size = 0x10;
-
-    this->load_channels(result_buf);
+void AudioSlicer::setup_ms_adpcm() {
+    // fmt extension: samples per block, number of coefficient pairs
+    // and the pairs themselves
+    int channels = this->header.NumOfChan;
+    int block = this->header.blockAlign;
+    int most = ms_adpcm_samples_per_block(block, channels);
+    const vector<char>& ext = this->wave.fmt_data;
+    uint16_t per_block = 0, count = 0;
+    if (ext.size() >= 22) {
+        memcpy(&per_block, ext.data() + 18, 2);
+        memcpy(&count, ext.data() + 20, 2);
+    }
+    this->adpcm_coefs = vector<ms_adpcm_coef>(
+        MS_ADPCM_COEFS, MS_ADPCM_COEFS + 7);
+    if (count > 0 && ext.size() >= 22 + 4 * count) {
+        this->adpcm_coefs.resize(count);
+        memcpy(this->adpcm_coefs.data(), ext.data() + 22, 4 * count);
+    }
+
+    this->pcm_bytes = 2;
+    this->codec_block_bytes = block;
+    this->codec_block_frames = per_block >= 2 && per_block <= most ?
+        per_block : most;
+    if (most == 0) {
+        // Broken layout, check_codec() reports it
+        this->decoder = nullptr;
+        this->codec_block_frames = 1;
+    }
 }
 
 AudioSlicer::AudioSlicer(const string& fname) {
@@ -208,167 +408,496 @@ AudioSlicer::AudioSlicer(const string& fname, bool is_verbose) {
     this->is_verbose = is_verbose;
 }
 
-FILE* AudioSlicer::read_header() {
+void AudioSlicer::read_header() {
+    STATS_SCOPE(STAGE_HEADER);
+    // Walk all RIFF chunks once and remember where each of them is,
+    // only chunk headers and the small fmt/fact sections are read
+    this->wave = wave_info{};
+    this->wave.fact_samples = -1;
     this->header = wav_header{};
 
-    FILE* wavFile = fopen(this->filename.c_str(), "r");
-    if (wavFile == nullptr) {
-        cout << "Unable to read wave file: " << this->filename << endl;
+    char riff[12];
+    int64_t was_read = this->source.read(0, sizeof(riff), riff);
+    // RF64 and BW64 files keep 64 bit sizes in a ds64 section
+    this->wave.is_rf64 = memcmp(riff, "RF64", 4) == 0 ||
+        memcmp(riff, "BW64", 4) == 0;
+    bool is_wave = was_read == sizeof(riff) &&
+        (memcmp(riff, "RIFF", 4) == 0 || this->wave.is_rf64) &&
+        memcmp(riff + 8, "WAVE", 4) == 0;
+    if (!is_wave) {
+        cout << "Not a RIFF/WAVE file: " << this->filename << endl;
     }
-    assert(wavFile != nullptr);
+    assert(is_wave);
+    memcpy(this->header.RIFF, riff, 4);
+    memcpy(&this->header.ChunkSize, riff + 4, 4);
+    memcpy(this->header.WAVE, riff + 8, 4);
 
-    size_t was_read = fread(&header, 1, sizeof(wav_header), wavFile);
-    assert(was_read);
-    int bytes_per_sample = this->header.bitsPerSample / 8.0;
+    bool has_fmt = false;
+    bool has_data = false;
+    ds64_chunk ds64 = ds64_chunk{};
+    int64_t pos = sizeof(riff);
+    while (this->source.available(pos, 8) == 8) {
+        char head[8];
+        uint32_t size = 0;
+        this->source.read(pos, 8, head);
+        memcpy(&size, head + 4, 4);
 
-    this->num_samples = static_cast<double>(
-        header.Subchunk2Size) / static_cast<double>(
-        (header.NumOfChan) * bytes_per_sample);
-    this->format_prefix = "Unknown";
-    if (this->format_mapping.find(
-            header.AudioFormat) != this->format_mapping.end()) {
-        this->format_prefix = this->format_mapping[header.AudioFormat];
+        riff_chunk chunk = riff_chunk{};
+        memcpy(chunk.id, head, 4);
+        chunk.offset = pos + 8;
+        chunk.size = size;
+
+        if (memcmp(chunk.id, "ds64", 4) == 0 && this->wave.is_rf64) {
+            this->source.read(chunk.offset, min(chunk.size,
+                int64_t(sizeof(ds64))), reinterpret_cast<char*>(&ds64));
+        } else if (memcmp(chunk.id, "fmt ", 4) == 0 && !has_fmt) {
+            has_fmt = true;
+            this->wave.fmt_data.resize(size);
+            this->source.read(chunk.offset, size,
+                this->wave.fmt_data.data());
+            memcpy(&this->wave.fmt, this->wave.fmt_data.data(),
+                min(sizeof(fmt_chunk), this->wave.fmt_data.size()));
+            this->header.Subchunk1Size = size;
+        } else if (memcmp(chunk.id, "fact", 4) == 0 && size >= 4) {
+            uint32_t samples = 0;
+            this->source.read(chunk.offset, 4,
+                reinterpret_cast<char*>(&samples));
+            this->wave.fact_samples = samples;
+            if (samples == 0xFFFFFFFF && this->wave.is_rf64) {
+                this->wave.fact_samples = ds64.sampleCount;
+            }
+        } else if (memcmp(chunk.id, "data", 4) == 0 && !has_data) {
+            has_data = true;
+            if (size == 0xFFFFFFFF && this->wave.is_rf64) {
+                chunk.size = ds64.dataSize;
+            } else if (size == 0 || size == 0xFFFFFFFF) {
+                // Streaming writers leave the size empty, use the whole file
+                chunk.size = this->source.available(
+                    chunk.offset, this->source.Size());
+            }
+            this->wave.data_offset = chunk.offset;
+            this->wave.data_size = chunk.size;
+        }
+        this->wave.chunks.push_back(chunk);
+        // Chunks are word aligned
+        pos = chunk.offset + chunk.size + (chunk.size & 1);
     }
-    this->duration = this->num_samples / static_cast<double>(
-        this->header.SamplesPerSec);
-    return wavFile;
-}
+    if (!has_fmt || !has_data) {
+        cout << "Missing fmt or data section: " << this->filename << endl;
+    }
+    assert(has_fmt && has_data);
 
-FILE* AudioSlicer::read_ulaw_header() {
-    // Read modified structure for MS u-law and a-law format
-    // Probably need to refactor it
-    // Explanation: MS a-law and mu-law formats
-    // are extended with fact section
-    this->header = wav_header{};
+    // Resolve the real format of WAVE_FORMAT_EXTENSIBLE files
+    const fmt_chunk& fmt = this->wave.fmt;
+    this->wave.format = fmt.AudioFormat;
+    if (fmt.AudioFormat == CT_EXTENSIBLE && fmt.cbSize >= 22) {
+        memcpy(&this->wave.format, fmt.SubFormat, 2);
+    }
 
-    ulaw_header head = ulaw_header{};
+    memcpy(this->header.fmt, "fmt ", 4);
+    this->header.AudioFormat = this->wave.format;
+    this->header.NumOfChan = fmt.NumOfChan;
+    this->header.SamplesPerSec = fmt.SamplesPerSec;
+    this->header.bytesPerSec = fmt.bytesPerSec;
+    this->header.blockAlign = fmt.blockAlign;
+    this->header.bitsPerSample = fmt.bitsPerSample;
+    memcpy(this->header.Subchunk2ID, "data", 4);
+    // 32 bit view of the size, Size() has the full value
+    this->header.Subchunk2Size = min(this->wave.data_size, RIFF_MAX_SIZE);
+    this->data_offset = this->wave.data_offset;
 
-    FILE* wavFile = fopen(this->filename.c_str(), "r");
-    if (wavFile == nullptr) {
-        cout << "Unable to read wave file: " << this->filename << endl;
+    int bytes_per_sample = this->header.bitsPerSample / 8;
+
+    this->num_samples = 0;
+    if (bytes_per_sample > 0 && this->header.NumOfChan > 0) {
+        this->num_samples = this->wave.data_size /
+            (this->header.NumOfChan * bytes_per_sample);
+    } else if (this->wave.fact_samples >= 0) {
+        this->num_samples = this->wave.fact_samples;
     }
-    assert(wavFile != nullptr);
-
-    size_t was_read = fread(&head, 1, sizeof(ulaw_header), wavFile);
-    assert(was_read);
-
-    this->header.RIFF[0] = head.RIFF[0];
-    this->header.RIFF[1] = head.RIFF[1];
-    this->header.RIFF[2] = head.RIFF[2];
-    this->header.RIFF[3] = head.RIFF[3];
-    this->header.ChunkSize = head.ChunkSize;
-    this->header.WAVE[0] = head.WAVE[0];
-    this->header.WAVE[1] = head.WAVE[1];
-    this->header.WAVE[2] = head.WAVE[2];
-    this->header.WAVE[3] = head.WAVE[3];
-
-    this->header.fmt[0] = head.fmt[0];
-    this->header.fmt[1] = head.fmt[1];
-    this->header.fmt[2] = head.fmt[2];
-    this->header.fmt[3] = head.fmt[3];
-
-    this->header.Subchunk1Size = head.Subchunk1Size;
-    this->header.AudioFormat = head.AudioFormat;
-    this->header.NumOfChan = head.NumOfChan;
-    this->header.SamplesPerSec = head.SamplesPerSec;
-    this->header.bytesPerSec = head.bytesPerSec;
-    this->header.blockAlign = head.blockAlign;
-    this->header.bitsPerSample = head.bitsPerSample;
-
-    this->header.Subchunk2ID[0] = head.Subchunk2ID[0];
-    this->header.Subchunk2ID[1] = head.Subchunk2ID[1];
-    this->header.Subchunk2ID[2] = head.Subchunk2ID[2];
-    this->header.Subchunk2ID[3] = head.Subchunk2ID[3];
-    this->header.Subchunk2Size = head.Subchunk2Size;
-
-    int bytes_per_sample = this->header.bitsPerSample / 8.0;
-
-    this->num_samples = static_cast<double>(
-        header.Subchunk2Size) / static_cast<double>(
-        (header.NumOfChan) * bytes_per_sample);
     this->format_prefix = "Unknown";
     if (this->format_mapping.find(
             header.AudioFormat) != this->format_mapping.end()) {
         this->format_prefix = this->format_mapping[header.AudioFormat];
     }
-    this->duration = this->num_samples / static_cast<double>(
-        this->header.SamplesPerSec);
-    return wavFile;
+    this->duration = static_cast<double>(this->num_samples) /
+        static_cast<double>(this->header.SamplesPerSec);
 }
 
-void AudioSlicer::read_audio() {
-    if (this->codecs.find(this->header.AudioFormat) == this->codecs.end()) {
+void AudioSlicer::check_codec() {
+    if (this->output_bits > 0 && this->pcm_type == SAMPLE_NONE) {
+        cout << "Unsupported output depth: " << this->output_bits;
+        cout << " bits" << endl;
+        exit(1);
+    }
+    if (this->decoder == nullptr || this->deinterleave == nullptr) {
         cout << "Unsupported format ";
         cout << this->format_mapping[header.AudioFormat] << endl;
         exit(1);
     }
+    if (this->is_encoded() && this->pcm_type != SAMPLE_S16) {
+        cout << "G.711 output requires 16 bit samples" << endl;
+        exit(1);
+    }
+}
 
-    // Load required codec and call it (class method pointer)
-    f_ptr codec = this->codecs[header.AudioFormat];
-    (this->*codec)();
+static void append(vector<char>* head, const void *data, size_t size) {
+    const char *bytes = reinterpret_cast<const char*>(data);
+    head->insert(head->end(), bytes, bytes + size);
 }
 
-void AudioSlicer::extract_audio(const chunk& slice) {
-    // Do not forget bitsPerSample
-    // we need to write bps/8 bytes per sample
-    int byte_per_sec = this->header.bitsPerSample / 8;
-    int start = slice.sec_start * this->header.SamplesPerSec* byte_per_sec;
-    int end = slice.sec_end * this->header.SamplesPerSec* byte_per_sec;
-    int total_bytes = (end-start) * this->channels.size();
+static void append32(vector<char>* head, uint32_t value) {
+    append(head, &value, sizeof(value));
+}
 
-    char * data = reinterpret_cast<char*>(malloc(total_bytes));
-    int p = 0;
+static int64_t write_at(int fd, int64_t pos, const char *buf,
+        int64_t size) {
+    // Positioned writes: workers never share a file offset
+    STATS_SCOPE(STAGE_WRITE);
+    STATS_COUNT(STAGE_WRITE, size, 0);
+    int64_t done = 0;
+    while (done < size) {
+        ssize_t was_wr = pwrite(fd, buf + done, size - done, pos + done);
+        if (was_wr <= 0) {
+            break;
+        }
+        done += was_wr;
+    }
+    return done;
+}
 
-    // wav format
-    // [1b 1b] <- sample 1 ch 1, [1b 1b] sample 1 ch 2, ...
-    // l11 l12 r11 r12 l21 l22 r21 r22
-    int ptr = 0;
-    while (p <= total_bytes) {
-        for (int i=0; i < this->channels.size(); i++) {
-            for (int b=0; b < byte_per_sec; b++) {
-                data[p++] = channels[i][start+ptr+b];
-            }
+static int open_output(const string& fname) {
+    int fd = open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        cout << "Unable to write wave file: " << fname << endl;
+    }
+    assert(fd >= 0);
+    return fd;
+}
+
+int64_t AudioSlicer::write_header(int fd, int channels, int64_t frames) {
+    // Returns the header size (position of the first sample)
+    // G.711: one byte per sample. Formats other than LPCM get the fmt
+    // extension and a fact section.
+    bool has_fact = this->output_format != CT_LPCM;
+    int bytes_per_sample = this->output_format == CT_MS_MLAW ||
+        this->output_format == CT_MS_ALAW ? 1 : this->pcm_bytes;
+    int64_t data_size = frames * channels * bytes_per_sample;
+
+    fmt_chunk fmt = fmt_chunk{};
+    fmt.AudioFormat = this->output_format;
+    fmt.NumOfChan = channels;
+    fmt.SamplesPerSec = this->out_rate();
+    fmt.blockAlign = channels * bytes_per_sample;
+    fmt.bytesPerSec = fmt.SamplesPerSec * fmt.blockAlign;
+    fmt.bitsPerSample = bytes_per_sample * 8;
+    fmt.cbSize = 0;
+    uint32_t fmt_size = has_fact ? 18 : 16;
+
+    // Switch to RF64 when the sizes don't fit the classic header
+    int64_t riff_size = 4 + 8 + fmt_size + (has_fact ? 12 : 0) +
+        8 + data_size;
+    bool is_rf64 = riff_size > RIFF_MAX_SIZE;
+
+    vector<char> head;
+    append(&head, is_rf64 ? "RF64" : "RIFF", 4);
+    append32(&head, is_rf64 ? RIFF_MAX_SIZE : riff_size);
+    append(&head, "WAVE", 4);
+    if (is_rf64) {
+        ds64_chunk ds64 = ds64_chunk{};
+        ds64.riffSize = riff_size + 8 + sizeof(ds64);
+        ds64.dataSize = data_size;
+        ds64.sampleCount = frames;
+        append(&head, "ds64", 4);
+        append32(&head, sizeof(ds64));
+        append(&head, &ds64, sizeof(ds64));
+    }
+    append(&head, "fmt ", 4);
+    append32(&head, fmt_size);
+    append(&head, &fmt, fmt_size);
+    if (has_fact) {
+        append(&head, "fact", 4);
+        append32(&head, 4);
+        append32(&head, min(frames, RIFF_MAX_SIZE));
+    }
+    append(&head, "data", 4);
+    append32(&head, is_rf64 ? RIFF_MAX_SIZE : data_size);
+    return write_at(fd, 0, head.data(), head.size());
+}
+
+int64_t AudioSlicer::write_samples(int fd, int64_t pos, const char *buf,
+        int64_t samples, stream_buffers* stream) {
+    // Returns the number of bytes written at pos
+    int bytes = this->is_encoded() ? 1 : this->pcm_bytes;
+    return write_at(fd, pos, this->encode_samples(buf, samples, stream),
+        samples * bytes);
+}
+
+int64_t AudioSlicer::write_resampled(int fd, int64_t pos,
+        Resampler* resampler, int64_t offset, int64_t frames, bool last,
+        stream_buffers* stream) {
+    // Frames [offset, offset + frames) of the channel buffers at the
+    // output rate, returns the number of bytes written at pos
+    int channels = this->out_channels();
+    vector<const char*> in(channels);
+    for (int i=0; i < channels; i++) {
+        in[i] = stream->channels[i] + offset * this->pcm_bytes;
+    }
+    int64_t out = 0;
+    {
+        STATS_SCOPE(STAGE_RESAMPLE);
+        STATS_COUNT(STAGE_RESAMPLE, 0, frames * channels);
+        out = resampler->process(in.data(), frames, last,
+            stream->resampled.data());
+    }
+    {
+        STATS_SCOPE(STAGE_INTERLEAVE);
+        STATS_COUNT(STAGE_INTERLEAVE, 0, out * channels);
+        this->interleave(stream->resampled.data(), out, channels,
+            stream->interleaved.data());
+    }
+    return this->write_samples(fd, pos, stream->interleaved.data(),
+        out * channels, stream);
+}
+
+const char* AudioSlicer::encode_samples(const char *buf, int64_t samples,
+        stream_buffers* stream) {
+    // Decoded samples in the output encoding
+    if (!this->is_encoded()) {
+        return buf;
+    }
+
+    g711_law law = this->output_format == CT_MS_MLAW ?
+        G711_ULAW : G711_ALAW;
+    assert(stream->encoded.Capacity() >= samples);
+    STATS_SCOPE(STAGE_ENCODE);
+    STATS_COUNT(STAGE_ENCODE, samples, samples);
+    g711_encode(law, reinterpret_cast<const int16_t*>(buf), samples,
+        stream->encoded.data());
+    return stream->encoded.data();
+}
+
+int64_t AudioSlicer::read_audio(int64_t first, int64_t frames,
+        int64_t last, stream_buffers* stream) {
+    // Decode frames [first, first + frames) into the channel buffers.
+    // Only the codec blocks covering the range are read, reading ahead
+    // stops at frame `last` (end of the current slice).
+    frames = min(frames, this->NumSamples() - first);
+    if (frames <= 0) {
+        return 0;
+    }
+    int64_t first_block = first / this->codec_block_frames;
+    int64_t skip = first - first_block * this->codec_block_frames;
+    int64_t blocks = (skip + frames + this->codec_block_frames - 1) /
+        this->codec_block_frames;
+    int64_t offset = this->data_offset +
+        first_block * this->codec_block_bytes;
+    // Truncated files end before the data section does
+    blocks = this->source.available(offset,
+        blocks * this->codec_block_bytes) / this->codec_block_bytes;
+    frames = min(frames, blocks * this->codec_block_frames - skip);
+    if (frames <= 0) {
+        return 0;
+    }
+    int64_t size = blocks * this->codec_block_bytes;
+
+    // Let the kernel read the next block ahead while this one is decoded
+    int64_t ahead = (last - first - frames) *
+        this->codec_block_bytes / this->codec_block_frames;
+    this->source.advise(offset + size, min(size, ahead),
+        DataSource::WILLNEED);
+    const char *buf = nullptr;
+    {
+        STATS_SCOPE(STAGE_READ);
+        STATS_COUNT(STAGE_READ, size, 0);
+        buf = this->source.fetch(offset, size, &stream->scratch);
+    }
+
+    bool is_lpcm = this->decoder == &AudioSlicer::lpcm_decoder;
+    {
+        // Call the decoder (class method pointer)
+        STATS_SCOPE(is_lpcm ? STAGE_LOAD_CHANNELS : STAGE_DECODE);
+        STATS_COUNT(is_lpcm ? STAGE_LOAD_CHANNELS : STAGE_DECODE, size,
+            blocks * this->codec_block_frames * this->header.NumOfChan);
+        (this->*decoder)(buf, blocks * this->codec_block_frames,
+            stream->channels.data());
+    }
+    if (this->convert != nullptr && !is_lpcm) {
+        // 16 bit samples of coded formats to the output type
+        STATS_SCOPE(STAGE_CONVERT);
+        for (int i=0; i < this->header.NumOfChan; i++) {
+            convert_in_place(this->convert, this->decoded_type,
+                this->pcm_type, stream->channels[i],
+                blocks * this->codec_block_frames, this->dither);
+        }
+    }
+    if (this->is_mixed() && !is_lpcm) {
+        STATS_SCOPE(STAGE_CONVERT);
+        mix_in_place(this->mix, this->pcm_type, stream->channels.data(),
+            blocks * this->codec_block_frames, this->dither);
+    }
+    if (skip > 0) {
+        // Range starts inside a codec block
+        for (int i=0; i < this->out_channels(); i++) {
+            memmove(stream->channels[i],
+                stream->channels[i] + skip * this->pcm_bytes,
+                frames * this->pcm_bytes);
         }
-        ptr+=byte_per_sec;
     }
 
-    wav_header new_header = this->header;
-    new_header.Subchunk2Size = total_bytes;
+    // Drop decoded pages from the mapping to keep resident memory flat
+    this->source.advise(offset, size, DataSource::DONTNEED);
+    return frames;
+}
 
-    FILE* wavFile = fopen(slice.filename.c_str(), "wb");
-    if (wavFile == nullptr) {
-        cout << "Unable to read wave file: " << this->filename << endl;
+bool AudioSlicer::copy_audio(int fd, int64_t pos, int64_t start,
+        int64_t end) {
+    // Source frames go to the output as they are, without user space
+    // buffers. Returns false unless the whole range was copied, the
+    // caller then writes the range again from its start.
+    if (end <= start) {
+        return true;
+    }
+    int64_t frame_bytes = this->header.NumOfChan *
+        (this->header.bitsPerSample / 8);
+    int64_t size = (end - start) * frame_bytes;
+    STATS_SCOPE(STAGE_COPY);
+    STATS_COUNT(STAGE_COPY, size, (end - start) * this->header.NumOfChan);
+    int64_t done = this->source.copy_to(fd, pos,
+        this->data_offset + start * frame_bytes, size);
+    return done == size;
+}
+
+string AudioSlicer::extract_audio(const chunk& slice,
+        stream_buffers* stream) {
+    // Writes one slice, returns the log line for verbose mode
+    int channels = this->out_channels();
+    int64_t start = this->frame_at(slice.sec_start);
+    int64_t end = min(this->frame_at(slice.sec_end), this->NumSamples());
+
+    int fd = open_output(slice.filename);
+    int64_t frames_out = max(end - start, int64_t(0));
+    unique_ptr<Resampler> resampler;
+    if (this->is_resampled()) {
+        resampler = make_unique<Resampler>(this->header.SamplesPerSec,
+            this->output_rate, channels, this->pcm_type, this->dither);
+        frames_out = resampled_frames(this->header.SamplesPerSec,
+            this->output_rate, frames_out);
     }
-    assert(wavFile != nullptr);
-    fwrite(&new_header, 1, sizeof(new_header), wavFile);
-    fwrite(data, 1, total_bytes, wavFile);
-    fclose(wavFile);
+    int64_t pos = this->write_header(fd, channels, frames_out);
 
-    free(data);
-    if (this->is_verbose) {
-        cout << "Extracted interval [" << slice.sec_start << ":";
-        cout << slice.sec_end << "] into '" << slice.filename << "'" << endl;
+    ostringstream interval;
+    interval << "interval [" << slice.sec_start << ":";
+    interval << slice.sec_end << "] into '" << slice.filename << "'";
+    // A short copy falls through to the buffered path below, which
+    // writes the whole range again
+    if (this->is_copy() && this->copy_audio(fd, pos, start, end)) {
+        close(fd);
+        return "Copied " + interval.str();
+    }
+
+    // wav format
+    // [1b 1b] <- sample 1 ch 1, [1b 1b] sample 1 ch 2, ...
+    // l11 l12 r11 r12 l21 l22 r21 r22
+    for (int64_t first = start; first < end; first += this->block_frames) {
+        int64_t frames = this->read_audio(
+            first, min(this->block_frames, end - first), end, stream);
+        if (frames == 0) {
+            break;
+        }
+        if (resampler) {
+            pos += this->write_resampled(fd, pos, resampler.get(), 0,
+                frames, first + frames >= end, stream);
+            continue;
+        }
+        {
+            STATS_SCOPE(STAGE_INTERLEAVE);
+            STATS_COUNT(STAGE_INTERLEAVE, 0, frames * channels);
+            this->interleave(stream->channels.data(), frames, channels,
+                stream->interleaved.data());
+        }
+        pos += this->write_samples(fd, pos, stream->interleaved.data(),
+            frames * channels, stream);
     }
+    close(fd);
+    return "Extracted " + interval.str();
 }
 
 void AudioSlicer::split_channels(const string& out_prefix) {
-    this->read_audio();
-    int byte_per_sec = this->header.bitsPerSample / 8;
-    for (int i=0; i < this->channels.size(); i++) {
-        wav_header new_header = this->header;
-        new_header.Subchunk2Size = this->num_samples * byte_per_sec;
-        new_header.NumOfChan = 1;
+    this->check_codec();
+    // Double buffering: one set is decoded while the other is written
+    stream_buffers streams[2] = {stream_buffers{}, stream_buffers{}};
+    this->alloc_channels(&streams[0],
+        max(this->block_frames, this->codec_block_frames));
+    this->alloc_channels(&streams[1],
+        max(this->block_frames, this->codec_block_frames));
 
+    int64_t frames_out = this->NumSamples();
+    unique_ptr<Resampler> resampler;
+    if (this->is_resampled()) {
+        // All channels share the filter state
+        resampler = make_unique<Resampler>(this->header.SamplesPerSec,
+            this->output_rate, this->out_channels(), this->pcm_type,
+            this->dither);
+        frames_out = resampled_frames(this->header.SamplesPerSec,
+            this->output_rate, frames_out);
+    }
+    vector<int> outputs = vector<int>();
+    vector<int64_t> positions = vector<int64_t>();
+    for (int i=0; i < this->out_channels(); i++) {
         string fname = out_prefix + std::to_string(i) + ".wav";
-        FILE* wavFile = fopen(fname.c_str(), "wb");
-        if (wavFile == nullptr) {
-            cout << "Unable to read wave file: " << this->filename << endl;
+        int fd = open_output(fname);
+        positions.push_back(this->write_header(fd, 1, frames_out));
+        outputs.push_back(fd);
+    }
+
+    // Stream the input block by block into all outputs at once.
+    // The source is read once, the deinterleave kernel scatters every
+    // block into the channel buffers, and the flush of block k runs on
+    // a background thread while block k + 1 is decoded.
+    this->source.advise(this->data_offset, this->wave.data_size,
+        DataSource::SEQUENTIAL);
+    future<void> flush;
+    int64_t out_bytes = this->is_encoded() ? 1 : this->pcm_bytes;
+    // Steps of whole codec blocks, nothing is decoded twice
+    int64_t step = max(this->codec_block_frames, this->block_frames /
+        this->codec_block_frames * this->codec_block_frames);
+    int64_t block = 0;
+    for (int64_t pos = 0; pos < this->NumSamples(); pos += step, block++) {
+        stream_buffers* stream = &streams[block % 2];
+        int64_t frames = this->read_audio(pos, step, this->NumSamples(),
+            stream);
+        if (flush.valid()) {
+            flush.get();
+        }
+        if (frames == 0) {
+            break;
         }
-        assert(wavFile != nullptr);
+        vector<char*>* out = &stream->channels;
+        if (resampler) {
+            STATS_SCOPE(STAGE_RESAMPLE);
+            STATS_COUNT(STAGE_RESAMPLE, 0, frames * this->out_channels());
+            frames = resampler->process(stream->channels.data(), frames,
+                pos + step >= this->NumSamples(), stream->resampled.data());
+            out = &stream->resampled;
+        }
+        flush = async(launch::async, [this, stream, out, frames, &outputs,
+                offsets = positions]() {
+            for (int i=0; i < outputs.size(); i++) {
+                this->write_samples(outputs[i], offsets[i], (*out)[i],
+                    frames, stream);
+            }
+        });
+        for (int i=0; i < outputs.size(); i++) {
+            positions[i] += frames * out_bytes;
+        }
+    }
+    if (flush.valid()) {
+        flush.get();
+    }
 
-        fwrite(&new_header, 1, sizeof(new_header), wavFile);
-        fwrite(this->channels[i], 1, this->num_samples * byte_per_sec, wavFile);
-        fclose(wavFile);
+    for (int i=0; i < outputs.size(); i++) {
+        close(outputs[i]);
         if (this->is_verbose) {
             cout << "Extracted channel " << i << " into '";
             cout << out_prefix << i << ".wav'" << endl;
@@ -377,10 +906,446 @@ void AudioSlicer::split_channels(const string& out_prefix) {
 }
 
 void AudioSlicer::slice(const vector<chunk>& chunks) {
-    this->read_audio();
+    this->check_codec();
+    for (int i=0; i < chunks.size(); i++) {
+        assert(chunks[i].sec_start >= 0);
+        assert(chunks[i].sec_end <= this->duration + 1);
+    }
+
+    // Slices are independent files: one task per slice, buffers are
+    // allocated once per worker and reused for all of its slices
+    WorkerPool pool(static_cast<int>(min(int64_t(this->jobs),
+        int64_t(max(chunks.size(), size_t(1))))));
+    vector<stream_buffers> streams(pool.Jobs());
+    // Short slices don't need full size blocks
+    int64_t longest = 0;
     for (int i=0; i < chunks.size(); i++) {
+        longest = max(longest, this->frame_at(chunks[i].sec_end) -
+            this->frame_at(chunks[i].sec_start));
+    }
+    int64_t frames = min(this->block_frames, max(longest, int64_t(1)));
+    for (int i=0; i < streams.size(); i++) {
+        this->alloc_channels(&streams[i], frames);
+    }
+    vector<string> messages(chunks.size());
+    // Slices already keep all workers busy
+    this->decode_jobs = pool.Jobs() > 1 ? 1 : this->jobs;
+    pool.run(chunks.size(), [&](int64_t task, int worker) {
+        messages[task] = this->extract_audio(chunks[task], &streams[worker]);
+    });
+    this->decode_jobs = this->jobs;
+
+    // Log in input order, whatever order the workers finished in
+    if (this->is_verbose) {
+        for (int i=0; i < messages.size(); i++) {
+            cout << messages[i] << endl;
+        }
+    }
+}
+
+void AudioSlicer::slice_segments(const vector<chunk>& chunks) {
+    this->check_codec();
+    int channels = this->out_channels();
+    int64_t count = chunks.size();
+    vector<int64_t> starts(count), ends(count), positions(count, 0);
+    // Segments filter their own frames when resampling
+    bool is_resampled = this->is_resampled();
+    vector<unique_ptr<Resampler>> resamplers(count);
+    for (int64_t i=0; i < count; i++) {
         assert(chunks[i].sec_start >= 0);
-        assert(chunks[i].sec_end <= static_cast<int>(this->duration) + 1);
-        this->extract_audio(chunks[i]);
+        starts[i] = min(this->frame_at(chunks[i].sec_start),
+            this->NumSamples());
+        ends[i] = max(min(this->frame_at(chunks[i].sec_end),
+            this->NumSamples()), int64_t(0));
+    }
+    // Sweep order: by start, then by end
+    vector<int64_t> order(count);
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&](int64_t a, int64_t b) {
+        return starts[a] < starts[b] ||
+            (starts[a] == starts[b] && ends[a] < ends[b]);
+    });
+
+    // At most MAX_OPEN_OUTPUTS descriptors, the oldest one is closed
+    // first and reopened on its next write
+    vector<int> fds(count, -1);
+    list<int64_t> opened;
+    vector<list<int64_t>::iterator> where(count);
+    auto release = [&](int64_t i) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+            fds[i] = -1;
+            opened.erase(where[i]);
+        }
+    };
+    auto acquire = [&](int64_t i) {
+        if (fds[i] < 0) {
+            if (opened.size() >= MAX_OPEN_OUTPUTS) {
+                release(opened.front());
+            }
+            if (positions[i] == 0) {
+                int64_t frames = max(ends[i] - starts[i], int64_t(0));
+                if (is_resampled) {
+                    frames = resampled_frames(this->header.SamplesPerSec,
+                        this->output_rate, frames);
+                }
+                fds[i] = open_output(chunks[i].filename);
+                positions[i] = this->write_header(fds[i], channels, frames);
+            } else {
+                fds[i] = open(chunks[i].filename.c_str(), O_WRONLY);
+                assert(fds[i] >= 0);
+            }
+            where[i] = opened.insert(opened.end(), i);
+        }
+        return fds[i];
+    };
+
+    // Bytes of one output frame: source frames are copied as they are,
+    // otherwise decoded and encoded once per block for all segments
+    bool is_copy = this->is_copy();
+    int64_t frame_bytes = is_copy ? this->codec_block_bytes :
+        channels * (this->is_encoded() ? 1 : this->pcm_bytes);
+    stream_buffers stream = stream_buffers{};
+    this->alloc_channels(&stream, this->block_frames);
+
+    vector<int64_t> active;
+    int64_t next = 0;
+    int64_t pos = 0;
+    while (next < count || !active.empty()) {
+        if (active.empty()) {
+            // Gaps between segments are not read at all
+            pos = max(pos, starts[order[next]]);
+        }
+        int64_t block_end = min(pos + this->block_frames, this->NumSamples());
+        // Empty segments are taken as soon as they come up, the ones at
+        // the end of the input never start before block_end
+        while (next < count && (starts[order[next]] < block_end ||
+                ends[order[next]] <= starts[order[next]])) {
+            int64_t i = order[next++];
+            if (ends[i] <= max(starts[i], pos)) {
+                // Empty or already passed: header only
+                acquire(i);
+                release(i);
+                continue;
+            }
+            active.push_back(i);
+        }
+        int64_t last = pos;
+        for (int64_t i : active) {
+            last = max(last, ends[i]);
+        }
+        block_end = min(block_end, last);
+
+        int64_t frames = 0;
+        const char *out = nullptr;
+        if (block_end > pos && is_copy) {
+            int64_t offset = this->data_offset + pos * frame_bytes;
+            frames = this->source.available(offset,
+                (block_end - pos) * frame_bytes) / frame_bytes;
+            this->source.advise(offset + frames * frame_bytes,
+                min(block_end - pos, last - pos - frames) * frame_bytes,
+                DataSource::WILLNEED);
+            STATS_SCOPE(STAGE_READ);
+            STATS_COUNT(STAGE_READ, frames * frame_bytes, 0);
+            out = this->source.fetch(offset, frames * frame_bytes,
+                &stream.scratch);
+        } else if (block_end > pos) {
+            frames = this->read_audio(pos, block_end - pos, last, &stream);
+        }
+        if (frames > 0 && !is_copy && !is_resampled) {
+            {
+                STATS_SCOPE(STAGE_INTERLEAVE);
+                STATS_COUNT(STAGE_INTERLEAVE, 0, frames * channels);
+                this->interleave(stream.channels.data(), frames, channels,
+                    stream.interleaved.data());
+            }
+            out = this->encode_samples(stream.interleaved.data(),
+                frames * channels, &stream);
+        }
+
+        vector<int64_t> still_active;
+        for (int64_t i : active) {
+            int64_t lo = max(starts[i], pos);
+            int64_t hi = min(ends[i], pos + frames);
+            if (hi > lo && is_resampled) {
+                int fd = acquire(i);
+                if (!resamplers[i]) {
+                    resamplers[i] = make_unique<Resampler>(
+                        this->header.SamplesPerSec, this->output_rate,
+                        channels, this->pcm_type, this->dither);
+                }
+                positions[i] += this->write_resampled(fd, positions[i],
+                    resamplers[i].get(), lo - pos, hi - lo, hi == ends[i],
+                    &stream);
+            } else if (hi > lo) {
+                int fd = acquire(i);
+                positions[i] += write_at(fd, positions[i],
+                    out + (lo - pos) * frame_bytes, (hi - lo) * frame_bytes);
+            }
+            if (ends[i] <= pos + frames || frames == 0) {
+                release(i);
+                resamplers[i].reset();
+            } else {
+                still_active.push_back(i);
+            }
+        }
+        if (is_copy && frames > 0) {
+            this->source.advise(this->data_offset + pos * frame_bytes,
+                frames * frame_bytes, DataSource::DONTNEED);
+        }
+        active.swap(still_active);
+        if (frames == 0 && next >= count) {
+            // Truncated input
+            break;
+        }
+        pos += frames;
+    }
+
+    if (this->is_verbose) {
+        for (int64_t i=0; i < count; i++) {
+            cout << "Extracted interval [" << chunks[i].sec_start << ":";
+            cout << chunks[i].sec_end << "] into '" << chunks[i].filename;
+            cout << "'" << endl;
+        }
+    }
+}
+
+int64_t AudioSlicer::float_range(int64_t unit) {
+    return max(unit, this->block_frames / unit * unit);
+}
+
+void AudioSlicer::scan_float(int64_t range, int64_t overlap,
+        const float_fn& fn) {
+    // Source channels as they are
+    int16_t format = this->output_format;
+    int bits = this->output_bits;
+    mix_matrix mix = this->mix;
+    this->output_format = CT_IEEEFP;
+    this->output_bits = 32;
+    this->mix = mix_matrix{};
+    this->setup_stream();
+    this->check_codec();
+
+    int64_t tasks = (this->NumSamples() + range - 1) / range;
+    WorkerPool pool(static_cast<int>(min(int64_t(this->jobs),
+        max(tasks, int64_t(1)))));
+    vector<stream_buffers> streams(pool.Jobs());
+    for (int i=0; i < streams.size(); i++) {
+        this->alloc_channels(&streams[i], range + overlap);
+    }
+    this->decode_jobs = pool.Jobs() > 1 ? 1 : this->jobs;
+    pool.run(tasks, [&](int64_t task, int worker) {
+        stream_buffers* stream = &streams[worker];
+        int64_t first = task * range;
+        int64_t frames = this->read_audio(first, range + overlap,
+            first + range + overlap, stream);
+        fn(task, first, frames, stream->channels.data());
+    });
+    this->decode_jobs = this->jobs;
+
+    this->output_format = format;
+    this->output_bits = bits;
+    this->mix = mix;
+    this->setup_stream();
+}
+
+vector<channel_stats> AudioSlicer::analyze(double window_sec,
+        double silence_db) {
+    int channels = this->header.NumOfChan;
+    signal_params params = signal_params{};
+    params.window = max(this->frame_at(window_sec), int64_t(1));
+    params.silence_level = pow(10.0, silence_db / 20);
+    params.clip_level = 1.0f;
+    if (!is_float_sample(this->decoded_type)) {
+        // Largest positive sample of the source depth
+        double top = pow(2.0, sample_bytes(this->decoded_type) * 8 - 1);
+        params.clip_level = static_cast<float>((top - 1) / top);
+    }
+
+    // Ranges of whole windows, analyzed in parallel and merged in order
+    int64_t range = this->float_range(params.window);
+    int64_t tasks = (this->NumSamples() + range - 1) / range;
+    vector<signal_sums> sums(tasks * channels, signal_sums{});
+    this->scan_float(range, 0, [&](int64_t task, int64_t first,
+            int64_t frames, char * const *buffers) {
+        for (int ch=0; ch < channels; ch++) {
+            accumulate_signal(reinterpret_cast<const float*>(buffers[ch]),
+                frames, params, &sums[task * channels + ch]);
+        }
+    });
+
+    vector<channel_stats> stats;
+    for (int ch=0; ch < channels; ch++) {
+        signal_sums total = signal_sums{};
+        for (int64_t task=0; task < tasks; task++) {
+            merge_signal(&total, sums[task * channels + ch]);
+        }
+        stats.push_back(finish_signal(total));
+    }
+    return stats;
+}
+
+vector<chunk> AudioSlicer::detect_speech(const vad_params& params,
+        const string& prefix) {
+    int channels = this->header.NumOfChan;
+    if (params.channel >= channels) {
+        cout << "No channel " << params.channel << " in " << this->filename;
+        cout << endl;
+        exit(1);
+    }
+    int lo = params.channel < 0 ? 0 : params.channel;
+    int hi = params.channel < 0 ? channels : params.channel + 1;
+
+    // Frame features in parallel, every range fills its own frames
+    int64_t frame = max(this->frame_at(params.frame_sec), int64_t(1));
+    int64_t frames = (this->NumSamples() + frame - 1) / frame;
+    vector<float> energy(frames), zcr(frames);
+    this->scan_float(this->float_range(frame), 0, [&](int64_t task,
+            int64_t first, int64_t count, char * const *buffers) {
+        int64_t at = first / frame;
+        int64_t n = (count + frame - 1) / frame;
+        vector<float> ch_energy(n), ch_zcr(n);
+        for (int ch=lo; ch < hi; ch++) {
+            frame_features(reinterpret_cast<const float*>(buffers[ch]),
+                count, frame, ch_energy.data(), ch_zcr.data());
+            // Loudest channel of the frame
+            for (int64_t i=0; i < n; i++) {
+                if (ch == lo || ch_energy[i] > energy[at + i]) {
+                    energy[at + i] = ch_energy[i];
+                    zcr[at + i] = ch_zcr[i];
+                }
+            }
+        }
+    });
+
+    // Decisions need the frames before: one sequential pass
+    vad_params frame_params = params;
+    frame_params.frame_sec = static_cast<double>(frame) / this->SampleRate();
+    vector<pair<int64_t, int64_t>> found = detect_voice(energy.data(),
+        zcr.data(), frames, frame_params);
+
+    vector<chunk> segments;
+    for (const pair<int64_t, int64_t>& f : found) {
+        double start = max(f.first * frame_params.frame_sec - params.pad_sec,
+            0.0);
+        double end = min(f.second * frame_params.frame_sec + params.pad_sec,
+            this->duration);
+        if (!segments.empty() && start <= segments.back().sec_end) {
+            segments.back().sec_end = end;
+            continue;
+        }
+        segments.push_back(chunk{start, end, ""});
+    }
+    for (int i=0; i < segments.size(); i++) {
+        segments[i].filename = prefix + to_string(i) + ".wav";
+    }
+    return segments;
+}
+
+int64_t AudioSlicer::features(const feature_params& params,
+        const string& out_file) {
+    string error;
+    FeatureExtractor extractor(params, this->SampleRate(), &error);
+    if (!extractor.valid()) {
+        cout << "Bad feature parameters: " << error << endl;
+        exit(1);
+    }
+    int channels = this->header.NumOfChan;
+    if (params.channel >= channels) {
+        cout << "No channel " << params.channel << " in " << this->filename;
+        cout << endl;
+        exit(1);
+    }
+    int lo = params.channel < 0 ? 0 : params.channel;
+    int hi = params.channel < 0 ? channels : params.channel + 1;
+
+    int64_t hop = extractor.Hop();
+    int64_t frames = feature_frames(this->NumSamples(), extractor.Frame(),
+        hop);
+    vector<int64_t> shape = {frames, extractor.Bins()};
+    if (hi - lo > 1) {
+        shape.insert(shape.begin(), hi - lo);
+    }
+    string head = npy_header(shape);
+    int fd = open_output(out_file);
+    write_at(fd, 0, head.data(), head.size());
+
+    // Ranges of whole hops run in parallel, frames starting in a range
+    // read its overlap; every range writes its own rows
+    int64_t row = extractor.Bins() * sizeof(float);
+    int64_t range = this->float_range(hop);
+    int64_t overlap = max(extractor.Frame() - hop, int64_t(0));
+    this->scan_float(range, overlap, [&](int64_t task, int64_t first,
+            int64_t count, char * const *buffers) {
+        int64_t at = first / hop;
+        int64_t n = min(range / hop, frames - at);
+        if (n <= 0) {
+            return;
+        }
+        vector<float> values(n * extractor.Bins());
+        for (int ch=lo; ch < hi; ch++) {
+            extractor.compute(reinterpret_cast<const float*>(buffers[ch]),
+                n, values.data());
+            int64_t pos = head.size() + ((ch - lo) * frames + at) * row;
+            write_at(fd, pos, reinterpret_cast<const char*>(values.data()),
+                n * row);
+        }
+    });
+    close(fd);
+    return frames;
+}
+
+bool AudioSlicer::peak_index(const string& sidecar, bool rebuild,
+        PeakIndex* index) {
+    struct stat st;
+    if (stat(this->filename.c_str(), &st) != 0) {
+        cout << "Peaks need a regular input file: " << this->filename;
+        cout << endl;
+        exit(1);
+    }
+    int64_t mtime = st.st_mtim.tv_sec * int64_t(1000000000) +
+        st.st_mtim.tv_nsec;
+    if (!rebuild && index->open(sidecar, st.st_size, mtime)) {
+        return false;
+    }
+
+    int channels = this->header.NumOfChan;
+    int64_t frames = this->NumSamples();
+    vector<vector<peak_bin>> levels(PEAK_LEVELS);
+    for (int l=0; l < PEAK_LEVELS; l++) {
+        levels[l].resize(peak_bins(frames, l) * channels,
+            peak_bin{0, 0, 0});
+    }
+    // Ranges of whole top level bins in parallel, every range fills its
+    // own bins of all levels
+    int64_t top = PEAK_BIN_FRAMES[PEAK_LEVELS - 1];
+    this->scan_float(this->float_range(top), 0, [&](int64_t task,
+            int64_t first, int64_t count, char * const *buffers) {
+        for (int ch=0; ch < channels; ch++) {
+            peak_bin *bins = levels[0].data() + ch * peak_bins(frames, 0) +
+                first / PEAK_BIN_FRAMES[0];
+            accumulate_peaks(reinterpret_cast<const float*>(buffers[ch]),
+                count, PEAK_BIN_FRAMES[0], bins);
+            for (int l=1; l < PEAK_LEVELS; l++) {
+                peak_bin *next = levels[l].data() +
+                    ch * peak_bins(frames, l) + first / PEAK_BIN_FRAMES[l];
+                merge_peaks(bins, count, PEAK_BIN_FRAMES[l - 1],
+                    PEAK_BIN_FRAMES[l] / PEAK_BIN_FRAMES[l - 1], next);
+                bins = next;
+            }
+        }
+    });
+
+    peak_header head = peak_header{};
+    head.source_size = st.st_size;
+    head.source_mtime = mtime;
+    head.frames = frames;
+    head.sample_rate = this->SampleRate();
+    head.channels = channels;
+    if (!PeakIndex::write(sidecar, head, levels) ||
+            !index->open(sidecar, st.st_size, mtime)) {
+        cout << "Unable to write peaks index: " << sidecar << endl;
+        exit(1);
     }
+    return true;
 }
@@ -4,18 +4,33 @@
 #define SRC_SLICE_H_
 
 #include <stdint.h>
-#include <cstdio>
 
+#include <functional>
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 
 #include "./formats/wav.h"
-#include "./formats/ulaw.h"
+#include "./formats/riff.h"
+#include "./source.h"
+#include "./buffers.h"
+#include "./pool.h"
+#include "./kernels.h"
+#include "./adpcm.h"
+#include "./convert.h"
+#include "./analyze.h"
+#include "./spectrum.h"
+#include "./vad.h"
+#include "./resample.h"
+#include "./mix.h"
+#include "./peaks.h"
 
+// Slice boundaries in seconds, fractions are rounded to the nearest
+// sample (use sample / rate for sample positions)
 typedef struct {
-    int sec_start;
-    int sec_end;
+    double sec_start;
+    double sec_end;
         std::string filename;
 } chunk;
 
@@ -25,52 +40,220 @@ const int16_t CT_IEEEFP = 0x3;
 const int16_t CT_IBM_CVSD = 0x5;
 const int16_t CT_MS_ALAW = 0x6;
 const int16_t CT_MS_MLAW = 0x7;
+const int16_t CT_IMA_ADPCM = 0x11;
+const int16_t CT_EXTENSIBLE = static_cast<int16_t>(0xFFFE);
+
+// Default streaming block, in frames
+const int64_t DEFAULT_BLOCK_FRAMES = 1 << 16;
+
+// Output files kept open at once by slice_segments()
+const int MAX_OPEN_OUTPUTS = 256;
+
+// Buffers of one decoding stream, every worker thread has its own.
+// Sample buffers come from the shared BufferPool and go back to it
+// with the stream.
+typedef struct {
+    // Decoded samples of the current block, one buffer per channel
+    std::vector<char*> channels;
+    // The block at the output rate (when resampling)
+    std::vector<char*> resampled;
+    // Interleaved output frames of the current block
+    SampleBuffer interleaved;
+    // G.711 codes of the current block
+    SampleBuffer encoded;
+    // Raw data of the current block (when the input is not mapped)
+    std::vector<char> scratch;
+    // Memory of channels and resampled
+    std::vector<SampleBuffer> storage;
+} stream_buffers;
 
 
 class AudioSlicer{
  private:
         // Class method pointer type f_ptr
-        typedef void(AudioSlicer::*f_ptr)();
+        // Decodes frames from the raw data into the channel buffers
+        typedef void(AudioSlicer::*f_ptr)(const char *buf, int64_t frames,
+            char * const *channels);
         // dict(id, func_ptr)
         std::map<int16_t, f_ptr > codecs;
 
         static std::map<int16_t, std::string> format_mapping;
         bool is_verbose;
         wav_header header;
+        // Chunks and format details of the input file
+        wave_info wave;
+        // Sample type and bytes per sample of the decoded stream
+        sample_type pcm_type;
+        int pcm_bytes;
+        // Conversion from the samples the decoder produces to pcm_type
+        // (nullptr when they match) and its dither switch
+        sample_type decoded_type;
+        convert_fn convert;
+        bool dither;
         std::string filename;
         std::string format_prefix;
-        double num_samples;
-        std::vector<char*> channels;
+        // Input file, memory-mapped when possible
+        DataSource source;
+        // Position of the audio samples in the file
+        int64_t data_offset;
+        // Smallest decodable unit of the source: codec_block_bytes
+        // of data hold codec_block_frames frames (1 frame for PCM/G.711)
+        int64_t codec_block_bytes;
+        int64_t codec_block_frames;
+        // MS ADPCM predictor coefficients from the fmt extension
+        std::vector<ms_adpcm_coef> adpcm_coefs;
+        int64_t num_samples;
+        // Kernels for the decoded sample width and channel count
+        deinterleave_fn deinterleave;
+        interleave_fn interleave;
+        // Decoder of the source format (or a plain copy)
+        f_ptr decoder;
+        // Encoding of the written files and their sample depth
+        // (0: same as the source)
+        int16_t output_format;
+        int output_bits;
+        // Sample rate of the written files (0: same as the source)
+        int output_rate;
+        // Channels of the written files from the source channels
+        mix_matrix mix;
+        // Frames decoded per block
+        int64_t block_frames;
+        // Worker threads of slice() and of block decoders
+        int jobs;
+        // Threads a block decoder may use (1 inside slice() workers)
+        int decode_jobs;
+        // Threads of the block decoders, reused from block to block
+        std::unique_ptr<WorkerPool> block_pool;
         double duration;
 
-        void lpcm_decoder();
-        void mu_law_decoder();
-        void a_law_decoder();
-        void read_audio();
-        FILE* read_header();
-        FILE* read_ulaw_header();
+        void lpcm_decoder(const char *buf, int64_t frames,
+            char * const *channels);
+        void mu_law_decoder(const char *buf, int64_t frames,
+            char * const *channels);
+        void a_law_decoder(const char *buf, int64_t frames,
+            char * const *channels);
+        void ima_decoder(const char *buf, int64_t frames,
+            char * const *channels);
+        void ms_adpcm_decoder(const char *buf, int64_t frames,
+            char * const *channels);
+        // Block codec: decode `blocks` whole blocks into the channels
+        typedef std::function<void(const char *buf, int64_t blocks,
+            char * const *channels)> block_fn;
+        void decode_blocks(const char *buf, int64_t frames,
+            char * const *channels, const block_fn& decode);
+        void check_codec();
+        bool is_passthrough();
+        bool is_encoded();
+        bool is_copy();
+        bool is_resampled();
+        int out_rate();
+        bool is_mixed();
+        int out_channels();
+        int64_t frame_at(double sec);
+        bool copy_audio(int fd, int64_t pos, int64_t start, int64_t end);
+        void setup_stream();
+        void setup_ms_adpcm();
+        int64_t write_header(int fd, int channels, int64_t frames);
+        int64_t write_samples(int fd, int64_t pos, const char *buf,
+            int64_t samples, stream_buffers* stream);
+        int64_t write_resampled(int fd, int64_t pos, Resampler* resampler,
+            int64_t offset, int64_t frames, bool last,
+            stream_buffers* stream);
+        const char* encode_samples(const char *buf, int64_t samples,
+            stream_buffers* stream);
+        int64_t read_audio(int64_t first, int64_t frames, int64_t last,
+            stream_buffers* stream);
+        void read_header();
 
-        void load_channels(char *buf);
-        void extract_audio(const chunk& slice);
+        void alloc_channels(stream_buffers* stream, int64_t frames);
+        void load_channels(const char *buf, int64_t frames,
+            char * const *channels);
+        std::string extract_audio(const chunk& slice,
+            stream_buffers* stream);
+        // Whole input decoded to float samples (full scale is 1.0) in
+        // ranges of whole units, ranges run on the worker pool:
+        // fn(range index, first frame, frames, channel buffers).
+        // Every range also gets the `overlap` frames that follow it.
+        typedef std::function<void(int64_t task, int64_t first,
+            int64_t frames, char * const *channels)> float_fn;
+        int64_t float_range(int64_t unit);
+        void scan_float(int64_t range, int64_t overlap, const float_fn& fn);
         void init(const std::string& fname);
 
  public:
         explicit AudioSlicer(const std::string& fname);
         AudioSlicer(const std::string& fname, bool is_verbose);
+        // Owns the open input: moved, never copied
+        AudioSlicer(AudioSlicer&& other) = default;
+        AudioSlicer& operator=(AudioSlicer&& other) = default;
+        AudioSlicer(const AudioSlicer&) = delete;
+        AudioSlicer& operator=(const AudioSlicer&) = delete;
 
         inline int BytesPerSec() { return this->header.bytesPerSec; }
         inline int SampleRate() { return this->header.SamplesPerSec; }
-        inline int64_t NumSamples() { return int64_t(num_samples); }
-        inline int64_t Size() { return int64_t(this->header.Subchunk2Size); }
+        inline int64_t NumSamples() { return this->num_samples; }
+        inline int64_t Size() { return this->wave.data_size; }
         inline int BitsPerSample() {
             return int32_t(this->header.bitsPerSample); }
         inline double Duration() { return this->duration; }
         inline std::string Filename() { return this->filename; }
         inline int Channels() { return this->header.NumOfChan; }
+        inline const wave_info& Wave() { return this->wave; }
+
+        // Number of frames decoded and written at once
+        void set_block_size(int64_t frames);
+
+        // Number of slices extracted in parallel (>= 1)
+        void set_jobs(int jobs);
+
+        // Encoding of slice/split outputs: CT_LPCM (16 bit for G.711,
+        // ADPCM and float sources), CT_IEEEFP (32 bit float, 64 bit for
+        // 64 bit sources), CT_MS_MLAW or CT_MS_ALAW.
+        // Float sources are written as float by default.
+        void set_output_format(int16_t format);
+
+        // Sample depth of LPCM (8, 16, 24, 32) and float (32, 64)
+        // outputs, 0 keeps the depth of the source
+        void set_output_bits(int bits);
+
+        // TPDF dither when samples are rounded to a smaller depth
+        void set_dither(bool dither);
+
+        // Sample rate of slice/split outputs (polyphase FIR resampling),
+        // 0 keeps the rate of the source
+        void set_output_rate(int rate);
+
+        // Channels of slice/split outputs as a remix of the source
+        // channels, see parse_mix() ("0+1", "0,2", "mono"), an empty
+        // spec keeps all channels
+        void set_mix(const std::string& spec);
 
         const std::string audio_format();
         void slice(const std::vector<chunk>& chunks);
         void split_channels(const std::string& out_prefix);
+        // Bulk slicing: one sequential sweep over the source fills all
+        // outputs, overlapping segments share the decoded blocks
+        void slice_segments(const std::vector<chunk>& chunks);
+        // Per channel signal statistics of the whole input in one
+        // streaming pass, windows of window_sec below silence_db (dBFS)
+        // RMS are silent
+        std::vector<channel_stats> analyze(double window_sec,
+            double silence_db);
+        // Speech segments found by voice activity detection, written to
+        // <prefix><n>.wav by slice()
+        std::vector<chunk> detect_speech(const vad_params& params,
+            const std::string& prefix);
+        // Spectrogram or log-mel features written to a .npy file:
+        // float32 (frames, bins), (channels, frames, bins) for all
+        // channels of a multichannel input. Returns the frame count.
+        int64_t features(const feature_params& params,
+            const std::string& out_file);
+        // Open the min/max/RMS pyramid of every channel from the
+        // `sidecar` file when it matches the size and mtime of the
+        // input, otherwise build it in one streaming pass and save it
+        // there. Returns true when it was built.
+        bool peak_index(const std::string& sidecar, bool rebuild,
+            PeakIndex* index);
 };
 
 #endif  // SRC_SLICE_H_
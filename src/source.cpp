@@ -0,0 +1,230 @@
+// Copyright 2023 Andrei Drozdov
+
+#include "./source.h"  // NOLINT [build/include]
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;  // NOLINT [build/namespaces]
+
+DataSource::DataSource()
+    : state(CLOSED), fd(-1), map(nullptr), size(0) {}
+
+DataSource::~DataSource() {
+    this->close();
+}
+
+DataSource::DataSource(DataSource&& other) noexcept
+    : state(CLOSED), fd(-1), map(nullptr), size(0) {
+    *this = std::move(other);
+}
+
+DataSource& DataSource::operator=(DataSource&& other) noexcept {
+    if (this != &other) {
+        this->close();
+        this->state = other.state;
+        this->fd = other.fd;
+        this->map = other.map;
+        this->size = other.size;
+        this->spool = std::move(other.spool);
+        other.state = CLOSED;
+        other.fd = -1;
+        other.map = nullptr;
+        other.size = 0;
+    }
+    return *this;
+}
+
+bool DataSource::open(const string& fname) {
+    this->close();
+    this->fd = ::open(fname.c_str(), O_RDONLY);
+    if (this->fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(this->fd, &st) != 0) {
+        this->close();
+        return false;
+    }
+
+    if (!S_ISREG(st.st_mode)) {
+        // Pipe or character device: no seeking, read it once
+        this->spool_fd();
+        return true;
+    }
+
+    this->size = st.st_size;
+    this->state = PREAD;
+    if (this->size > 0) {
+        void *ptr = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE,
+            this->fd, 0);
+        if (ptr != MAP_FAILED) {
+            this->map = reinterpret_cast<char*>(ptr);
+            this->state = MAPPED;
+        }
+    }
+    return true;
+}
+
+void DataSource::spool_fd() {
+    this->spool = vector<char>();
+    char tmp[1 << 16];
+    ssize_t was_rd = 0;
+    while ((was_rd = ::read(this->fd, tmp, sizeof(tmp))) > 0) {
+        this->spool.insert(this->spool.end(), tmp, tmp + was_rd);
+    }
+    this->size = this->spool.size();
+    this->state = SPOOLED;
+}
+
+void DataSource::close() {
+    if (this->map != nullptr) {
+        munmap(this->map, this->size);
+        this->map = nullptr;
+    }
+    if (this->fd >= 0) {
+        ::close(this->fd);
+        this->fd = -1;
+    }
+    this->spool = vector<char>();
+    this->size = 0;
+    this->state = CLOSED;
+}
+
+int64_t DataSource::available(int64_t offset, int64_t size) const {
+    if (offset < 0 || offset >= this->size) {
+        return 0;
+    }
+    return min(size, this->size - offset);
+}
+
+const char* DataSource::fetch(int64_t offset, int64_t size,
+        vector<char>* scratch) {
+    size = this->available(offset, size);
+    switch (this->state) {
+        case MAPPED:
+            return this->map + offset;
+        case SPOOLED:
+            return this->spool.data() + offset;
+        case PREAD:
+            if (static_cast<int64_t>(scratch->size()) < size) {
+                scratch->resize(size);
+            }
+            this->read(offset, size, scratch->data());
+            return scratch->data();
+        default:
+            return nullptr;
+    }
+}
+
+int64_t DataSource::read(int64_t offset, int64_t size, char* dst) {
+    size = this->available(offset, size);
+    if (this->state == MAPPED || this->state == SPOOLED) {
+        const char *src = this->state == MAPPED ?
+            this->map : this->spool.data();
+        memcpy(dst, src + offset, size);
+        return size;
+    }
+
+    int64_t done = 0;
+    while (done < size) {
+        ssize_t was_rd = pread(this->fd, dst + done, size - done,
+            offset + done);
+        if (was_rd <= 0) {
+            break;
+        }
+        done += was_rd;
+    }
+    return done;
+}
+
+int64_t DataSource::copy_to(int out_fd, int64_t out_pos, int64_t offset,
+        int64_t size) {
+    size = this->available(offset, size);
+    int64_t done = 0;
+    if (this->state == MAPPED || this->state == PREAD) {
+        // copy_file_range keeps the bytes in the kernel (or lets the
+        // filesystem share extents), sendfile covers older kernels
+        // and cross-filesystem copies
+        bool use_sendfile = false;
+        while (done < size) {
+            loff_t src = offset + done;
+            loff_t dst = out_pos + done;
+            ssize_t was_cp = 0;
+            if (use_sendfile) {
+                // sendfile writes at the current file offset
+                lseek(out_fd, dst, SEEK_SET);
+                was_cp = sendfile(out_fd, this->fd, &src, size - done);
+            } else {
+                was_cp = copy_file_range(this->fd, &src, out_fd, &dst,
+                    size - done, 0);
+            }
+            if (was_cp < 0 && !use_sendfile) {
+                use_sendfile = true;
+                continue;
+            }
+            if (was_cp <= 0) {
+                break;
+            }
+            done += was_cp;
+        }
+        if (done == size) {
+            return done;
+        }
+    }
+
+    // Spooled input or no kernel copy: plain writes
+    vector<char> scratch;
+    while (done < size) {
+        int64_t part = min(size - done, int64_t(1) << 20);
+        const char *src = this->fetch(offset + done, part, &scratch);
+        ssize_t was_wr = pwrite(out_fd, src, part, out_pos + done);
+        if (was_wr <= 0) {
+            break;
+        }
+        done += was_wr;
+    }
+    return done;
+}
+
+void DataSource::advise(int64_t offset, int64_t size, Advice advice) {
+    size = this->available(offset, size);
+    if (size <= 0) {
+        return;
+    }
+
+    if (this->state == PREAD) {
+        // Page cache is not part of our resident set, keep it for others
+        if (advice == DONTNEED) {
+            return;
+        }
+        int hint = POSIX_FADV_NORMAL;
+        if (advice == SEQUENTIAL) hint = POSIX_FADV_SEQUENTIAL;
+        if (advice == WILLNEED) hint = POSIX_FADV_WILLNEED;
+        posix_fadvise(this->fd, offset, size, hint);
+        return;
+    }
+    if (this->state != MAPPED) {
+        return;
+    }
+
+    // madvise needs a page aligned start
+    int64_t page = sysconf(_SC_PAGESIZE);
+    int64_t start = offset - offset % page;
+    int hint = MADV_NORMAL;
+    if (advice == SEQUENTIAL) hint = MADV_SEQUENTIAL;
+    if (advice == WILLNEED) hint = MADV_WILLNEED;
+    if (advice == DONTNEED) hint = MADV_DONTNEED;
+    madvise(this->map + start, size + (offset - start), hint);
+}
@@ -0,0 +1,60 @@
+// Copyright 2023 Andrei Drozdov
+
+#ifndef SRC_SOURCE_H_
+#define SRC_SOURCE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// Read-only view of an input file.
+// Regular files are memory-mapped so decoders can read the data chunk
+// in place. Files that can't be mapped are read with pread(), and
+// non-seekable inputs (pipes, fifos) are spooled into memory once.
+class DataSource{
+ public:
+        enum Mode { CLOSED, MAPPED, PREAD, SPOOLED };
+        enum Advice { NORMAL, SEQUENTIAL, WILLNEED, DONTNEED };
+
+        DataSource();
+        ~DataSource();
+        DataSource(DataSource&& other) noexcept;
+        DataSource& operator=(DataSource&& other) noexcept;
+        DataSource(const DataSource&) = delete;
+        DataSource& operator=(const DataSource&) = delete;
+
+        bool open(const std::string& fname);
+        void close();
+
+        // Pointer to bytes [offset, offset + size).
+        // Mapped and spooled sources return a view without copying,
+        // otherwise the range is read into scratch.
+        // The range is clipped to the end of the file, see available().
+        const char* fetch(int64_t offset, int64_t size,
+            std::vector<char>* scratch);
+        // Copy bytes [offset, offset + size) into dst, returns bytes read
+        int64_t read(int64_t offset, int64_t size, char* dst);
+        // Number of bytes that can be read starting at offset (<= size)
+        int64_t available(int64_t offset, int64_t size) const;
+        // Copy bytes [offset, offset + size) to out_fd at out_pos,
+        // in the kernel when possible, returns bytes copied
+        int64_t copy_to(int out_fd, int64_t out_pos, int64_t offset,
+            int64_t size);
+        // Access pattern hint for the given range (no-op when not mapped)
+        void advise(int64_t offset, int64_t size, Advice advice);
+
+        inline Mode mode() const { return this->state; }
+        inline int64_t Size() const { return this->size; }
+
+ private:
+        Mode state;
+        int fd;
+        char *map;
+        int64_t size;
+        std::vector<char> spool;
+
+        void spool_fd();
+};
+
+#endif  // SRC_SOURCE_H_
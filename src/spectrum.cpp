@@ -0,0 +1,405 @@
+// Copyright 2023 Andrei Drozdov
+
+#include "./spectrum.h"  // NOLINT [build/include]
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+using namespace std;  // NOLINT [build/namespaces]
+
+namespace {
+
+// Frames transformed at once, one per lane
+const int FEATURE_LANES = 4;
+// Smallest value before the log
+const float LOG_FLOOR = 1e-10f;
+
+// Same operation on the samples of all lanes
+#ifdef __SSE2__
+
+typedef struct {
+    __m128 v;
+} lanes;
+
+inline lanes lanes_add(lanes a, lanes b) { return {_mm_add_ps(a.v, b.v)}; }
+inline lanes lanes_sub(lanes a, lanes b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline lanes lanes_mul(lanes a, lanes b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline lanes lanes_set(float v) { return {_mm_set1_ps(v)}; }
+inline lanes lanes_load(const float *v) { return {_mm_loadu_ps(v)}; }
+inline void lanes_store(lanes a, float *v) { _mm_storeu_ps(v, a.v); }
+
+#else
+
+typedef struct {
+    float v[FEATURE_LANES];
+} lanes;
+
+inline lanes lanes_add(lanes a, lanes b) {
+    for (int l = 0; l < FEATURE_LANES; l++) a.v[l] += b.v[l];
+    return a;
+}
+inline lanes lanes_sub(lanes a, lanes b) {
+    for (int l = 0; l < FEATURE_LANES; l++) a.v[l] -= b.v[l];
+    return a;
+}
+inline lanes lanes_mul(lanes a, lanes b) {
+    for (int l = 0; l < FEATURE_LANES; l++) a.v[l] *= b.v[l];
+    return a;
+}
+inline lanes lanes_set(float v) {
+    lanes a;
+    for (int l = 0; l < FEATURE_LANES; l++) a.v[l] = v;
+    return a;
+}
+inline lanes lanes_load(const float *v) {
+    lanes a;
+    memcpy(a.v, v, sizeof(a.v));
+    return a;
+}
+inline void lanes_store(lanes a, float *v) { memcpy(v, a.v, sizeof(a.v)); }
+
+#endif  // __SSE2__
+
+// DFT of `R` points in place
+template <int R>
+inline void butterfly(lanes *re, lanes *im) {
+    // exp(-2 pi i t / R)
+    static const vector<float> cos_t = [] {
+        vector<float> res(R);
+        for (int t = 0; t < R; t++) res[t] = cos(2 * M_PI * t / R);
+        return res;
+    }();
+    static const vector<float> sin_t = [] {
+        vector<float> res(R);
+        for (int t = 0; t < R; t++) res[t] = -sin(2 * M_PI * t / R);
+        return res;
+    }();
+    lanes out_re[R], out_im[R];
+    for (int k = 0; k < R; k++) {
+        out_re[k] = re[0];
+        out_im[k] = im[0];
+        for (int j = 1; j < R; j++) {
+            lanes c = lanes_set(cos_t[j * k % R]);
+            lanes s = lanes_set(sin_t[j * k % R]);
+            out_re[k] = lanes_add(out_re[k], lanes_sub(lanes_mul(re[j], c),
+                lanes_mul(im[j], s)));
+            out_im[k] = lanes_add(out_im[k], lanes_add(lanes_mul(re[j], s),
+                lanes_mul(im[j], c)));
+        }
+    }
+    for (int k = 0; k < R; k++) {
+        re[k] = out_re[k];
+        im[k] = out_im[k];
+    }
+}
+
+template <>
+inline void butterfly<2>(lanes *re, lanes *im) {
+    lanes r = re[1], i = im[1];
+    re[1] = lanes_sub(re[0], r);
+    im[1] = lanes_sub(im[0], i);
+    re[0] = lanes_add(re[0], r);
+    im[0] = lanes_add(im[0], i);
+}
+
+template <>
+inline void butterfly<4>(lanes *re, lanes *im) {
+    lanes s02r = lanes_add(re[0], re[2]), s02i = lanes_add(im[0], im[2]);
+    lanes d02r = lanes_sub(re[0], re[2]), d02i = lanes_sub(im[0], im[2]);
+    lanes s13r = lanes_add(re[1], re[3]), s13i = lanes_add(im[1], im[3]);
+    lanes d13r = lanes_sub(re[1], re[3]), d13i = lanes_sub(im[1], im[3]);
+    re[0] = lanes_add(s02r, s13r);
+    im[0] = lanes_add(s02i, s13i);
+    re[2] = lanes_sub(s02r, s13r);
+    im[2] = lanes_sub(s02i, s13i);
+    // -i * (d13r + i d13i) = d13i - i d13r
+    re[1] = lanes_add(d02r, d13i);
+    im[1] = lanes_sub(d02i, d13r);
+    re[3] = lanes_sub(d02r, d13i);
+    im[3] = lanes_add(d02i, d13r);
+}
+
+// One Stockham pass over sequences of `length` points `stride` apart:
+// y[q + stride * (R * p + k)] = DFT_k(x[q + stride * (p + j * m)]) * w^pk
+template <int R>
+void fft_pass(int64_t length, int64_t stride, const float *tw_re,
+        const float *tw_im, const lanes *xr, const lanes *xi, lanes *yr,
+        lanes *yi) {
+    int64_t m = length / R;
+    for (int64_t p = 0; p < m; p++) {
+        lanes wr[R], wi[R];
+        for (int k = 1; k < R; k++) {
+            wr[k] = lanes_set(tw_re[p * R + k]);
+            wi[k] = lanes_set(tw_im[p * R + k]);
+        }
+        for (int64_t q = 0; q < stride; q++) {
+            lanes re[R], im[R];
+            for (int j = 0; j < R; j++) {
+                re[j] = xr[q + stride * (p + j * m)];
+                im[j] = xi[q + stride * (p + j * m)];
+            }
+            butterfly<R>(re, im);
+            int64_t out = q + stride * R * p;
+            yr[out] = re[0];
+            yi[out] = im[0];
+            for (int k = 1; k < R; k++) {
+                out += stride;
+                yr[out] = lanes_sub(lanes_mul(re[k], wr[k]),
+                    lanes_mul(im[k], wi[k]));
+                yi[out] = lanes_add(lanes_mul(re[k], wi[k]),
+                    lanes_mul(im[k], wr[k]));
+            }
+        }
+    }
+}
+
+double hz_to_mel(double hz) {
+    return 2595 * log10(1 + hz / 700);
+}
+
+double mel_to_hz(double mel) {
+    return 700 * (pow(10.0, mel / 2595) - 1);
+}
+
+}  // namespace
+
+int64_t feature_frames(int64_t samples, int64_t frame, int64_t hop) {
+    return samples < frame ? 0 : 1 + (samples - frame) / hop;
+}
+
+string npy_header(const vector<int64_t>& shape) {
+    string dict = "{'descr': '<f4', 'fortran_order': False, 'shape': (";
+    for (int i = 0; i < shape.size(); i++) {
+        dict += (i > 0 ? ", " : "") + to_string(shape[i]);
+    }
+    dict += shape.size() == 1 ? ",), }" : "), }";
+    // Magic, version, header length, the dict and a newline; the data
+    // starts 64 byte aligned
+    int64_t size = (10 + dict.size() + 1 + 63) / 64 * 64;
+    dict.resize(size - 10 - 1, ' ');
+    dict += '\n';
+    uint16_t length = dict.size();
+    string res = "\x93NUMPY\x01";
+    res += '\0';
+    res += static_cast<char>(length & 0xff);
+    res += static_cast<char>(length >> 8);
+    return res + dict;
+}
+
+FeatureExtractor::FeatureExtractor(const feature_params& params,
+        int sample_rate, string* error) {
+    this->frame = llround(params.frame_sec * sample_rate);
+    this->hop = llround(params.hop_sec * sample_rate);
+    this->fft_size = params.fft_size;
+    this->bins = 0;
+    this->log = params.log;
+    if (this->frame <= 0 || this->hop <= 0) {
+        *error = "frame and hop should be at least one sample";
+        return;
+    }
+    if (this->fft_size == 0) {
+        this->fft_size = 2;
+        while (this->fft_size < this->frame) {
+            this->fft_size *= 2;
+        }
+    }
+    if (this->fft_size < this->frame || this->fft_size % 2 != 0) {
+        *error = "FFT size should be even and not below the frame (" +
+            to_string(this->frame) + " samples)";
+        return;
+    }
+    if (!this->plan(error)) {
+        return;
+    }
+
+    // Periodic Hann window
+    this->window.resize(this->frame);
+    for (int64_t i = 0; i < this->frame; i++) {
+        this->window[i] = 0.5 - 0.5 * cos(2 * M_PI * i / this->frame);
+    }
+    int half = this->fft_size / 2;
+    this->split_re.resize(half + 1);
+    this->split_im.resize(half + 1);
+    for (int k = 0; k <= half; k++) {
+        this->split_re[k] = cos(2 * M_PI * k / this->fft_size);
+        this->split_im[k] = -sin(2 * M_PI * k / this->fft_size);
+    }
+
+    double nyquist = sample_rate / 2.0;
+    double fmax = params.fmax > 0 ? params.fmax : nyquist;
+    if (params.mels < 0 || params.fmin < 0 || fmax > nyquist ||
+            params.fmin >= fmax) {
+        *error = "mel bands should not be negative, 0 <= fmin < fmax <= " +
+            to_string(nyquist) + " Hz";
+        return;
+    }
+    this->bins = params.mels > 0 ? params.mels : half + 1;
+    if (params.mels > 0) {
+        this->mel_filters(sample_rate, params.fmin, fmax);
+    }
+}
+
+bool FeatureExtractor::plan(string* error) {
+    // Radix 4 passes first, the odd factors last
+    int64_t rest = this->fft_size / 2;
+    vector<int> radixes;
+    for (int radix : {4, 2, 3, 5}) {
+        while (rest % radix == 0) {
+            radixes.push_back(radix);
+            rest /= radix;
+        }
+    }
+    if (rest != 1) {
+        *error = "FFT size " + to_string(this->fft_size) +
+            " has factors other than 2, 3 and 5";
+        return false;
+    }
+    int64_t length = this->fft_size / 2;
+    for (int radix : radixes) {
+        fft_stage stage = fft_stage{radix, length, {}, {}};
+        for (int64_t p = 0; p < length / radix; p++) {
+            for (int k = 0; k < radix; k++) {
+                double angle = 2 * M_PI * p * k / length;
+                stage.twiddle_re.push_back(cos(angle));
+                stage.twiddle_im.push_back(-sin(angle));
+            }
+        }
+        this->stages.push_back(stage);
+        length /= radix;
+    }
+    return true;
+}
+
+void FeatureExtractor::mel_filters(int sample_rate, double fmin,
+        double fmax) {
+    // Band m rises from point m to m + 1 and falls to m + 2, the points
+    // are evenly spaced on the mel scale
+    int mels = this->bins;
+    double lo = hz_to_mel(fmin), hi = hz_to_mel(fmax);
+    vector<double> points(mels + 2);
+    for (int j = 0; j < mels + 2; j++) {
+        points[j] = mel_to_hz(lo + (hi - lo) * j / (mels + 1));
+    }
+    for (int m = 0; m < mels; m++) {
+        double left = points[m], center = points[m + 1];
+        double right = points[m + 2];
+        int first = -1;
+        vector<float> weights;
+        for (int k = 0; k <= this->fft_size / 2; k++) {
+            double f = static_cast<double>(k) * sample_rate / this->fft_size;
+            double w = min((f - left) / (center - left),
+                (right - f) / (right - center));
+            if (w > 0) {
+                first = first < 0 ? k : first;
+                weights.push_back(w);
+            } else if (first >= 0) {
+                break;
+            }
+        }
+        this->filter_first.push_back(max(first, 0));
+        this->filter_weights.push_back(weights);
+    }
+}
+
+void FeatureExtractor::compute(const float *x, int64_t count,
+        float *out) const {
+    int64_t half = this->fft_size / 2;
+    int64_t spectrum = half + 1;
+    vector<lanes> re(half), im(half), work_re(half), work_im(half);
+    vector<lanes> power(spectrum), values(this->bins);
+    float r[FEATURE_LANES], i[FEATURE_LANES];
+    for (int64_t first = 0; first < count; first += FEATURE_LANES) {
+        int n = static_cast<int>(min(int64_t(FEATURE_LANES),
+            count - first));
+        // Windowed frames, unused lanes repeat the last one. Sample 2k
+        // is the real part of point k, sample 2k + 1 the imaginary part.
+        const float *frames[FEATURE_LANES];
+        for (int l = 0; l < FEATURE_LANES; l++) {
+            frames[l] = x + (first + min(l, n - 1)) * this->hop;
+        }
+        for (int64_t k = 0; k < half; k++) {
+            int64_t j = 2 * k;
+            for (int l = 0; l < FEATURE_LANES; l++) {
+                r[l] = j < this->frame ? frames[l][j] * this->window[j] : 0;
+                i[l] = j + 1 < this->frame ?
+                    frames[l][j + 1] * this->window[j + 1] : 0;
+            }
+            re[k] = lanes_load(r);
+            im[k] = lanes_load(i);
+        }
+
+        // Stockham passes alternate between the two arrays
+        lanes *xr = re.data(), *xi = im.data();
+        lanes *yr = work_re.data(), *yi = work_im.data();
+        int64_t stride = 1;
+        for (const fft_stage& st : this->stages) {
+            const float *wr = st.twiddle_re.data();
+            const float *wi = st.twiddle_im.data();
+            switch (st.radix) {
+            case 2:
+                fft_pass<2>(st.length, stride, wr, wi, xr, xi, yr, yi);
+                break;
+            case 3:
+                fft_pass<3>(st.length, stride, wr, wi, xr, xi, yr, yi);
+                break;
+            case 4:
+                fft_pass<4>(st.length, stride, wr, wi, xr, xi, yr, yi);
+                break;
+            default:
+                fft_pass<5>(st.length, stride, wr, wi, xr, xi, yr, yi);
+            }
+            swap(xr, yr);
+            swap(xi, yi);
+            stride *= st.radix;
+        }
+
+        // Spectrum of the real frames from the half size transform Z:
+        // X[k] = E[k] + w^k O[k], E = (Z[k] + Z*[-k]) / 2,
+        // O = -i (Z[k] - Z*[-k]) / 2
+        lanes halves = lanes_set(0.5f);
+        for (int64_t k = 0; k <= half; k++) {
+            int64_t a = k % half, b = (half - k) % half;
+            lanes er = lanes_mul(lanes_add(xr[a], xr[b]), halves);
+            lanes ei = lanes_mul(lanes_sub(xi[a], xi[b]), halves);
+            lanes orr = lanes_mul(lanes_add(xi[a], xi[b]), halves);
+            lanes oi = lanes_mul(lanes_sub(xr[b], xr[a]), halves);
+            lanes wr = lanes_set(this->split_re[k]);
+            lanes wi = lanes_set(this->split_im[k]);
+            lanes xre = lanes_add(er, lanes_sub(lanes_mul(wr, orr),
+                lanes_mul(wi, oi)));
+            lanes xim = lanes_add(ei, lanes_add(lanes_mul(wr, oi),
+                lanes_mul(wi, orr)));
+            power[k] = lanes_add(lanes_mul(xre, xre), lanes_mul(xim, xim));
+        }
+
+        const lanes *res = power.data();
+        if (!this->filter_first.empty()) {
+            for (int m = 0; m < this->bins; m++) {
+                const vector<float>& w = this->filter_weights[m];
+                const lanes *p = res + this->filter_first[m];
+                lanes acc = lanes_set(0);
+                for (int t = 0; t < w.size(); t++) {
+                    acc = lanes_add(acc, lanes_mul(lanes_set(w[t]), p[t]));
+                }
+                values[m] = acc;
+            }
+            res = values.data();
+        }
+        for (int m = 0; m < this->bins; m++) {
+            lanes_store(res[m], r);
+            for (int l = 0; l < n; l++) {
+                float v = this->log ? logf(max(r[l], LOG_FLOOR)) : r[l];
+                out[(first + l) * this->bins + m] = v;
+            }
+        }
+    }
+}
@@ -0,0 +1,92 @@
+// Copyright 2023 Andrei Drozdov
+
+#ifndef SRC_SPECTRUM_H_
+#define SRC_SPECTRUM_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// Spectrogram and log-mel filterbank features.
+// Frames of `frame` samples start every `hop` samples (the first one at
+// sample 0, no padding), they are Hann windowed and zero padded to the
+// FFT size. A real FFT of n points is a complex FFT of n / 2 points
+// (mixed radix 4, 2, 3, 5, Stockham order) run on a batch of frames at
+// once, one frame per SIMD lane. Power spectra go through triangular
+// HTK mel filters, values are natural logs floored at 1e-10.
+
+typedef struct {
+    double frame_sec;
+    double hop_sec;
+    // FFT points: even with factors 2, 3 and 5 only, not below the
+    // frame; 0: the next power of two
+    int fft_size;
+    // Mel bands, 0: power spectrum (fft_size / 2 + 1 bins)
+    int mels;
+    // Mel filter range in Hz, fmax 0: the Nyquist frequency
+    double fmin;
+    double fmax;
+    // Natural log of the values
+    bool log;
+    // Channel of the features, -1: all channels
+    int channel;
+} feature_params;
+
+const feature_params DEFAULT_FEATURE_PARAMS = {
+    0.025, 0.01, 0, 80, 0.0, 0.0, true, -1};
+
+// Frames (in samples) of all the windows that fit in `samples` samples
+int64_t feature_frames(int64_t samples, int64_t frame, int64_t hop);
+
+// NumPy .npy (format 1.0) header of a C order float32 array, the data
+// follows it
+std::string npy_header(const std::vector<int64_t>& shape);
+
+class FeatureExtractor{
+ public:
+        // Error message in `error` and valid() false on bad parameters
+        FeatureExtractor(const feature_params& params, int sample_rate,
+            std::string* error);
+
+        inline bool valid() const { return this->bins > 0; }
+        // Values per frame
+        inline int Bins() const { return this->bins; }
+        inline int64_t Frame() const { return this->frame; }
+        inline int64_t Hop() const { return this->hop; }
+        inline int FFTSize() const { return this->fft_size; }
+
+        // Features of `count` frames, frame i starts at x + i * hop and
+        // its values go to out + i * Bins(). Safe to call from many
+        // threads at once.
+        void compute(const float *x, int64_t count, float *out) const;
+
+ private:
+        // One pass of the complex FFT: radix and twiddles
+        // (twiddle[p * radix + k] = exp(-2 pi i p k / length))
+        typedef struct {
+            int radix;
+            int64_t length;
+            std::vector<float> twiddle_re;
+            std::vector<float> twiddle_im;
+        } fft_stage;
+
+        bool plan(std::string* error);
+        void mel_filters(int sample_rate, double fmin, double fmax);
+
+        int64_t frame;
+        int64_t hop;
+        int fft_size;
+        int bins;
+        bool log;
+        std::vector<float> window;
+        std::vector<fft_stage> stages;
+        // exp(-2 pi i k / fft_size), real FFT post-processing
+        std::vector<float> split_re;
+        std::vector<float> split_im;
+        // Sparse mel filters: first FFT bin and weights of every band
+        std::vector<int> filter_first;
+        std::vector<std::vector<float>> filter_weights;
+};
+
+#endif  // SRC_SPECTRUM_H_
@@ -0,0 +1,156 @@
+// Copyright 2023 Andrei Drozdov
+
+#include "./stats.h"  // NOLINT [build/include]
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include <atomic>
+#include <chrono>  // NOLINT [build/c++11]
+#include <new>
+#include <ostream>
+
+using namespace std;  // NOLINT [build/namespaces]
+
+namespace {
+
+const char* const STAGE_NAMES[STAGE_COUNT] = {
+    "header", "read", "decode", "load_channels", "convert", "resample",
+    "interleave", "encode", "write", "copy"};
+
+struct stage_counters {
+    atomic<int64_t> ns;
+    atomic<int64_t> calls;
+    atomic<int64_t> bytes;
+    atomic<int64_t> samples;
+};
+
+stage_counters stages[STAGE_COUNT];
+atomic<int64_t> allocations(0);
+atomic<int64_t> allocated_bytes(0);
+chrono::steady_clock::time_point started = chrono::steady_clock::now();
+
+}  // namespace
+
+#ifdef ASL_STATS
+
+// Heap allocations of the whole process
+void* operator new(size_t size) {
+    stats_alloc(size);
+    void *ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    stats_alloc(size);
+    return malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](size_t size, const nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, const nothrow_t&) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr, const nothrow_t&) noexcept {
+    free(ptr);
+}
+
+#endif  // ASL_STATS
+
+void stats_time(stat_stage stage, int64_t ns) {
+    stages[stage].ns.fetch_add(ns, memory_order_relaxed);
+    stages[stage].calls.fetch_add(1, memory_order_relaxed);
+}
+
+void stats_count(stat_stage stage, int64_t bytes, int64_t samples) {
+    stages[stage].bytes.fetch_add(bytes, memory_order_relaxed);
+    stages[stage].samples.fetch_add(samples, memory_order_relaxed);
+}
+
+void stats_alloc(int64_t bytes) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    allocated_bytes.fetch_add(bytes, memory_order_relaxed);
+}
+
+void stats_reset() {
+    for (stage_counters& st : stages) {
+        st.ns = 0;
+        st.calls = 0;
+        st.bytes = 0;
+        st.samples = 0;
+    }
+    allocations = 0;
+    allocated_bytes = 0;
+    started = chrono::steady_clock::now();
+}
+
+stage_stats stats_stage(stat_stage stage) {
+    const stage_counters& st = stages[stage];
+    return stage_stats{st.ns, st.calls, st.bytes, st.samples};
+}
+
+int64_t stats_allocations() {
+    return allocations;
+}
+
+void stats_json(ostream& out) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double elapsed = chrono::duration<double>(
+        chrono::steady_clock::now() - started).count();
+#ifdef ASL_STATS
+    bool instrumented = true;
+#else
+    bool instrumented = false;
+#endif
+    out << "{\"instrumented\": " << (instrumented ? "true" : "false");
+    out << ", \"elapsed_sec\": " << elapsed;
+    // Kilobytes on Linux
+    out << ", \"peak_rss_bytes\": " << int64_t(usage.ru_maxrss) * 1024;
+    out << ", \"user_sec\": " << usage.ru_utime.tv_sec +
+        usage.ru_utime.tv_usec / 1e6;
+    out << ", \"system_sec\": " << usage.ru_stime.tv_sec +
+        usage.ru_stime.tv_usec / 1e6;
+    if (instrumented) {
+        out << ", \"allocations\": " << allocations;
+        out << ", \"allocated_bytes\": " << allocated_bytes;
+        out << ", \"stages\": {";
+        for (int i=0; i < STAGE_COUNT; i++) {
+            stage_stats st = stats_stage(stat_stage(i));
+            out << (i > 0 ? ", " : "") << "\"" << STAGE_NAMES[i] << "\": ";
+            out << "{\"sec\": " << st.ns / 1e9;
+            out << ", \"calls\": " << st.calls;
+            out << ", \"bytes\": " << st.bytes;
+            out << ", \"samples\": " << st.samples << "}";
+        }
+        out << "}";
+    }
+    out << "}";
+}
@@ -0,0 +1,84 @@
+// Copyright 2023 Andrei Drozdov
+
+#ifndef SRC_STATS_H_
+#define SRC_STATS_H_
+
+#include <stdint.h>
+
+#include <chrono>  // NOLINT [build/c++11]
+#include <ostream>
+
+// Hot path instrumentation.
+// Scoped timers and byte/sample counters of the AudioSlicer stages go to
+// process wide atomic counters. Stage times are summed over the worker
+// threads, with parallel jobs they add up to more than the elapsed
+// time. Mapped inputs are paged in by the first stage that touches the
+// samples (decode or load_channels), not by read.
+// The macros compile to nothing without ASL_STATS; the elapsed time and
+// the peak RSS are reported either way.
+
+enum stat_stage {
+    STAGE_HEADER,
+    // Input bytes fetched for decoding
+    STAGE_READ,
+    // G.711 and ADPCM decoders
+    STAGE_DECODE,
+    // LPCM and float de-interleave (with conversion or remix)
+    STAGE_LOAD_CHANNELS,
+    // In place conversion and remix of decoded channels
+    STAGE_CONVERT,
+    STAGE_RESAMPLE,
+    STAGE_INTERLEAVE,
+    STAGE_ENCODE,
+    STAGE_WRITE,
+    // Source bytes copied to outputs in the kernel
+    STAGE_COPY,
+    STAGE_COUNT
+};
+
+typedef struct {
+    int64_t ns;
+    int64_t calls;
+    int64_t bytes;
+    int64_t samples;
+} stage_stats;
+
+void stats_time(stat_stage stage, int64_t ns);
+void stats_count(stat_stage stage, int64_t bytes, int64_t samples);
+void stats_alloc(int64_t bytes);
+void stats_reset();
+stage_stats stats_stage(stat_stage stage);
+int64_t stats_allocations();
+// One JSON object: elapsed time since the start (or reset), peak RSS,
+// heap allocations and the time, calls, bytes and samples of every stage
+void stats_json(std::ostream& out);
+
+class StageTimer{
+ public:
+        explicit StageTimer(stat_stage stage)
+            : stage(stage), start(std::chrono::steady_clock::now()) {}
+        ~StageTimer() {
+            stats_time(this->stage, std::chrono::duration_cast<
+                std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                this->start).count());
+        }
+
+ private:
+        stat_stage stage;
+        std::chrono::steady_clock::time_point start;
+};
+
+#ifdef ASL_STATS
+#define STATS_JOIN(a, b) a##b
+#define STATS_NAME(line) STATS_JOIN(stats_timer_, line)
+// Time the rest of the enclosing scope
+#define STATS_SCOPE(stage) StageTimer STATS_NAME(__LINE__)(stage)
+#define STATS_COUNT(stage, bytes, samples) stats_count(stage, bytes, samples)
+#define STATS_ALLOC(bytes) stats_alloc(bytes)
+#else
+#define STATS_SCOPE(stage)
+#define STATS_COUNT(stage, bytes, samples)
+#define STATS_ALLOC(bytes)
+#endif  // ASL_STATS
+
+#endif  // SRC_STATS_H_
@@ -0,0 +1,58 @@
+// Copyright 2023 Andrei Drozdov
+
+#include "./vad.h"  // NOLINT [build/include]
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+using namespace std;  // NOLINT [build/namespaces]
+
+namespace {
+
+// The noise floor follows quieter frames at once and rises this much
+// per second otherwise, so it adapts to louder backgrounds
+const double NOISE_RISE_DB = 2.0;
+
+// Level of digital silence
+const double MIN_LEVEL_DB = -120.0;
+
+}  // namespace
+
+vector<pair<int64_t, int64_t>> detect_voice(const float *energy,
+        const float *zcr, int64_t frames, const vad_params& params) {
+    vector<pair<int64_t, int64_t>> res;
+    int64_t hangover = llround(params.hangover_sec / params.frame_sec);
+    int64_t min_speech = llround(params.min_speech_sec / params.frame_sec);
+    double rise = NOISE_RISE_DB * params.frame_sec;
+    // Speech at the very start is judged by the absolute threshold
+    double floor_db = params.threshold_db - params.margin_db;
+
+    // Open segment: its first and last speech frames
+    int64_t start = -1, last = -1;
+    for (int64_t i = 0; i < frames; i++) {
+        double level = max(10 * log10(max(static_cast<double>(energy[i]),
+            1e-30)), MIN_LEVEL_DB);
+        floor_db = min(floor_db + rise, level);
+        double speech_db = max(params.threshold_db,
+            floor_db + params.margin_db);
+        bool is_speech = level >= speech_db || (params.zcr > 0 &&
+            zcr[i] >= params.zcr && level >= speech_db - params.margin_db / 2);
+        if (is_speech) {
+            start = start < 0 ? i : start;
+            last = i;
+        } else if (start >= 0 && i - last > hangover) {
+            if (last + 1 - start >= min_speech) {
+                res.push_back({start, last + 1});
+            }
+            start = -1;
+        }
+    }
+    if (start >= 0 && last + 1 - start >= min_speech) {
+        res.push_back({start, last + 1});
+    }
+    return res;
+}
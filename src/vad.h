@@ -0,0 +1,43 @@
+// Copyright 2023 Andrei Drozdov
+
+#ifndef SRC_VAD_H_
+#define SRC_VAD_H_
+
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+// Energy based voice activity detection.
+// A frame is speech when its level is above the absolute threshold and
+// the tracked noise floor plus a margin. Unvoiced sounds (fricatives)
+// are quieter but cross zero often: with a high zero-crossing rate half
+// the margin is enough. Speech continues through pauses shorter than
+// the hangover, bursts shorter than min_speech are dropped.
+
+typedef struct {
+    // Analysis frame length
+    double frame_sec;
+    // Lowest speech level (dBFS of the frame RMS)
+    double threshold_db;
+    // Speech level above the noise floor
+    double margin_db;
+    // Zero crossings per sample of unvoiced speech (0: not used)
+    double zcr;
+    double hangover_sec;
+    double min_speech_sec;
+    // Added on both sides of every segment, overlapping ones are merged
+    double pad_sec;
+    // Channel to listen to, -1: the loudest channel of every frame
+    int channel;
+} vad_params;
+
+const vad_params DEFAULT_VAD_PARAMS = {
+    0.02, -45.0, 10.0, 0.3, 0.3, 0.1, 0.1, -1};
+
+// Speech frame ranges [first, last) from the mean square and the
+// zero-crossing rate of every frame
+std::vector<std::pair<int64_t, int64_t>> detect_voice(const float *energy,
+    const float *zcr, int64_t frames, const vad_params& params);
+
+#endif  // SRC_VAD_H_
@@ -1,5 +1,7 @@
 #include "gtest/gtest.h"
 #include "slice.h"
+#include "g711.h"
+#include <algorithm>
 #include <vector>
 #include <utility>
 
@@ -38,4 +40,50 @@ namespace {
         EXPECT_TRUE(compare(
             "test_alaw_one.wav", "../tests/expected/test_alaw_one.wav"));
     }
+
+    TEST(AudioALawFormatTest, TestDecodeChannels) {
+        // Vector and scalar decoders must match the table for every code
+        for (int channels=1; channels <= 3; channels++) {
+            int frames = 256 + 7;
+            std::vector<char> codes(frames * channels);
+            for (int i=0; i < codes.size(); i++) {
+                codes[i] = static_cast<char>(i * 7 + i / channels);
+            }
+            std::vector<std::vector<int16_t>> out(
+                channels, std::vector<int16_t>(frames));
+            std::vector<char*> dst;
+            for (int ch=0; ch < channels; ch++) {
+                dst.push_back(reinterpret_cast<char*>(out[ch].data()));
+            }
+            g711_decode(G711_ALAW, codes.data(), frames, channels, dst.data());
+            for (int i=0; i < frames; i++) {
+                for (int ch=0; ch < channels; ch++) {
+                    uint8_t code = codes[i * channels + ch];
+                    ASSERT_EQ(out[ch][i], ALAW_DECODE.value[code]);
+                }
+            }
+        }
+    }
+
+    TEST(AudioALawFormatTest, TestRoundTrip) {
+        // Every code decodes to a sample that encodes back to it
+        std::vector<int16_t> pcm(256);
+        for (int code=0; code < 256; code++) {
+            pcm[code] = ALAW_DECODE.value[code];
+            ASSERT_EQ(alaw_code(pcm[code]), code);
+        }
+        std::vector<char> codes(pcm.size());
+        g711_encode(G711_ALAW, pcm.data(), pcm.size(), codes.data());
+        for (int code=0; code < 256; code++) {
+            ASSERT_EQ(static_cast<uint8_t>(codes[code]), code);
+        }
+
+        // Samples keep their sign and stay within half a quantization step
+        for (int x=-32768; x < 32768; x++) {
+            int16_t decoded = ALAW_DECODE.value[alaw_code(x)];
+            ASSERT_EQ(decoded > 0, x >= 0) << x;
+            ASSERT_LE(std::abs(decoded - x), std::max(8, std::abs(x) / 16))
+                << x;
+        }
+    }
 }
@@ -0,0 +1,115 @@
+#include "gtest/gtest.h"
+#include "slice.h"
+#include "analyze.h"
+#include <vector>
+#include <string>
+#include <cmath>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cassert>
+
+#include "./aux.h"
+
+
+namespace {
+    const int rate = 8000;
+
+    // 2 s stereo 16 bit file:
+    // ch 0: +-16384 square wave (period 20) for 1 s, then silence
+    // ch 1: 100 samples at +full scale, 100 at -full scale, then 1000
+    void write_test_file(const std::string& fname) {
+        std::vector<int16_t> data;
+        for (int i = 0; i < 2 * rate; i++) {
+            int16_t a = i < rate ? ((i / 10) % 2 ? -16384 : 16384) : 0;
+            int16_t b = i < 100 ? 32767 : i < 200 ? -32768 : 1000;
+            data.push_back(a);
+            data.push_back(b);
+        }
+        write_wav(fname, CT_LPCM, 2, rate, 16, data);
+    }
+
+    TEST(AudioAnalyzeTest, TestStats) {
+        write_test_file("analyze_test.wav");
+        auto as = AudioSlicer("analyze_test.wav");
+        as.set_jobs(1);
+        std::vector<channel_stats> stats = as.analyze(0.02, -60);
+        ASSERT_EQ(stats.size(), 2);
+
+        EXPECT_EQ(stats[0].peak, 0.5f);
+        EXPECT_NEAR(stats[0].rms, std::sqrt(0.125), 1e-9);
+        EXPECT_NEAR(stats[0].dc_offset, 0, 1e-12);
+        EXPECT_EQ(stats[0].clipped, 0);
+        // 799 sign changes in the square wave, one into the silence
+        EXPECT_NEAR(stats[0].zero_crossing_rate, 800.0 / (2 * rate - 1),
+            1e-12);
+        EXPECT_NEAR(stats[0].silence_ratio, 0.5, 1e-12);
+
+        EXPECT_EQ(stats[1].peak, 1.0f);
+        EXPECT_EQ(stats[1].clipped, 200);
+        EXPECT_NEAR(stats[1].dc_offset,
+            (100 * 32767.0 - 100 * 32768.0 + 15800 * 1000.0) /
+            (2 * rate * 32768.0), 1e-9);
+        EXPECT_NEAR(stats[1].zero_crossing_rate, 2.0 / (2 * rate - 1),
+            1e-12);
+        EXPECT_EQ(stats[1].silence_ratio, 0);
+
+        // Output settings are restored
+        as.slice({chunk{0, 1, "analyze_slice.wav"}});
+        EXPECT_EQ(AudioSlicer("analyze_slice.wav").BitsPerSample(), 16);
+    }
+
+    TEST(AudioAnalyzeTest, TestParallel) {
+        // Ranges analyzed by several workers give the same result
+        write_test_file("analyze_test.wav");
+        auto as = AudioSlicer("analyze_test.wav");
+        as.set_jobs(1);
+        std::vector<channel_stats> one = as.analyze(0.02, -40);
+        as.set_jobs(3);
+        as.set_block_size(333);
+        std::vector<channel_stats> many = as.analyze(0.02, -40);
+        for (int ch = 0; ch < 2; ch++) {
+            EXPECT_EQ(one[ch].peak, many[ch].peak);
+            EXPECT_NEAR(one[ch].rms, many[ch].rms, 1e-9);
+            EXPECT_NEAR(one[ch].dc_offset, many[ch].dc_offset, 1e-9);
+            EXPECT_EQ(one[ch].clipped, many[ch].clipped);
+            EXPECT_EQ(one[ch].zero_crossing_rate, many[ch].zero_crossing_rate);
+            EXPECT_EQ(one[ch].silence_ratio, many[ch].silence_ratio);
+        }
+    }
+
+    TEST(AudioAnalyzeTest, TestKernel) {
+        // Vector reductions against a plain loop, odd sizes for tails
+        std::vector<float> x(1237);
+        srand(7);
+        for (float& v : x) {
+            v = (rand() % 20001 - 10000) / 10000.0f;
+        }
+        signal_params params = signal_params{37, 0.5f, 0.99f};
+        signal_sums sums = signal_sums{};
+        accumulate_signal(x.data(), 500, params, &sums);
+        signal_sums rest = signal_sums{};
+        accumulate_signal(x.data() + 500, x.size() - 500, params, &rest);
+        merge_signal(&sums, rest);
+
+        double sum = 0, sum_sq = 0;
+        float peak = 0;
+        int64_t clipped = 0, crossings = 0;
+        for (int i = 0; i < x.size(); i++) {
+            sum += x[i];
+            sum_sq += x[i] * x[i];
+            peak = std::max(peak, std::fabs(x[i]));
+            clipped += std::fabs(x[i]) >= 0.99f;
+            crossings += i > 0 && (x[i] < 0) != (x[i - 1] < 0);
+        }
+        EXPECT_EQ(sums.samples, x.size());
+        EXPECT_NEAR(sums.sum, sum, 1e-3);
+        EXPECT_NEAR(sums.sum_sq, sum_sq, 1e-3);
+        EXPECT_EQ(sums.peak, peak);
+        EXPECT_EQ(sums.clipped, clipped);
+        EXPECT_EQ(sums.crossings, crossings);
+        // 14 windows for the first range, 20 for the rest
+        EXPECT_EQ(sums.windows, 34);
+    }
+}
@@ -1,5 +1,10 @@
+#include <stdint.h>
+#include <cassert>
+#include <cstdio>
+#include <iostream>
 #include <string>
 #include <utility>
+#include <vector>
 
 std::pair<int, char*> read_file(std::string filename) {
     FILE* wavFile = fopen(filename.c_str(), "r");
@@ -21,18 +26,49 @@ bool compare(std::string a, std::string b) {
     std::pair<int, char*> file_a = read_file(a);
     std::pair<int, char*> file_b = read_file(b);
 
+    bool same = true;
     if (file_a.first != file_b.first) {
         std::cout << "Wrong size assertion:";
         std::cout << " " << file_a.first << " vs";
         std::cout << " " << file_b.first << std::endl;
-        return false;
+        same = false;
     }
 
-    for (int i=0; i<file_a.first; i++){
+    for (int i=0; same && i<file_a.first; i++){
         if (file_a.second[i] != file_b.second[i]){
             std::cout << "Wrong byte assertion at " << i << std::endl;
-            return false;
+            same = false;
         }
     }
-    return true;
+    free(file_a.second);
+    free(file_b.second);
+    return same;
+}
+
+// Wave file with a plain 16 byte fmt section and the interleaved
+// samples of data
+template <typename T>
+void write_wav(const std::string& fname, uint16_t format, uint16_t channels,
+        uint32_t rate, uint16_t bits, const std::vector<T>& data) {
+    uint32_t size = data.size() * sizeof(T);
+    uint32_t riff = 36 + size;
+    uint32_t fmt_size = 16;
+    uint16_t align = channels * bits / 8;
+    uint32_t byte_rate = rate * align;
+    FILE *f = fopen(fname.c_str(), "wb");
+    assert(f != nullptr);
+    fwrite("RIFF", 1, 4, f);
+    fwrite(&riff, 4, 1, f);
+    fwrite("WAVEfmt ", 1, 8, f);
+    fwrite(&fmt_size, 4, 1, f);
+    fwrite(&format, 2, 1, f);
+    fwrite(&channels, 2, 1, f);
+    fwrite(&rate, 4, 1, f);
+    fwrite(&byte_rate, 4, 1, f);
+    fwrite(&align, 2, 1, f);
+    fwrite(&bits, 2, 1, f);
+    fwrite("data", 1, 4, f);
+    fwrite(&size, 4, 1, f);
+    fwrite(data.data(), sizeof(T), data.size(), f);
+    fclose(f);
 }
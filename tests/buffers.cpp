@@ -0,0 +1,97 @@
+#include "gtest/gtest.h"
+#include "slice.h"
+#include "buffers.h"
+#include <vector>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./aux.h"
+
+
+namespace {
+    const std::string test_file = "../samples/sample.wav";
+    const std::string test_file_2ch = "../samples/sample_2ch.wav";
+
+    static_assert(!std::is_copy_constructible<AudioSlicer>::value,
+        "AudioSlicer owns its input");
+    static_assert(!std::is_copy_assignable<AudioSlicer>::value,
+        "AudioSlicer owns its input");
+    static_assert(std::is_move_constructible<AudioSlicer>::value,
+        "AudioSlicer can be moved");
+
+    TEST(AudioBuffersTest, TestClasses) {
+        int64_t prev = 0;
+        for (int64_t size = 1; size < 1 << 24; size += size / 7 + 1) {
+            int64_t cls = buffer_class(size);
+            EXPECT_GE(cls, size);
+            EXPECT_LT(cls, size + std::max(size / 4 + 1, BUFFER_ALIGN));
+            EXPECT_EQ(cls % BUFFER_ALIGN, 0);
+            EXPECT_GE(cls, prev);
+            EXPECT_EQ(buffer_class(cls), cls);
+            prev = cls;
+        }
+    }
+
+    TEST(AudioBuffersTest, TestPool) {
+        BufferPool pool(1 << 20);
+        int64_t capacity = 0, other = 0;
+        char *a = pool.acquire(100000, &capacity);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(a) % BUFFER_ALIGN, 0);
+        EXPECT_GE(capacity, 100000);
+        memset(a, 1, capacity);
+
+        // Same class: the released buffer comes back
+        pool.release(a, capacity);
+        EXPECT_EQ(pool.Idle(), capacity);
+        char *b = pool.acquire(capacity - 100, &other);
+        EXPECT_EQ(b, a);
+        EXPECT_EQ(other, capacity);
+        EXPECT_EQ(pool.Allocations(), 1);
+        EXPECT_EQ(pool.Idle(), 0);
+
+        // Other classes and buffers beyond the limit are allocated
+        char *c = pool.acquire(600000, &other);
+        char *d = pool.acquire(600000, &other);
+        EXPECT_EQ(pool.Allocations(), 3);
+        pool.release(c, other);
+        pool.release(d, other);
+        EXPECT_EQ(pool.Idle(), other);
+        pool.release(b, capacity);
+        EXPECT_EQ(pool.Idle(), other + capacity);
+        pool.set_limit(capacity);
+        EXPECT_EQ(pool.Idle(), capacity);
+        pool.trim();
+        EXPECT_EQ(pool.Idle(), 0);
+    }
+
+    TEST(AudioBuffersTest, TestReuse) {
+        // Repeated runs over files of one format take all their sample
+        // buffers from the pool
+        auto as = AudioSlicer(test_file_2ch);
+        as.set_jobs(1);
+        as.split_channels("buf_split_");
+        as.slice({chunk{0, 1, "buf_slice.wav"}});
+        int64_t allocations = BufferPool::shared().Allocations();
+        for (int i = 0; i < 3; i++) {
+            auto other = AudioSlicer(test_file_2ch);
+            other.set_jobs(1);
+            other.split_channels("buf_split_again_");
+            other.slice({chunk{0, 1, "buf_slice.wav"}});
+        }
+        EXPECT_EQ(BufferPool::shared().Allocations(), allocations);
+        EXPECT_TRUE(compare("buf_split_0.wav", "buf_split_again_0.wav"));
+
+        // Moved and reassigned slicers keep working
+        AudioSlicer moved(std::move(as));
+        moved.split_channels("buf_moved_");
+        EXPECT_TRUE(compare("buf_split_1.wav", "buf_moved_1.wav"));
+        moved = AudioSlicer(test_file);
+        EXPECT_EQ(moved.Channels(), 1);
+        moved.split_channels("buf_mono_");
+    }
+}
@@ -0,0 +1,178 @@
+#include "gtest/gtest.h"
+#include "slice.h"
+#include "convert.h"
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cassert>
+
+#include "./aux.h"
+
+
+namespace {
+    // First 0.5 s of sample.wav: 8 bit unsigned (v >> 8) + 128 and
+    // 24 bit (v << 8) with low bytes below 128
+    const std::string test_file_u8 = "../samples/sample_u8.wav";
+    const std::string test_file_24 = "../samples/sample_24.wav";
+    const std::vector<sample_type> int_types = {
+        SAMPLE_U8, SAMPLE_S16, SAMPLE_S24, SAMPLE_S32};
+
+    int bits(sample_type type) {
+        return sample_bytes(type) * 8;
+    }
+
+    int64_t load(sample_type type, const char *p) {
+        int64_t v = 0;
+        memcpy(&v, p, sample_bytes(type));
+        if (type == SAMPLE_U8) {
+            return v - 128;
+        }
+        // sign extend
+        int shift = 64 - bits(type);
+        return static_cast<int64_t>(static_cast<uint64_t>(v) << shift) >>
+            shift;
+    }
+
+    void store(sample_type type, char *p, int64_t v) {
+        if (type == SAMPLE_U8) {
+            v += 128;
+        }
+        memcpy(p, &v, sample_bytes(type));
+    }
+
+    std::vector<char> convert(sample_type from, sample_type to,
+            const std::vector<char>& src, bool dither) {
+        int64_t samples = src.size() / sample_bytes(from);
+        std::vector<char> dst(samples * sample_bytes(to));
+        convert_fn fn = select_convert(from, to);
+        EXPECT_TRUE(fn != nullptr);
+        fn(src.data(), samples, dst.data(), dither);
+        return dst;
+    }
+
+    // Full scale ramp with both ends, 53 samples for vector loops and tails
+    std::vector<char> ramp(sample_type type) {
+        const int n = 53;
+        int64_t top = int64_t(1) << (bits(type) - 1);
+        std::vector<char> res(n * sample_bytes(type));
+        for (int i = 0; i < n; i++) {
+            int64_t v = -top + (2 * top - 1) * i / (n - 1);
+            store(type, res.data() + i * sample_bytes(type), v);
+        }
+        return res;
+    }
+
+    // Samples after the header
+    std::vector<char> data(const std::string& fname, int header) {
+        std::pair<int, char*> file = read_file(fname);
+        std::vector<char> res(file.second + header,
+            file.second + file.first);
+        free(file.second);
+        return res;
+    }
+
+    TEST(AudioDepthTest, TestKernels) {
+        // Every pair against the reference: shift up, or round half up
+        // and clip
+        for (sample_type from : int_types) {
+            for (sample_type to : int_types) {
+                if (from == to) {
+                    EXPECT_TRUE(select_convert(from, to) == nullptr);
+                    continue;
+                }
+                std::vector<char> src = ramp(from);
+                std::vector<char> out = convert(from, to, src, false);
+                int shift = bits(from) - bits(to);
+                int64_t hi = (int64_t(1) << (bits(to) - 1)) - 1;
+                for (int i = 0; i < 53; i++) {
+                    int64_t v = load(from, src.data() + i * sample_bytes(from));
+                    int64_t want = shift <= 0 ? v * (int64_t(1) << -shift) :
+                        std::min((v + (int64_t(1) << (shift - 1))) >> shift, hi);
+                    ASSERT_EQ(load(to, out.data() + i * sample_bytes(to)), want)
+                        << bits(from) << " -> " << bits(to) << " at " << i;
+                }
+                // Widening and back is exact
+                if (shift < 0) {
+                    EXPECT_EQ(convert(to, from, out, false), src);
+                }
+            }
+        }
+    }
+
+    TEST(AudioDepthTest, TestSliceUnsigned) {
+        auto as = AudioSlicer(test_file_u8);
+        EXPECT_EQ(as.BitsPerSample(), 8);
+        as.set_output_bits(16);
+        as.slice({chunk{0, 0.5, "test_u8_16.wav"}});
+
+        std::vector<char> src = data(test_file_u8, 44);
+        std::vector<char> out = data("test_u8_16.wav", 44);
+        ASSERT_EQ(out.size(), src.size() * 2);
+        for (size_t i = 0; i < src.size(); i++) {
+            int16_t v;
+            memcpy(&v, out.data() + i * 2, 2);
+            ASSERT_EQ(v, (static_cast<uint8_t>(src[i]) - 128) * 256);
+        }
+    }
+
+    TEST(AudioDepthTest, TestSlicePacked24) {
+        // Low bytes are below half a 16 bit step: rounding restores
+        // sample.wav exactly
+        auto as = AudioSlicer(test_file_24);
+        as.set_output_bits(16);
+        as.set_block_size(1001);
+        as.slice({chunk{0.1, 0.5, "test_24_16.wav"}});
+
+        std::vector<char> out = data("test_24_16.wav", 44);
+        std::vector<char> full = data("../tests/expected/test_one.wav", 44);
+        int64_t first = 2205, last = 11025;
+        ASSERT_EQ(int64_t(out.size()), (last - first) * 2);
+        EXPECT_EQ(memcmp(out.data(), full.data() + first * 2, out.size()), 0);
+
+        // G.711 output converts to 16 bit first
+        as.set_output_bits(0);
+        as.set_output_format(CT_MS_MLAW);
+        as.slice({chunk{0, 0.5, "test_24_ulaw.wav"}});
+        std::vector<char> ulaw = data("test_24_ulaw.wav", 58);
+        std::vector<char> expected = data(
+            "../tests/expected/test_one_ulaw.wav", 58);
+        ASSERT_EQ(ulaw.size(), size_t(11025));
+        EXPECT_EQ(memcmp(ulaw.data(), expected.data(), ulaw.size()), 0);
+    }
+
+    TEST(AudioDepthTest, TestRoundTripMultichannel) {
+        auto as = AudioSlicer("../samples/sample_16ch.wav");
+        as.set_output_bits(24);
+        as.set_block_size(333);
+        as.slice({chunk{0.1, 0.4, "test_16ch_24.wav"}});
+        EXPECT_EQ(AudioSlicer("test_16ch_24.wav").BitsPerSample(), 24);
+        as.set_output_bits(0);
+        as.slice({chunk{0.1, 0.4, "test_16ch_16.wav"}});
+
+        auto as_24 = AudioSlicer("test_16ch_24.wav");
+        as_24.set_output_bits(16);
+        as_24.slice({chunk{0, 1, "test_16ch_back.wav"}});
+        EXPECT_TRUE(compare("test_16ch_16.wav", "test_16ch_back.wav"));
+    }
+
+    TEST(AudioDepthTest, TestDither) {
+        std::vector<char> src = ramp(SAMPLE_S24);
+        for (int i = 0; i < 6; i++) {
+            src.insert(src.end(), src.begin(), src.end());
+        }
+        std::vector<char> plain = convert(SAMPLE_S24, SAMPLE_S16, src, false);
+        std::vector<char> noisy = convert(SAMPLE_S24, SAMPLE_S16, src, true);
+        int changed = 0;
+        for (int i = 0; i < plain.size() / 2; i++) {
+            int64_t a = load(SAMPLE_S16, plain.data() + i * 2);
+            int64_t b = load(SAMPLE_S16, noisy.data() + i * 2);
+            ASSERT_LE(std::abs(a - b), 1);
+            changed += a != b;
+        }
+        EXPECT_GT(changed, 0);
+    }
+}
@@ -0,0 +1,235 @@
+#include "gtest/gtest.h"
+#include "slice.h"
+#include "convert.h"
+#include <vector>
+#include <utility>
+#include <cmath>
+#include <limits>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cassert>
+
+#include "./aux.h"
+
+
+namespace {
+    // sample.wav as float samples (v / 32768): 1.5 s of 32 bit float,
+    // 0.5 s of 64 bit float in a WAVE_FORMAT_EXTENSIBLE file
+    const std::string test_file = "../samples/sample_float.wav";
+    const std::string test_file_double = "../samples/sample_double.wav";
+    const std::string test_format = "3 (IEEE floating-point)";
+
+    std::vector<char> convert(sample_type from, sample_type to,
+            const std::vector<char>& src, bool dither) {
+        int64_t samples = src.size() / sample_bytes(from);
+        std::vector<char> dst(samples * sample_bytes(to));
+        convert_fn fn = select_convert(from, to);
+        EXPECT_TRUE(fn != nullptr);
+        fn(src.data(), samples, dst.data(), dither);
+        return dst;
+    }
+
+    template <typename T>
+    std::vector<char> bytes(const std::vector<T>& values) {
+        std::vector<char> res(values.size() * sizeof(T));
+        memcpy(res.data(), values.data(), res.size());
+        return res;
+    }
+
+    TEST(AudioFloatFormatTest, TestRead) {
+        auto as = AudioSlicer(test_file);
+        EXPECT_EQ(as.audio_format(), test_format);
+        EXPECT_EQ(as.BitsPerSample(), 32);
+        EXPECT_EQ(as.Channels(), 1);
+        EXPECT_EQ(as.NumSamples(), 33075);
+
+        auto as_double = AudioSlicer(test_file_double);
+        EXPECT_EQ(as_double.audio_format(), test_format);
+        EXPECT_EQ(as_double.BitsPerSample(), 64);
+        EXPECT_EQ(as_double.NumSamples(), 11025);
+    }
+
+    TEST(AudioFloatFormatTest, TestSliceFloat) {
+        // Float sources are copied as they are
+        auto as = AudioSlicer(test_file, true);
+        as.slice({chunk{0, 1, "test_float_one.wav"}});
+        EXPECT_TRUE(compare(
+            "test_float_one.wav", "../tests/expected/test_float_one.wav"));
+
+        // 16 bit source converted to float
+        auto as_int = AudioSlicer("../samples/sample.wav", true);
+        as_int.set_output_format(CT_IEEEFP);
+        as_int.slice({chunk{0, 1, "test_float_from_int.wav"}});
+        EXPECT_TRUE(compare(
+            "test_float_from_int.wav", "../tests/expected/test_float_one.wav"));
+    }
+
+    TEST(AudioFloatFormatTest, TestSliceToPCM) {
+        auto as = AudioSlicer(test_file, true);
+        as.set_output_format(CT_LPCM);
+        as.slice({chunk{0, 1, "test_float_pcm.wav"}});
+        EXPECT_TRUE(compare("test_float_pcm.wav", "../tests/expected/test_one.wav"));
+
+        auto as_double = AudioSlicer(test_file_double);
+        as_double.set_output_format(CT_LPCM);
+        as_double.set_block_size(1000);
+        as_double.slice({chunk{0.1, 0.5, "test_double_pcm.wav"}});
+        std::pair<int, char*> out = read_file("test_double_pcm.wav");
+        std::pair<int, char*> full = read_file("../tests/expected/test_one.wav");
+        int64_t first = 2205, last = 11025;
+        ASSERT_EQ(out.first, 44 + (last - first) * 2);
+        EXPECT_EQ(memcmp(out.second + 44, full.second + 44 + first * 2,
+            (last - first) * 2), 0);
+        free(out.second);
+        free(full.second);
+    }
+
+    TEST(AudioFloatFormatTest, TestRoundTripMultichannel) {
+        // 16 bit -> float -> 16 bit is exact, 16 channels go through the
+        // tiled conversion with de-interleave
+        auto as = AudioSlicer("../samples/sample_16ch.wav");
+        as.set_output_format(CT_IEEEFP);
+        as.set_block_size(777);
+        as.slice({chunk{0.05, 0.45, "test_float_16ch.wav"}});
+        as.set_output_format(CT_LPCM);
+        as.slice({chunk{0.05, 0.45, "test_pcm_16ch.wav"}});
+
+        auto as_float = AudioSlicer("test_float_16ch.wav");
+        EXPECT_EQ(as_float.Channels(), 16);
+        as_float.set_output_format(CT_LPCM);
+        as_float.slice({chunk{0, 1, "test_pcm_16ch_back.wav"}});
+        EXPECT_TRUE(compare("test_pcm_16ch.wav", "test_pcm_16ch_back.wav"));
+    }
+
+    TEST(AudioFloatFormatTest, TestCodedToFloat) {
+        // G.711 samples are widened in place after decoding
+        auto as = AudioSlicer("../samples/addf8-Alaw-GW.wav");
+        as.slice({chunk{0, 1, "test_alaw_pcm.wav"}});
+        as.set_output_format(CT_IEEEFP);
+        as.slice({chunk{0, 1, "test_alaw_float.wav"}});
+
+        std::pair<int, char*> pcm = read_file("test_alaw_pcm.wav");
+        std::pair<int, char*> flt = read_file("test_alaw_float.wav");
+        int64_t samples = (pcm.first - 44) / 2;
+        ASSERT_EQ(flt.first, 58 + samples * 4);
+        for (int64_t i = 0; i < samples; i++) {
+            int16_t v;
+            float f;
+            memcpy(&v, pcm.second + 44 + i * 2, 2);
+            memcpy(&f, flt.second + 58 + i * 4, 4);
+            ASSERT_EQ(f, v / 32768.0f);
+        }
+        free(pcm.second);
+        free(flt.second);
+    }
+
+    TEST(AudioFloatFormatTest, TestConvertedParallelDecode) {
+        // ADPCM decodes 16 bit samples whatever the output width, block
+        // ranges of the threads must not move with it
+        for (std::string name : {"ima", "msadpcm"}) {
+            for (int bits : {0, 24, 32}) {
+                auto as = AudioSlicer("../samples/sample_" + name +
+                    "_2ch.wav");
+                if (bits == 0) {
+                    as.set_output_format(CT_IEEEFP);
+                } else {
+                    as.set_output_bits(bits);
+                }
+                std::string prefix = "conv_" + name + "_" +
+                    std::to_string(bits) + "_";
+                as.set_jobs(1);
+                as.split_channels(prefix + "serial_");
+                as.set_jobs(4);
+                as.split_channels(prefix + "parallel_");
+                for (int ch=0; ch < 2; ch++) {
+                    std::string n = std::to_string(ch) + ".wav";
+                    EXPECT_TRUE(compare(prefix + "serial_" + n,
+                        prefix + "parallel_" + n)) << prefix;
+                }
+            }
+        }
+    }
+
+    TEST(AudioFloatFormatTest, TestQuantize) {
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        const float inf = std::numeric_limits<float>::infinity();
+        std::vector<float> in = {0, 0.5f / 32768, 1.5f / 32768,
+            -2.5f / 32768, 1.0f, -1.0f, 2.0f, nan, inf, -inf};
+        std::vector<int16_t> want = {0, 0, 2, -2, 32767, -32768, 32767,
+            0, 32767, -32768};
+        // Long enough for the vector loops, odd for the scalar tail
+        std::vector<float> src;
+        std::vector<int16_t> expected;
+        for (int i = 0; i < 37; i++) {
+            src.push_back(in[i % in.size()]);
+            expected.push_back(want[i % want.size()]);
+        }
+        EXPECT_EQ(convert(SAMPLE_F32, SAMPLE_S16, bytes(src), false),
+            bytes(expected));
+
+        std::vector<double> src64(src.begin(), src.end());
+        EXPECT_EQ(convert(SAMPLE_F64, SAMPLE_S16, bytes(src64), false),
+            bytes(expected));
+
+        std::vector<float> full(21, 1.0f);
+        full.push_back(-1.0f);
+        std::vector<int32_t> full32(21, 2147483647);
+        full32.push_back(-2147483647 - 1);
+        EXPECT_EQ(convert(SAMPLE_F32, SAMPLE_S32, bytes(full), false),
+            bytes(full32));
+
+        std::vector<char> s24 = convert(SAMPLE_F32, SAMPLE_S24,
+            bytes(full), false);
+        EXPECT_EQ(s24[0], '\xFF');
+        EXPECT_EQ(s24[2], '\x7F');
+        EXPECT_EQ(s24[21 * 3 + 2], '\x80');
+
+        std::vector<char> u8 = convert(SAMPLE_F32, SAMPLE_U8,
+            bytes(std::vector<float>{0, 1.0f, -1.0f}), false);
+        EXPECT_EQ(u8, std::vector<char>({'\x80', '\xFF', '\x00'}));
+    }
+
+    TEST(AudioFloatFormatTest, TestIntToFloat) {
+        std::vector<int16_t> src;
+        for (int i = 0; i < 41; i++) {
+            src.push_back(static_cast<int16_t>(i * 1601 - 32768));
+        }
+        std::vector<char> flt = convert(SAMPLE_S16, SAMPLE_F32, bytes(src),
+            false);
+        const float *values = reinterpret_cast<const float*>(flt.data());
+        EXPECT_EQ(values[0], -1.0f);
+        for (int i = 0; i < src.size(); i++) {
+            EXPECT_EQ(values[i], src[i] / 32768.0f);
+        }
+        EXPECT_EQ(convert(SAMPLE_F32, SAMPLE_S16, flt, false), bytes(src));
+
+        // 24 bit samples survive the round trip through float
+        std::vector<char> s24;
+        for (int i = 0; i < 29; i++) {
+            int32_t v = i * 289173 - 8388608;
+            s24.insert(s24.end(), {static_cast<char>(v),
+                static_cast<char>(v >> 8), static_cast<char>(v >> 16)});
+        }
+        EXPECT_EQ(convert(SAMPLE_F32, SAMPLE_S24,
+            convert(SAMPLE_S24, SAMPLE_F32, s24, false), false), s24);
+        EXPECT_EQ(convert(SAMPLE_F64, SAMPLE_S24,
+            convert(SAMPLE_S24, SAMPLE_F64, s24, false), false), s24);
+    }
+
+    TEST(AudioFloatFormatTest, TestDither) {
+        // 0.3 LSB: rounding alone always gives 0, dither keeps the mean
+        const int n = 100000;
+        std::vector<float> src(n, 0.3f / 32768);
+        std::vector<char> out = convert(SAMPLE_F32, SAMPLE_S16, bytes(src),
+            true);
+        const int16_t *values = reinterpret_cast<const int16_t*>(out.data());
+        double sum = 0;
+        for (int i = 0; i < n; i++) {
+            ASSERT_LE(std::abs(values[i]), 1);
+            sum += values[i];
+        }
+        EXPECT_NEAR(sum / n, 0.3, 0.02);
+    }
+}
@@ -0,0 +1,79 @@
+#include "gtest/gtest.h"
+#include "slice.h"
+#include "adpcm.h"
+#include <vector>
+#include <utility>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cassert>
+
+#include "./aux.h"
+
+
+namespace {
+    // Encoded from sample.wav / sample_2ch.wav, expected files are
+    // decoded with Python audioop
+    const std::string test_file = "../samples/sample_ima.wav";
+    const std::string test_file_2ch = "../samples/sample_ima_2ch.wav";
+    const std::string test_format = "17 (Intel IMA/DVI ADPCM)";
+
+    TEST(AudioImaFormatTest, TestRead) {
+        auto as = AudioSlicer(test_file);
+        EXPECT_EQ(as.Size(), 30 * 512);
+        EXPECT_EQ(as.audio_format(), test_format);
+        EXPECT_EQ(as.SampleRate(), 22050);
+        EXPECT_EQ(as.BitsPerSample(), 4);
+        EXPECT_EQ(as.Channels(), 1);
+        EXPECT_EQ(as.NumSamples(), 30 * 1017);
+    }
+
+    TEST(AudioImaFormatTest, TestSlice) {
+        auto as = AudioSlicer(test_file, true);
+        as.slice({chunk{0, 1, "test_ima_one.wav"}});
+        EXPECT_TRUE(compare(
+            "test_ima_one.wav", "../tests/expected/test_ima_one.wav"));
+
+        auto as_2ch = AudioSlicer(test_file_2ch, true);
+        EXPECT_EQ(as_2ch.Channels(), 2);
+        as_2ch.slice({chunk{0, 1, "test_ima_2ch_one.wav"}});
+        EXPECT_TRUE(compare(
+            "test_ima_2ch_one.wav", "../tests/expected/test_ima_2ch_one.wav"));
+    }
+
+    TEST(AudioImaFormatTest, TestSliceInsideBlocks) {
+        // Ranges starting and ending inside blocks, small stream blocks
+        auto as = AudioSlicer(test_file_2ch);
+        as.set_block_size(700);
+        as.slice({chunk{0.3, 0.7, "test_ima_2ch_part.wav"}});
+
+        std::pair<int, char*> out = read_file("test_ima_2ch_part.wav");
+        std::pair<int, char*> full = read_file(
+            "../tests/expected/test_ima_2ch_one.wav");
+        int64_t first = 13230, last = 30870;
+        ASSERT_EQ(out.first, 44 + (last - first) * 4);
+        EXPECT_EQ(memcmp(out.second + 44, full.second + 44 + first * 4,
+            (last - first) * 4), 0);
+        free(out.second);
+        free(full.second);
+    }
+
+    TEST(AudioImaFormatTest, TestParallelDecode) {
+        // Block ranges split between threads decode the same samples
+        auto as = AudioSlicer(test_file_2ch);
+        as.set_jobs(1);
+        as.split_channels("ima_serial_");
+        as.set_jobs(3);
+        as.split_channels("ima_parallel_");
+        // Several streaming blocks share the decoder threads
+        as.set_block_size(20000);
+        as.split_channels("ima_parallel_blocks_");
+        for (int ch=0; ch < 2; ch++) {
+            std::string n = std::to_string(ch) + ".wav";
+            EXPECT_TRUE(compare("ima_serial_" + n, "ima_parallel_" + n));
+            EXPECT_TRUE(compare("ima_serial_" + n,
+                "ima_parallel_blocks_" + n));
+        }
+    }
+}
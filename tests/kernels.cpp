@@ -0,0 +1,57 @@
+#include "gtest/gtest.h"
+#include "kernels.h"
+#include <vector>
+
+#include <stdlib.h>
+
+
+namespace {
+    // Round trip every kernel against a plain per-byte reference
+    void check_kernels(int bytes, int channels, int frames) {
+        std::vector<char> src(frames * channels * bytes);
+        for (int i=0; i < src.size(); i++) {
+            src[i] = static_cast<char>(rand());
+        }
+        std::vector<std::vector<char>> planes(
+            channels, std::vector<char>(frames * bytes));
+        std::vector<char*> dst;
+        for (int ch=0; ch < channels; ch++) {
+            dst.push_back(planes[ch].data());
+        }
+
+        deinterleave_fn deinterleave = select_deinterleave(bytes, channels);
+        ASSERT_TRUE(deinterleave != nullptr);
+        deinterleave(src.data(), frames, channels, dst.data());
+        for (int i=0; i < frames; i++) {
+            for (int ch=0; ch < channels; ch++) {
+                for (int b=0; b < bytes; b++) {
+                    ASSERT_EQ(planes[ch][i * bytes + b],
+                        src[(i * channels + ch) * bytes + b]);
+                }
+            }
+        }
+
+        std::vector<char> out(src.size());
+        interleave_fn interleave = select_interleave(bytes, channels);
+        ASSERT_TRUE(interleave != nullptr);
+        interleave(dst.data(), frames, channels, out.data());
+        EXPECT_TRUE(out == src);
+    }
+
+    TEST(KernelsTest, TestRoundTrip) {
+        int widths[] = {1, 2, 3, 4, 8};
+        for (int bytes : widths) {
+            for (int channels=1; channels <= 8; channels++) {
+                // Odd frame counts exercise the scalar tails
+                check_kernels(bytes, channels, 1);
+                check_kernels(bytes, channels, 67);
+                check_kernels(bytes, channels, 1000);
+            }
+        }
+    }
+
+    TEST(KernelsTest, TestUnsupportedWidth) {
+        EXPECT_TRUE(select_deinterleave(5, 2) == nullptr);
+        EXPECT_TRUE(select_interleave(0, 1) == nullptr);
+    }
+}
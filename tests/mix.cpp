@@ -0,0 +1,133 @@
+#include "gtest/gtest.h"
+#include "slice.h"
+#include "mix.h"
+#include <vector>
+#include <string>
+#include <utility>
+#include <cmath>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cassert>
+
+#include "./aux.h"
+
+
+namespace {
+    const std::string test_file = "../samples/sample.wav";
+    const std::string test_file_2ch = "../samples/sample_2ch.wav";
+    const std::string test_file_16ch = "../samples/sample_16ch.wav";
+    const std::string test_file_ima_2ch = "../samples/sample_ima_2ch.wav";
+    const int pcm_header = 44;
+
+    // 16 bit samples of a PCM output
+    std::vector<int16_t> samples(const std::string& fname) {
+        std::pair<int, char*> file = read_file(fname);
+        std::vector<int16_t> res((file.first - pcm_header) / 2);
+        memcpy(res.data(), file.second + pcm_header, res.size() * 2);
+        free(file.second);
+        return res;
+    }
+
+    // Largest difference from the weighted sum of the inputs
+    int max_error(const std::vector<int16_t>& out,
+            const std::vector<std::vector<int16_t>>& in,
+            const std::vector<double>& weights) {
+        int res = 0;
+        for (size_t i = 0; i < out.size(); i++) {
+            double sum = 0;
+            for (size_t c = 0; c < in.size(); c++) {
+                sum += weights[c] * in[c][i];
+            }
+            res = std::max(res, static_cast<int>(std::fabs(out[i] - sum) +
+                0.5));
+        }
+        return res;
+    }
+
+    TEST(AudioMixTest, TestParse) {
+        mix_matrix mix;
+        std::string error;
+        ASSERT_TRUE(parse_mix("0+1", 2, &mix, &error));
+        EXPECT_EQ(mix.outputs, 1);
+        EXPECT_EQ(mix.weights, std::vector<float>({0.5f, 0.5f}));
+
+        ASSERT_TRUE(parse_mix("0,2", 3, &mix, &error));
+        EXPECT_EQ(mix.outputs, 2);
+        EXPECT_EQ(mix.weights,
+            std::vector<float>({1, 0, 0, 0, 0, 1}));
+
+        ASSERT_TRUE(parse_mix("0.7*0+0.3*1,1+1", 2, &mix, &error));
+        EXPECT_EQ(mix.outputs, 2);
+        EXPECT_EQ(mix.weights, std::vector<float>({0.7f, 0.3f, 0, 1}));
+
+        ASSERT_TRUE(parse_mix("mono", 4, &mix, &error));
+        EXPECT_EQ(mix.outputs, 1);
+        EXPECT_EQ(mix.weights, std::vector<float>(4, 0.25f));
+
+        for (std::string bad : {"", "2", "0,", "0+a", "x*1", "-1", "0++1"}) {
+            EXPECT_FALSE(parse_mix(bad, 2, &mix, &error)) << bad;
+            EXPECT_FALSE(error.empty());
+        }
+    }
+
+    TEST(AudioMixTest, TestSelect) {
+        // Selections move the samples as they are
+        auto as = AudioSlicer(test_file_2ch);
+        as.split_channels("mix_plain_");
+        as.set_mix("1,0");
+        as.split_channels("mix_swap_");
+        EXPECT_TRUE(compare("mix_plain_0.wav", "mix_swap_1.wav"));
+        EXPECT_TRUE(compare("mix_plain_1.wav", "mix_swap_0.wav"));
+
+        // An empty mix keeps all channels
+        as.set_mix("");
+        as.split_channels("mix_again_");
+        EXPECT_TRUE(compare("mix_plain_1.wav", "mix_again_1.wav"));
+
+        auto mono = AudioSlicer(test_file);
+        mono.split_channels("mix_mono_");
+        mono.set_mix("0,0");
+        mono.split_channels("mix_up_");
+        EXPECT_TRUE(compare("mix_mono_0.wav", "mix_up_0.wav"));
+        EXPECT_TRUE(compare("mix_mono_0.wav", "mix_up_1.wav"));
+    }
+
+    TEST(AudioMixTest, TestDownmix) {
+        auto as = AudioSlicer(test_file_2ch);
+        as.split_channels("mix_2ch_");
+        as.set_mix("mono");
+        double duration = as.NumSamples() / double(as.SampleRate());
+        as.slice({chunk{0, duration, "mix_2ch_mono.wav"}});
+        auto out = AudioSlicer("mix_2ch_mono.wav");
+        EXPECT_EQ(out.Channels(), 1);
+        EXPECT_EQ(out.NumSamples(), as.NumSamples());
+        EXPECT_LE(max_error(samples("mix_2ch_mono.wav"),
+            {samples("mix_2ch_0.wav"), samples("mix_2ch_1.wav")},
+            {0.5, 0.5}), 1);
+
+        // Weighted mix of many channels, small blocks
+        auto multi = AudioSlicer(test_file_16ch);
+        multi.split_channels("mix_16ch_");
+        multi.set_mix("0.25*3+0.5*7+0.25*15,2");
+        multi.set_block_size(777);
+        multi.split_channels("mix_16ch_out_");
+        EXPECT_LE(max_error(samples("mix_16ch_out_0.wav"),
+            {samples("mix_16ch_3.wav"), samples("mix_16ch_7.wav"),
+            samples("mix_16ch_15.wav")}, {0.25, 0.5, 0.25}), 1);
+        EXPECT_TRUE(compare("mix_16ch_2.wav", "mix_16ch_out_1.wav"));
+    }
+
+    TEST(AudioMixTest, TestDecodedMix) {
+        // ADPCM blocks are decoded into channels and mixed in place
+        auto as = AudioSlicer(test_file_ima_2ch);
+        as.set_output_format(CT_LPCM);
+        as.split_channels("mix_ima_");
+        as.set_mix("0+1");
+        as.split_channels("mix_ima_mono_");
+        EXPECT_LE(max_error(samples("mix_ima_mono_0.wav"),
+            {samples("mix_ima_0.wav"), samples("mix_ima_1.wav")},
+            {0.5, 0.5}), 1);
+    }
+}
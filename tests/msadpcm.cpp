@@ -0,0 +1,93 @@
+#include "gtest/gtest.h"
+#include "slice.h"
+#include "adpcm.h"
+#include <vector>
+#include <utility>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cassert>
+
+#include "./aux.h"
+
+
+namespace {
+    // Encoded from sample.wav / sample_2ch.wav, expected files are
+    // decoded with a Python reference decoder
+    const std::string test_file = "../samples/sample_msadpcm.wav";
+    const std::string test_file_2ch = "../samples/sample_msadpcm_2ch.wav";
+    const std::string test_format = "2 (Microsoft ADPCM)";
+
+    TEST(AudioMsAdpcmFormatTest, TestRead) {
+        auto as = AudioSlicer(test_file);
+        EXPECT_EQ(as.Size(), 60 * 256);
+        EXPECT_EQ(as.audio_format(), test_format);
+        EXPECT_EQ(as.SampleRate(), 22050);
+        EXPECT_EQ(as.BitsPerSample(), 4);
+        EXPECT_EQ(as.Channels(), 1);
+        EXPECT_EQ(as.NumSamples(), 60 * 500);
+    }
+
+    TEST(AudioMsAdpcmFormatTest, TestSlice) {
+        auto as = AudioSlicer(test_file, true);
+        as.slice({chunk{0, 1, "test_msadpcm_one.wav"}});
+        EXPECT_TRUE(compare(
+            "test_msadpcm_one.wav", "../tests/expected/test_msadpcm_one.wav"));
+
+        auto as_2ch = AudioSlicer(test_file_2ch, true);
+        EXPECT_EQ(as_2ch.Channels(), 2);
+        as_2ch.slice({chunk{0, 1, "test_msadpcm_2ch_one.wav"}});
+        EXPECT_TRUE(compare(
+            "test_msadpcm_2ch_one.wav", "../tests/expected/test_msadpcm_2ch_one.wav"));
+    }
+
+    TEST(AudioMsAdpcmFormatTest, TestSliceInsideBlocks) {
+        // Ranges starting and ending inside blocks, small stream blocks
+        auto as = AudioSlicer(test_file_2ch);
+        as.set_block_size(700);
+        as.slice({chunk{0.3, 0.7, "test_msadpcm_2ch_part.wav"}});
+
+        std::pair<int, char*> out = read_file("test_msadpcm_2ch_part.wav");
+        std::pair<int, char*> full = read_file(
+            "../tests/expected/test_msadpcm_2ch_one.wav");
+        int64_t first = 13230, last = 30870;
+        ASSERT_EQ(out.first, 44 + (last - first) * 4);
+        EXPECT_EQ(memcmp(out.second + 44, full.second + 44 + first * 4,
+            (last - first) * 4), 0);
+        free(out.second);
+        free(full.second);
+    }
+
+    TEST(AudioMsAdpcmFormatTest, TestCoefficients) {
+        // Decoder uses the table from the fmt extension
+        std::vector<char> block(7 + 2);
+        block[0] = 1;  // second pair: 2 * s1 - s2
+        int16_t delta = 16, s1 = 100, s2 = 50;
+        memcpy(block.data() + 1, &delta, 2);
+        memcpy(block.data() + 3, &s1, 2);
+        memcpy(block.data() + 5, &s2, 2);
+        block[7] = 0x10;  // +1 * delta, then 0
+        std::vector<int16_t> out(6);
+        char *dst[1] = {reinterpret_cast<char*>(out.data())};
+        ms_adpcm_decode(block.data(), 1, block.size(), 4, 1,
+            MS_ADPCM_COEFS, 7, dst);
+        EXPECT_EQ(out[0], 50);
+        EXPECT_EQ(out[1], 100);
+        EXPECT_EQ(out[2], 150 + 16);
+        EXPECT_EQ(out[3], 2 * 166 - 100);
+    }
+
+    TEST(AudioMsAdpcmFormatTest, TestParallelDecode) {
+        // Block ranges split between threads decode the same samples
+        auto as = AudioSlicer(test_file_2ch);
+        as.set_jobs(1);
+        as.split_channels("msadpcm_serial_");
+        as.set_jobs(3);
+        as.split_channels("msadpcm_parallel_");
+        for (int ch=0; ch < 2; ch++) {
+            std::string n = std::to_string(ch) + ".wav";
+            EXPECT_TRUE(compare("msadpcm_serial_" + n, "msadpcm_parallel_" + n));
+        }
+    }
+}
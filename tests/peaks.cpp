@@ -0,0 +1,131 @@
+#include "gtest/gtest.h"
+#include "slice.h"
+#include "peaks.h"
+#include <vector>
+#include <string>
+#include <utility>
+#include <cmath>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cassert>
+
+#include "./aux.h"
+
+
+namespace {
+    const std::string test_file_16ch = "../samples/sample_16ch.wav";
+
+    TEST(AudioPeaksTest, TestBins) {
+        // Vector bins and merged levels against direct sums
+        srand(9);
+        std::vector<float> x(256 * 37 + 101);
+        for (float& v : x) {
+            v = (rand() % 20001 - 10000) / 10000.0f;
+        }
+        std::vector<peak_bin> bins(38), merged(3);
+        accumulate_peaks(x.data(), x.size(), 256, bins.data());
+        merge_peaks(bins.data(), x.size(), 256, 16, merged.data());
+        for (int b = 0; b < 3; b++) {
+            int64_t first = b * 4096;
+            int64_t last = std::min(first + 4096, int64_t(x.size()));
+            float lo = x[first], hi = x[first];
+            double power = 0;
+            for (int64_t i = first; i < last; i++) {
+                lo = std::min(lo, x[i]);
+                hi = std::max(hi, x[i]);
+                power += x[i] * x[i];
+            }
+            EXPECT_EQ(merged[b].lo, lo);
+            EXPECT_EQ(merged[b].hi, hi);
+            EXPECT_NEAR(merged[b].power, power / (last - first), 1e-5);
+        }
+        EXPECT_EQ(bins[37].hi, *std::max_element(x.end() - 101, x.end()));
+    }
+
+    TEST(AudioPeaksTest, TestQuery) {
+        // A ramp repeating every 1000 samples over three top level bins
+        const int frames = 200000;
+        std::vector<float> x(frames);
+        for (int i = 0; i < frames; i++) {
+            x[i] = (i % 1000) / 1000.0f - 0.5f;
+        }
+        x[70001] = 0.9f;
+        write_wav("pk_ramp.wav", CT_IEEEFP, 1, 16000, 32, x);
+        auto as = AudioSlicer("pk_ramp.wav");
+        PeakIndex index;
+        EXPECT_TRUE(as.peak_index("pk_ramp.peaks", false, &index));
+        EXPECT_EQ(index.Frames(), frames);
+        EXPECT_EQ(index.Channels(), 1);
+
+        for (std::pair<int64_t, int> q : std::vector<std::pair<int64_t,
+                int>>{{frames, 2}, {frames, 40}, {5000, 7}, {300, 100}}) {
+            int64_t first = 65536 + 123, last = first + q.first;
+            last = std::min(last, int64_t(frames));
+            std::vector<peak_pixel> res = index.query(0, first, last,
+                q.second);
+            ASSERT_EQ(res.size(), q.second);
+            int64_t bin = PEAK_BIN_FRAMES[index.level_for(
+                double(last - first) / q.second)];
+            for (int p = 0; p < q.second; p++) {
+                // Whole bins overlapping the pixel
+                int64_t start = first + (last - first) * p / q.second;
+                int64_t end = first + (last - first) * (p + 1) / q.second;
+                int64_t lo = start / bin * bin;
+                int64_t hi = std::min(std::max((end + bin - 1) / bin * bin,
+                    lo + bin), int64_t(frames));
+                float mn = x[lo], mx = x[lo];
+                double power = 0;
+                for (int64_t i = lo; i < hi; i++) {
+                    mn = std::min(mn, x[i]);
+                    mx = std::max(mx, x[i]);
+                    power += x[i] * x[i];
+                }
+                EXPECT_EQ(res[p].min, mn) << q.first << " " << p;
+                EXPECT_EQ(res[p].max, mx) << q.first << " " << p;
+                EXPECT_NEAR(res[p].rms, sqrt(power / (hi - lo)), 1e-5);
+            }
+        }
+        EXPECT_EQ(index.level_for(100), 0);
+        EXPECT_EQ(index.level_for(5000), 1);
+        EXPECT_EQ(index.level_for(1e6), 2);
+        EXPECT_TRUE(index.query(1, 0, frames, 10).empty());
+        EXPECT_TRUE(index.query(0, frames, frames + 10, 10).empty());
+    }
+
+    TEST(AudioPeaksTest, TestSidecar) {
+        // Built once, reopened while the source is unchanged
+        auto as = AudioSlicer(test_file_16ch);
+        as.set_jobs(1);
+        PeakIndex index;
+        EXPECT_TRUE(as.peak_index("pk_16ch.peaks", true, &index));
+        EXPECT_FALSE(as.peak_index("pk_16ch.peaks", false, &index));
+        EXPECT_EQ(index.Channels(), 16);
+        EXPECT_EQ(index.SampleRate(), as.SampleRate());
+        std::vector<peak_pixel> whole = index.query(5, 0, as.NumSamples(),
+            1);
+        ASSERT_EQ(whole.size(), 1);
+        EXPECT_LE(whole[0].min, whole[0].max);
+
+        // Parallel builds with small blocks give the same file
+        as.set_jobs(4);
+        as.set_block_size(333);
+        EXPECT_TRUE(as.peak_index("pk_16ch_par.peaks", true, &index));
+        EXPECT_TRUE(compare("pk_16ch.peaks", "pk_16ch_par.peaks"));
+
+        // Another size or mtime makes the sidecar stale
+        std::pair<int, char*> file = read_file("pk_16ch.peaks");
+        const peak_header *head = reinterpret_cast<const peak_header*>(
+            file.second);
+        EXPECT_TRUE(index.open("pk_16ch.peaks", head->source_size,
+            head->source_mtime));
+        EXPECT_FALSE(index.open("pk_16ch.peaks", head->source_size + 1,
+            head->source_mtime));
+        EXPECT_FALSE(index.open("pk_16ch.peaks", head->source_size,
+            head->source_mtime - 1));
+        EXPECT_FALSE(index.open("pk_missing.peaks", head->source_size,
+            head->source_mtime));
+        free(file.second);
+    }
+}
@@ -0,0 +1,149 @@
+#include "gtest/gtest.h"
+#include "slice.h"
+#include "resample.h"
+#include <vector>
+#include <string>
+#include <utility>
+#include <functional>
+#include <cmath>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cassert>
+
+#include "./aux.h"
+
+
+namespace {
+    const std::string test_file_16ch = "../samples/sample_16ch.wav";
+    const std::string test_file_ulaw = "../samples/addf8-mulaw-GW.wav";
+    // RIFF, 18 byte fmt, fact and data headers of float outputs
+    const int float_header = 58;
+
+    // Mono 32 bit float file of fn(t)
+    void write_float_file(const std::string& fname, int rate, int frames,
+            const std::function<double(double)>& fn) {
+        std::vector<float> data;
+        for (int i = 0; i < frames; i++) {
+            data.push_back(static_cast<float>(fn(double(i) / rate)));
+        }
+        write_wav(fname, CT_IEEEFP, 1, rate, 32, data);
+    }
+
+    // Largest difference from fn(t) away from the edges
+    double max_error(const std::string& fname, int rate, int edge,
+            const std::function<double(double)>& fn) {
+        std::pair<int, char*> file = read_file(fname);
+        int frames = (file.first - float_header) / 4;
+        double res = 0;
+        for (int i = edge; i < frames - edge; i++) {
+            float v;
+            memcpy(&v, file.second + float_header + i * 4, 4);
+            res = std::max(res, std::fabs(v - fn(double(i) / rate)));
+        }
+        free(file.second);
+        return res;
+    }
+
+    TEST(AudioResampleTest, TestUpsample) {
+        auto tone = [](double t) {
+            return 0.5 * std::sin(2 * M_PI * 440 * t);
+        };
+        write_float_file("rs_8k.wav", 8000, 8000, tone);
+        auto as = AudioSlicer("rs_8k.wav");
+        as.set_output_rate(16000);
+        as.slice({chunk{0, 1, "rs_16k.wav"}});
+
+        auto out = AudioSlicer("rs_16k.wav");
+        EXPECT_EQ(out.SampleRate(), 16000);
+        EXPECT_EQ(out.NumSamples(), 16000);
+        EXPECT_LT(max_error("rs_16k.wav", 16000, 200, tone), 1e-3);
+    }
+
+    TEST(AudioResampleTest, TestDownsample) {
+        // 12 kHz is above the new Nyquist frequency and is filtered out
+        auto low = [](double t) {
+            return 0.3 * std::sin(2 * M_PI * 1000 * t);
+        };
+        write_float_file("rs_48k.wav", 48000, 24000, [&](double t) {
+            return low(t) + 0.3 * std::sin(2 * M_PI * 12000 * t);
+        });
+        auto as = AudioSlicer("rs_48k.wav");
+        as.set_output_rate(16000);
+        as.set_block_size(1000);
+        as.slice({chunk{0, 0.5, "rs_48k_16k.wav"}});
+
+        EXPECT_EQ(AudioSlicer("rs_48k_16k.wav").NumSamples(), 8000);
+        EXPECT_LT(max_error("rs_48k_16k.wav", 16000, 100, low), 1e-3);
+    }
+
+    TEST(AudioResampleTest, TestStreaming) {
+        // Any block sizes give the output of one call
+        const int frames = 10000;
+        std::vector<float> input(frames);
+        srand(3);
+        for (float& v : input) {
+            v = (rand() % 20001 - 10000) / 10000.0f;
+        }
+        int64_t total = resampled_frames(44100, 16000, frames);
+        EXPECT_EQ(total, (frames * 160 + 440) / 441);
+
+        std::vector<float> whole(resample_capacity(44100, 16000, frames));
+        const char *in = reinterpret_cast<const char*>(input.data());
+        char *out = reinterpret_cast<char*>(whole.data());
+        Resampler one(44100, 16000, 1, SAMPLE_F32, false);
+        ASSERT_EQ(one.process(&in, frames, true, &out), total);
+
+        Resampler parts(44100, 16000, 1, SAMPLE_F32, false);
+        std::vector<float> block(resample_capacity(44100, 16000, 997));
+        std::vector<float> joined;
+        for (int pos = 0; pos < frames; ) {
+            int n = std::min(1 + rand() % 997, frames - pos);
+            in = reinterpret_cast<const char*>(input.data() + pos);
+            out = reinterpret_cast<char*>(block.data());
+            pos += n;
+            int64_t done = parts.process(&in, n, pos == frames, &out);
+            joined.insert(joined.end(), block.begin(), block.begin() + done);
+        }
+        ASSERT_EQ(joined.size(), total);
+        EXPECT_EQ(memcmp(joined.data(), whole.data(), total * 4), 0);
+    }
+
+    TEST(AudioResampleTest, TestPipelines) {
+        // Split, parallel slices and the segment sweep resample alike
+        auto as = AudioSlicer(test_file_16ch);
+        as.set_output_rate(16000);
+        as.split_channels("rs_split_");
+        as.set_block_size(333);
+        as.split_channels("rs_split_small_");
+        EXPECT_TRUE(compare("rs_split_0.wav", "rs_split_small_0.wav"));
+        EXPECT_TRUE(compare("rs_split_15.wav", "rs_split_small_15.wav"));
+        auto channel = AudioSlicer("rs_split_0.wav");
+        EXPECT_EQ(channel.SampleRate(), 16000);
+        EXPECT_EQ(channel.NumSamples(), 8000);
+
+        std::vector<chunk> chunks = {chunk{0.1, 0.3, "rs_slice_a.wav"},
+            chunk{0.2, 0.45, "rs_slice_b.wav"}};
+        as.slice(chunks);
+        as.slice_segments({chunk{0.1, 0.3, "rs_sweep_a.wav"},
+            chunk{0.2, 0.45, "rs_sweep_b.wav"}});
+        EXPECT_TRUE(compare("rs_slice_a.wav", "rs_sweep_a.wav"));
+        EXPECT_TRUE(compare("rs_slice_b.wav", "rs_sweep_b.wav"));
+        EXPECT_EQ(AudioSlicer("rs_slice_b.wav").NumSamples(), 4000);
+    }
+
+    TEST(AudioResampleTest, TestEncodedOutput) {
+        // G.711 codes are decoded, resampled and encoded again
+        auto as = AudioSlicer(test_file_ulaw);
+        as.set_output_format(CT_MS_MLAW);
+        as.set_output_rate(16000);
+        as.slice({chunk{0, 1, "rs_ulaw.wav"}});
+        auto out = AudioSlicer("rs_ulaw.wav");
+        EXPECT_EQ(out.SampleRate(), 16000);
+        EXPECT_EQ(out.BitsPerSample(), 8);
+        int64_t frames = std::min(as.NumSamples(), int64_t(as.SampleRate()));
+        EXPECT_EQ(out.NumSamples(),
+            resampled_frames(as.SampleRate(), 16000, frames));
+    }
+}
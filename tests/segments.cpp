@@ -0,0 +1,125 @@
+#include "gtest/gtest.h"
+#include "slice.h"
+#include "segments.h"
+#include <fstream>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cassert>
+
+#include "./aux.h"
+
+
+namespace {
+    const std::string test_file_2ch = "../samples/sample_2ch.wav";
+
+    void write_text(std::string fname, std::string text) {
+        std::ofstream out(fname);
+        out << text;
+    }
+
+    TEST(SegmentsTest, TestReadCsv) {
+        write_text("segments.csv",
+            "start,end,output\n"
+            "# comment\n"
+            "1.5, 2.25, a.wav\n"
+            "0,1\n");
+        std::vector<chunk> segments = read_segments("segments.csv", "seg_");
+        ASSERT_EQ(segments.size(), 2);
+        EXPECT_EQ(segments[0].sec_start, 1.5);
+        EXPECT_EQ(segments[0].sec_end, 2.25);
+        EXPECT_EQ(segments[0].filename, "a.wav");
+        EXPECT_EQ(segments[1].sec_end, 1);
+        EXPECT_EQ(segments[1].filename, "seg_4.wav");
+    }
+
+    TEST(SegmentsTest, TestReadRttm) {
+        write_text("segments.rttm",
+            "SPEAKER rec 1 0.50 1.25 <NA> <NA> spk_a <NA> <NA>\n"
+            "SPEAKER rec 1 3.00 0.75 <NA> <NA> <NA> <NA> <NA>\n");
+        std::vector<chunk> segments = read_segments("segments.rttm", "r_");
+        ASSERT_EQ(segments.size(), 2);
+        EXPECT_EQ(segments[0].sec_start, 0.5);
+        EXPECT_EQ(segments[0].sec_end, 1.75);
+        EXPECT_EQ(segments[0].filename, "r_1_spk_a.wav");
+        EXPECT_EQ(segments[1].sec_end, 3.75);
+        EXPECT_EQ(segments[1].filename, "r_2.wav");
+    }
+
+    TEST(SegmentsTest, TestReadJsonl) {
+        write_text("segments.jsonl",
+            "{\"start\": 0.25, \"end\": 1, \"output\": \"j.wav\"}\n"
+            "{\"speaker\": \"b\", \"start\": 2, \"duration\": 0.5}\n");
+        std::vector<chunk> segments = read_segments("segments.jsonl", "j_");
+        ASSERT_EQ(segments.size(), 2);
+        EXPECT_EQ(segments[0].sec_start, 0.25);
+        EXPECT_EQ(segments[0].filename, "j.wav");
+        EXPECT_EQ(segments[1].sec_end, 2.5);
+        EXPECT_EQ(segments[1].filename, "j_2_b.wav");
+    }
+
+    TEST(SegmentsTest, TestSweep) {
+        // Unsorted, overlapping, nested and empty segments: the sweep
+        // must write the same files as one by one slicing
+        for (int16_t format : {CT_LPCM, CT_MS_ALAW}) {
+            std::vector<chunk> single, sweep;
+            const double bounds[][2] = {
+                {5.0, 7.5}, {0.1, 3.3}, {1.0, 1.2}, {2.9, 6.0},
+                {3.3, 3.3}, {0.0, 14.0}, {12.5, 13.0}, {13.9, 14.8}};
+            for (int i=0; i < 8; i++) {
+                std::string name = std::to_string(i) + ".wav";
+                single.push_back(chunk{bounds[i][0], bounds[i][1],
+                    "single_" + name});
+                sweep.push_back(chunk{bounds[i][0], bounds[i][1],
+                    "sweep_" + name});
+            }
+            auto as = AudioSlicer(test_file_2ch);
+            as.set_output_format(format);
+            as.set_block_size(4099);
+            as.slice(single);
+            as.slice_segments(sweep);
+            for (int i=0; i < single.size(); i++) {
+                EXPECT_TRUE(compare(single[i].filename, sweep[i].filename));
+            }
+        }
+    }
+
+    TEST(SegmentsTest, TestSweepPastEnd) {
+        // Segments at and past the end of the input are header only
+        auto as = AudioSlicer(test_file_2ch);
+        double duration = as.Duration();
+        const double bounds[][2] = {
+            {duration - 0.5, duration}, {duration, duration + 0.5},
+            {duration + 0.5, duration + 1.0}};
+        for (int16_t format : {CT_LPCM, CT_MS_ALAW}) {
+            std::vector<chunk> single, sweep;
+            for (int i=0; i < 3; i++) {
+                std::string name = std::to_string(i) + ".wav";
+                single.push_back(chunk{bounds[i][0], bounds[i][1],
+                    "single_end_" + name});
+                sweep.push_back(chunk{bounds[i][0], bounds[i][1],
+                    "sweep_end_" + name});
+            }
+            as.set_output_format(format);
+            as.slice(single);
+            as.slice_segments(sweep);
+            for (int i=0; i < single.size(); i++) {
+                EXPECT_TRUE(compare(single[i].filename, sweep[i].filename));
+            }
+            for (int i=1; i < sweep.size(); i++) {
+                // Output ends with an empty data section
+                std::pair<int, char*> out = read_file(sweep[i].filename);
+                ASSERT_GE(out.first, 44);
+                uint32_t size = 1;
+                memcpy(&size, out.second + out.first - 4, 4);
+                EXPECT_EQ(memcmp(out.second + out.first - 8, "data", 4), 0);
+                EXPECT_EQ(size, 0);
+                free(out.second);
+            }
+        }
+    }
+}
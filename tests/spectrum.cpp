@@ -0,0 +1,161 @@
+#include "gtest/gtest.h"
+#include "slice.h"
+#include "spectrum.h"
+#include <vector>
+#include <string>
+#include <utility>
+#include <cmath>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cassert>
+
+#include "./aux.h"
+
+
+namespace {
+    const std::string test_file_16ch = "../samples/sample_16ch.wav";
+
+    feature_params spectrum_params(int frame, int fft_size) {
+        feature_params params = DEFAULT_FEATURE_PARAMS;
+        params.frame_sec = frame / 16000.0;
+        params.hop_sec = frame / 3 / 16000.0;
+        params.fft_size = fft_size;
+        params.mels = 0;
+        params.log = false;
+        return params;
+    }
+
+    TEST(AudioFeaturesTest, TestSpectrum) {
+        // Power spectra against a direct DFT: power of two, mixed radix
+        // and odd half sizes
+        srand(5);
+        for (std::pair<int, int> size : std::vector<std::pair<int, int>>{
+                {400, 512}, {480, 480}, {25, 30}, {7, 8}}) {
+            std::string error;
+            FeatureExtractor fx(spectrum_params(size.first, size.second),
+                16000, &error);
+            ASSERT_TRUE(fx.valid()) << error;
+            ASSERT_EQ(fx.Bins(), size.second / 2 + 1);
+            // Not a multiple of the batch
+            const int count = 7;
+            std::vector<float> x(fx.Hop() * (count - 1) + fx.Frame());
+            for (float& v : x) {
+                v = (rand() % 20001 - 10000) / 10000.0f;
+            }
+            std::vector<float> out(count * fx.Bins());
+            fx.compute(x.data(), count, out.data());
+
+            for (int t = 0; t < count; t++) {
+                const float *frame = x.data() + t * fx.Hop();
+                double top = 0, worst = 0;
+                for (int k = 0; k < fx.Bins(); k++) {
+                    double re = 0, im = 0;
+                    for (int j = 0; j < fx.Frame(); j++) {
+                        double w = 0.5 - 0.5 * cos(2 * M_PI * j / fx.Frame());
+                        double a = 2 * M_PI * k * j / fx.FFTSize();
+                        re += w * frame[j] * cos(a);
+                        im -= w * frame[j] * sin(a);
+                    }
+                    double power = re * re + im * im;
+                    top = std::max(top, power);
+                    worst = std::max(worst,
+                        std::fabs(power - out[t * fx.Bins() + k]));
+                }
+                EXPECT_LT(worst, top * 1e-4) << size.second << " " << t;
+            }
+        }
+    }
+
+    TEST(AudioFeaturesTest, TestMel) {
+        // A 1 kHz tone peaks in the band around 1 kHz
+        feature_params params = DEFAULT_FEATURE_PARAMS;
+        params.mels = 40;
+        std::string error;
+        FeatureExtractor fx(params, 16000, &error);
+        ASSERT_TRUE(fx.valid()) << error;
+        EXPECT_EQ(fx.Frame(), 400);
+        EXPECT_EQ(fx.Hop(), 160);
+        EXPECT_EQ(fx.FFTSize(), 512);
+        std::vector<float> x(16000);
+        for (int i = 0; i < x.size(); i++) {
+            x[i] = 0.5 * sin(2 * M_PI * 1000 * i / 16000.0);
+        }
+        int64_t frames = feature_frames(x.size(), fx.Frame(), fx.Hop());
+        EXPECT_EQ(frames, 98);
+        std::vector<float> out(frames * fx.Bins());
+        fx.compute(x.data(), frames, out.data());
+        int best = 0;
+        for (int m = 0; m < fx.Bins(); m++) {
+            if (out[50 * fx.Bins() + m] > out[50 * fx.Bins() + best]) {
+                best = m;
+            }
+        }
+        double mel_top = 2595 * log10(1 + 8000 / 700.0);
+        double center = 700 * (pow(10.0, mel_top * (best + 1) / 41 / 2595) -
+            1);
+        EXPECT_NEAR(center, 1000, 60);
+        // Log values, bands far from the tone are near the floor
+        EXPECT_LT(out[50 * fx.Bins() + 39], out[50 * fx.Bins() + best] - 10);
+    }
+
+    TEST(AudioFeaturesTest, TestBadParams) {
+        std::string error;
+        EXPECT_FALSE(FeatureExtractor(spectrum_params(400, 256), 16000,
+            &error).valid());
+        EXPECT_FALSE(FeatureExtractor(spectrum_params(10, 14), 16000,
+            &error).valid());
+        EXPECT_FALSE(FeatureExtractor(spectrum_params(10, 15), 16000,
+            &error).valid());
+        feature_params params = DEFAULT_FEATURE_PARAMS;
+        params.fmax = 9000;
+        error.clear();
+        EXPECT_FALSE(FeatureExtractor(params, 16000, &error).valid());
+        EXPECT_FALSE(error.empty());
+    }
+
+    TEST(AudioFeaturesTest, TestNpy) {
+        std::string head = npy_header({3, 80});
+        EXPECT_EQ(head.size() % 64, 0);
+        EXPECT_EQ(head.substr(0, 8), std::string("\x93NUMPY\x01\x00", 8));
+        EXPECT_EQ(head.size(), 10 + (uint8_t(head[8]) | head[9] << 8));
+        EXPECT_NE(head.find("'shape': (3, 80), }"), std::string::npos);
+        EXPECT_EQ(head.back(), '\n');
+        EXPECT_NE(npy_header({5}).find("(5,)"), std::string::npos);
+    }
+
+    TEST(AudioFeaturesTest, TestSlicer) {
+        // Parallel ranges with small blocks give the same rows
+        feature_params params = DEFAULT_FEATURE_PARAMS;
+        params.channel = 3;
+        params.mels = 24;
+        auto as = AudioSlicer(test_file_16ch);
+        as.set_jobs(1);
+        int64_t frames = as.features(params, "feat_one.npy");
+        as.set_jobs(4);
+        as.set_block_size(333);
+        EXPECT_EQ(as.features(params, "feat_many.npy"), frames);
+        EXPECT_TRUE(compare("feat_one.npy", "feat_many.npy"));
+        EXPECT_EQ(frames, feature_frames(as.NumSamples(), 200, 80));
+
+        std::pair<int, char*> file = read_file("feat_one.npy");
+        std::string head = npy_header({frames, 24});
+        EXPECT_EQ(file.first, head.size() + frames * 24 * 4);
+        EXPECT_EQ(memcmp(file.second, head.data(), head.size()), 0);
+        free(file.second);
+
+        // All channels: one (frames, bins) block per channel
+        params.channel = -1;
+        as.features(params, "feat_all.npy");
+        file = read_file("feat_all.npy");
+        head = npy_header({16, frames, 24});
+        std::pair<int, char*> one = read_file("feat_one.npy");
+        ASSERT_EQ(file.first, head.size() + 16 * frames * 24 * 4);
+        int64_t block = frames * 24 * 4;
+        EXPECT_EQ(memcmp(file.second + head.size() + 3 * block,
+            one.second + npy_header({frames, 24}).size(), block), 0);
+        free(file.second);
+        free(one.second);
+    }
+}
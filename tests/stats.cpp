@@ -0,0 +1,63 @@
+#include "gtest/gtest.h"
+#include "slice.h"
+#include "stats.h"
+#include <vector>
+#include <string>
+#include <sstream>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./aux.h"
+
+
+namespace {
+    const std::string test_file_2ch = "../samples/sample_2ch.wav";
+    const std::string test_file_ima_2ch = "../samples/sample_ima_2ch.wav";
+
+    TEST(AudioStatsTest, TestJson) {
+        std::ostringstream out;
+        stats_json(out);
+        std::string json = out.str();
+        EXPECT_EQ(json.front(), '{');
+        EXPECT_EQ(json.back(), '}');
+        EXPECT_NE(json.find("\"peak_rss_bytes\": "), std::string::npos);
+#ifdef ASL_STATS
+        EXPECT_NE(json.find("\"instrumented\": true"), std::string::npos);
+        EXPECT_NE(json.find("\"load_channels\": {\"sec\": "),
+            std::string::npos);
+#else
+        EXPECT_NE(json.find("\"instrumented\": false"), std::string::npos);
+        EXPECT_EQ(json.find("\"stages\""), std::string::npos);
+#endif
+    }
+
+#ifdef ASL_STATS
+    TEST(AudioStatsTest, TestSplit) {
+        // Every sample of the source goes through de-interleave and write
+        auto as = AudioSlicer(test_file_2ch);
+        stats_reset();
+        as.split_channels("stats_split_");
+        int64_t samples = as.NumSamples() * as.Channels();
+        stage_stats load = stats_stage(STAGE_LOAD_CHANNELS);
+        EXPECT_GT(load.calls, 0);
+        EXPECT_GE(load.samples, samples);
+        EXPECT_EQ(stats_stage(STAGE_DECODE).calls, 0);
+        EXPECT_GE(stats_stage(STAGE_READ).bytes, samples * 2);
+        EXPECT_GE(stats_stage(STAGE_WRITE).bytes, samples * 2);
+        EXPECT_GT(stats_allocations(), 0);
+
+        // Coded formats are counted as decode
+        auto ima = AudioSlicer(test_file_ima_2ch);
+        stats_reset();
+        ima.set_output_format(CT_LPCM);
+        ima.slice({chunk{0, 1, "stats_ima.wav"}});
+        EXPECT_GT(stats_stage(STAGE_DECODE).calls, 0);
+        EXPECT_GE(stats_stage(STAGE_DECODE).samples,
+            int64_t(ima.SampleRate()) * 2);
+        EXPECT_GT(stats_stage(STAGE_INTERLEAVE).samples, 0);
+        EXPECT_EQ(stats_stage(STAGE_LOAD_CHANNELS).calls, 0);
+    }
+#endif  // ASL_STATS
+}
@@ -1,5 +1,6 @@
 #include "gtest/gtest.h"
 #include "slice.h"
+#include "g711.h"
 #include <vector>
 #include <utility>
 
@@ -38,4 +39,52 @@ namespace {
         EXPECT_TRUE(compare(
             "test_ulaw_one.wav", "../tests/expected/test_ulaw_one.wav"));
     }
+
+    TEST(AudioULawFormatTest, TestDecodeChannels) {
+        // Vector and scalar decoders must match the table for every code
+        for (int channels=1; channels <= 3; channels++) {
+            int frames = 256 + 7;
+            std::vector<char> codes(frames * channels);
+            for (int i=0; i < codes.size(); i++) {
+                codes[i] = static_cast<char>(i * 7 + i / channels);
+            }
+            std::vector<std::vector<int16_t>> out(
+                channels, std::vector<int16_t>(frames));
+            std::vector<char*> dst;
+            for (int ch=0; ch < channels; ch++) {
+                dst.push_back(reinterpret_cast<char*>(out[ch].data()));
+            }
+            g711_decode(G711_ULAW, codes.data(), frames, channels, dst.data());
+            for (int i=0; i < frames; i++) {
+                for (int ch=0; ch < channels; ch++) {
+                    uint8_t code = codes[i * channels + ch];
+                    ASSERT_EQ(out[ch][i], ULAW_DECODE.value[code]);
+                }
+            }
+        }
+    }
+
+    TEST(AudioULawFormatTest, TestPassthrough) {
+        // mu-law to mu-law copies the codes without decoding
+        auto as = AudioSlicer(test_file);
+        as.set_output_format(CT_MS_MLAW);
+        as.slice({chunk{1, 2, "test_ulaw_copy.wav"}});
+
+        std::pair<int, char*> out = read_file("test_ulaw_copy.wav");
+        std::pair<int, char*> src = read_file(test_file);
+        // 58 byte header with fact section, 1 byte per sample
+        ASSERT_EQ(out.first, 58 + 8000);
+        auto copy = AudioSlicer("test_ulaw_copy.wav");
+        EXPECT_EQ(copy.Wave().format, CT_MS_MLAW);
+        EXPECT_EQ(copy.BitsPerSample(), 8);
+        EXPECT_EQ(copy.Wave().fact_samples, 8000);
+        EXPECT_EQ(copy.Wave().data_offset, 58);
+        EXPECT_EQ(copy.Size(), 8000);
+        const int data_offset = 58;
+        for (int i=0; i < 8000; i++) {
+            ASSERT_EQ(out.second[58 + i], src.second[data_offset + 8000 + i]);
+        }
+        free(out.second);
+        free(src.second);
+    }
 }
@@ -0,0 +1,129 @@
+#include "gtest/gtest.h"
+#include "slice.h"
+#include "vad.h"
+#include "segments.h"
+#include <vector>
+#include <string>
+#include <utility>
+#include <cmath>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cassert>
+
+#include "./aux.h"
+
+
+namespace {
+    const int rate = 8000;
+
+    // 5 s mono 16 bit, a quiet noise floor (about -66 dBFS) with a
+    // -13 dBFS tone at [1, 2), [2.5, 2.55) (too short) and [3.5, 4.5)
+    // (with a pause at [3.9, 4.1) shorter than the hangover)
+    void write_test_file(const std::string& fname) {
+        std::vector<int16_t> data;
+        uint32_t seed = 1;
+        for (int i = 0; i < 5 * rate; i++) {
+            double t = static_cast<double>(i) / rate;
+            bool tone = (t >= 1 && t < 2) || (t >= 2.5 && t < 2.55) ||
+                (t >= 3.5 && t < 4.5 && !(t >= 3.9 && t < 4.1));
+            seed = seed * 1664525 + 1013904223;
+            int16_t v = static_cast<int16_t>(seed >> 26) - 32;
+            if (tone) {
+                v = static_cast<int16_t>(
+                    0.3 * 32767 * std::sin(2 * M_PI * 300 * t));
+            }
+            data.push_back(v);
+        }
+        write_wav(fname, CT_LPCM, 1, rate, 16, data);
+    }
+
+    void expect_segments(const std::vector<chunk>& segments) {
+        // Frame aligned edges with 0.1 s padding
+        ASSERT_EQ(segments.size(), 2);
+        EXPECT_NEAR(segments[0].sec_start, 0.9, 1e-9);
+        EXPECT_NEAR(segments[0].sec_end, 2.1, 1e-9);
+        EXPECT_NEAR(segments[1].sec_start, 3.4, 1e-9);
+        EXPECT_NEAR(segments[1].sec_end, 4.6, 1e-9);
+    }
+
+    TEST(AudioVadTest, TestSegments) {
+        write_test_file("vad_test.wav");
+        auto as = AudioSlicer("vad_test.wav");
+        as.set_jobs(1);
+        std::vector<chunk> segments = as.detect_speech(DEFAULT_VAD_PARAMS,
+            "vad_speech_");
+        expect_segments(segments);
+        EXPECT_EQ(segments[0].filename, "vad_speech_0.wav");
+        EXPECT_EQ(segments[1].filename, "vad_speech_1.wav");
+
+        as.slice(segments);
+        auto speech = AudioSlicer("vad_speech_1.wav");
+        EXPECT_EQ(speech.NumSamples(), 9600);
+        EXPECT_EQ(speech.BitsPerSample(), 16);
+    }
+
+    TEST(AudioVadTest, TestUlawParallel) {
+        // Same segments from G.711 input decoded by several workers
+        write_test_file("vad_test.wav");
+        auto as = AudioSlicer("vad_test.wav");
+        as.set_output_format(CT_MS_MLAW);
+        as.slice({chunk{0, 5, "vad_test_ulaw.wav"}});
+
+        auto ulaw = AudioSlicer("vad_test_ulaw.wav");
+        ulaw.set_jobs(3);
+        ulaw.set_block_size(333);
+        expect_segments(ulaw.detect_speech(DEFAULT_VAD_PARAMS, "vad_"));
+    }
+
+    TEST(AudioVadTest, TestDecisions) {
+        // 20 ms frames: hangover 15 frames, min speech 5 frames
+        const int n = 100;
+        std::vector<float> energy(n, 1e-8f), zcr(n, 0.05f);
+        auto set = [&](int first, int last, float db, float rate) {
+            for (int i = first; i < last; i++) {
+                energy[i] = std::pow(10.0f, db / 10);
+                zcr[i] = rate;
+            }
+        };
+        // Speech, a 10 frame pause, speech again
+        set(10, 20, -20, 0.05f);
+        set(30, 35, -20, 0.05f);
+        // Noisy fricative just below the threshold, then voiced speech
+        set(60, 64, -48, 0.5f);
+        set(64, 70, -20, 0.05f);
+        // Click
+        set(90, 92, -10, 0.05f);
+        std::vector<std::pair<int64_t, int64_t>> found = detect_voice(
+            energy.data(), zcr.data(), n, DEFAULT_VAD_PARAMS);
+        ASSERT_EQ(found.size(), 2);
+        EXPECT_EQ(found[0], std::make_pair(int64_t(10), int64_t(35)));
+        EXPECT_EQ(found[1], std::make_pair(int64_t(60), int64_t(70)));
+
+        // Without the zero-crossing rule the fricative is not speech
+        vad_params params = DEFAULT_VAD_PARAMS;
+        params.zcr = 0;
+        found = detect_voice(energy.data(), zcr.data(), n, params);
+        ASSERT_EQ(found.size(), 2);
+        EXPECT_EQ(found[1], std::make_pair(int64_t(64), int64_t(70)));
+    }
+
+    TEST(AudioVadTest, TestSegmentLists) {
+        std::vector<chunk> segments = {
+            chunk{0.9, 2.1, "a.wav"}, chunk{3.4, 4.625, "b.wav"}};
+        for (std::string ext : {"csv", "jsonl", "rttm"}) {
+            std::string fname = "vad_list." + ext;
+            write_segments(fname, segments, "call");
+            std::vector<chunk> back = read_segments(fname, "seg_");
+            ASSERT_EQ(back.size(), 2) << ext;
+            for (int i = 0; i < 2; i++) {
+                EXPECT_NEAR(back[i].sec_start, segments[i].sec_start, 1e-6);
+                EXPECT_NEAR(back[i].sec_end, segments[i].sec_end, 1e-6);
+                if (ext != "rttm") {
+                    EXPECT_EQ(back[i].filename, segments[i].filename);
+                }
+            }
+        }
+    }
+}
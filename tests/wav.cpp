@@ -5,6 +5,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <cassert>
 
 #include "./aux.h"
@@ -13,6 +14,9 @@
 namespace {
     const std::string test_file = "../samples/sample.wav";
     const std::string test_file_2ch = "../samples/sample_2ch.wav";
+    const std::string test_file_ext = "../samples/sample_ext.wav";
+    const std::string test_file_rf64 = "../samples/sample_rf64.wav";
+    const std::string test_file_16ch = "../samples/sample_16ch.wav";
     const std::string test_format = "1 (Linear PCM)";
 
     TEST(AudioFormatTest, TestRead) {
@@ -66,4 +70,125 @@ namespace {
         EXPECT_TRUE(compare("split_test_0.wav", "../tests/expected/split_test_0.wav"));
         EXPECT_TRUE(compare("split_test_1.wav", "../tests/expected/split_test_1.wav"));
     }
+
+    TEST(AudioFormatTest, TestStreamBlocks) {
+        // Block boundaries must not change the output
+        auto as = AudioSlicer(test_file_2ch, true);
+        as.set_block_size(1001);
+        as.slice({chunk{1, 2, "test_two_2ch_blocks.wav"}});
+        EXPECT_TRUE(compare("test_two_2ch_blocks.wav", "../tests/expected/test_two_2ch.wav"));
+
+        as.split_channels("split_blocks_test_");
+        EXPECT_TRUE(compare("split_blocks_test_0.wav", "../tests/expected/split_test_0.wav"));
+        EXPECT_TRUE(compare("split_blocks_test_1.wav", "../tests/expected/split_test_1.wav"));
+    }
+
+    TEST(AudioFormatTest, TestSlicePrecise) {
+        // Millisecond and sample boundaries, LPCM is copied as is
+        auto as = AudioSlicer(test_file_2ch);
+        int rate = as.SampleRate();
+        as.slice({
+            chunk{0.5, 1.25, "test_ms_2ch.wav"},
+            chunk{12345.0 / rate, 54321.0 / rate, "test_smp_2ch.wav"}
+        });
+
+        std::pair<int, char*> src = read_file(test_file_2ch);
+        const int64_t data_offset = as.Wave().data_offset;
+        const int64_t bounds[2][2] = {
+            {rate / 2, rate * 5 / 4}, {12345, 54321}};
+        const std::string names[2] = {"test_ms_2ch.wav", "test_smp_2ch.wav"};
+        for (int k=0; k < 2; k++) {
+            std::pair<int, char*> out = read_file(names[k]);
+            int64_t size = (bounds[k][1] - bounds[k][0]) * 4;
+            ASSERT_EQ(out.first, 44 + size);
+            EXPECT_EQ(memcmp(out.second + 44,
+                src.second + data_offset + bounds[k][0] * 4, size), 0);
+            free(out.second);
+        }
+        free(src.second);
+    }
+
+    TEST(AudioFormatTest, TestSliceParallel) {
+        // Output must not depend on the number of workers
+        for (int16_t format : {CT_LPCM, CT_MS_MLAW}) {
+            std::vector<chunk> serial, parallel;
+            for (int i=0; i < 24; i++) {
+                double start = i * 0.37;
+                std::string name = std::to_string(i) + ".wav";
+                serial.push_back(chunk{start, start + 0.5, "ser_" + name});
+                parallel.push_back(chunk{start, start + 0.5, "par_" + name});
+            }
+            auto as = AudioSlicer(test_file_2ch);
+            as.set_output_format(format);
+            as.set_block_size(777);
+            as.set_jobs(1);
+            as.slice(serial);
+            as.set_jobs(4);
+            as.slice(parallel);
+            for (int i=0; i < serial.size(); i++) {
+                EXPECT_TRUE(compare(serial[i].filename, parallel[i].filename));
+            }
+        }
+    }
+
+    TEST(AudioFormatTest, TestSplitMultichannel) {
+        // 16 channels, flushes of one block overlap decoding of the next
+        auto as = AudioSlicer(test_file_16ch);
+        as.set_block_size(999);
+        as.split_channels("split_16ch_");
+
+        std::pair<int, char*> src = read_file(test_file_16ch);
+        const int frames = 4000;
+        for (int ch=0; ch < 16; ch++) {
+            std::pair<int, char*> out = read_file(
+                "split_16ch_" + std::to_string(ch) + ".wav");
+            ASSERT_EQ(out.first, 44 + frames * 2);
+            for (int i=0; i < frames; i++) {
+                ASSERT_EQ(memcmp(out.second + 44 + i * 2,
+                    src.second + 44 + (i * 16 + ch) * 2, 2), 0);
+            }
+            free(out.second);
+        }
+        free(src.second);
+    }
+
+    TEST(AudioFormatTest, TestSliceG711) {
+        // Encode LPCM slices to mu-law and a-law (reference: Python audioop)
+        auto as = AudioSlicer(test_file, true);
+        as.set_output_format(CT_MS_MLAW);
+        as.slice({chunk{0, 1, "test_one_ulaw.wav"}});
+        EXPECT_TRUE(compare("test_one_ulaw.wav", "../tests/expected/test_one_ulaw.wav"));
+
+        as.set_output_format(CT_MS_ALAW);
+        as.slice({chunk{0, 1, "test_one_alaw.wav"}});
+        EXPECT_TRUE(compare("test_one_alaw.wav", "../tests/expected/test_one_alaw.wav"));
+    }
+
+    TEST(AudioFormatTest, TestReadExtensible) {
+        // WAVE_FORMAT_EXTENSIBLE fmt and a LIST section before the data
+        auto as = AudioSlicer(test_file_ext);
+        EXPECT_EQ(as.audio_format(), test_format);
+        EXPECT_EQ(as.Size(), 44100);
+        EXPECT_EQ(as.SampleRate(), 22050);
+        EXPECT_EQ(as.BitsPerSample(), 16);
+        EXPECT_EQ(as.Channels(), 1);
+        EXPECT_EQ(as.NumSamples(), 22050);
+        EXPECT_EQ(as.Wave().chunks.size(), 3);
+        EXPECT_EQ(as.Wave().data_offset, 12 + 48 + 24 + 8);
+
+        as.slice({chunk{0, 1, "test_one_ext.wav"}});
+        EXPECT_TRUE(compare("test_one_ext.wav", "../tests/expected/test_one.wav"));
+    }
+
+    TEST(AudioFormatTest, TestReadRF64) {
+        // RF64: 32 bit sizes are 0xFFFFFFFF, real ones are in ds64
+        auto as = AudioSlicer(test_file_rf64);
+        EXPECT_TRUE(as.Wave().is_rf64);
+        EXPECT_EQ(as.Size(), 44100);
+        EXPECT_EQ(as.NumSamples(), 22050);
+        EXPECT_EQ(as.Wave().data_offset, 12 + 36 + 24 + 8);
+
+        as.slice({chunk{0, 1, "test_one_rf64.wav"}});
+        EXPECT_TRUE(compare("test_one_rf64.wav", "../tests/expected/test_one.wav"));
+    }
 }